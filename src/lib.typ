@@ -1,10 +1,121 @@
-#import "parser/protocol.typ": encode-parse, decode-ASTElement
+#import "parser/protocol.typ": encode-parse, encode-parse_batch, decode-records, decode-graph, decode-ring_membership, decode-molecular_formula, decode-canonical, decode-validation, decode-validation_batch
+#import "parser/compact.typ": decode-compact
 
 #let parser = plugin("parser/smiles.wasm")
 
-#let parse(smile) = {
-	decode-ASTElement(parser.parse_smiles(encode-parse((
+/// Parses a SMILES into its syntax tree. With `compact: true` the tree is
+/// sent in the varint encoding of `parser/compact.typ`, close to ten times
+/// smaller than the default CBOR but decoded by Typst code rather than
+/// natively.
+#let parse(smile, compact: false) = {
+	let args = encode-parse((
 		"smiles": smile
+	))
+	if compact {
+		decode-compact(parser.parse_smiles_compact(args))
+	} else {
+		cbor(parser.parse_smiles_cbor(args))
+	}
+}
+
+/// Parses a SMILES into flat atom and bond records with typed values, much
+/// smaller than the syntax tree. Atoms are numbered in input order with
+/// `element` their atomic number, 0 for `*`, `hydrogens` -1 outside brackets,
+/// `isotope` and `atom_class` -1 when too large for a 32-bit integer and
+/// `chirality` numbered as in `graph`. A bond record with `ring` -1 links
+/// `begin` to `end`, otherwise it is one end of ring bond `ring` on atom
+/// `begin` with `end` -1, the two ends being left unpaired. `symbol` is the
+/// code of the bond character or 0 and `from` the byte offset of the
+/// character, of the ring label or of the next atom when there is none.
+#let records(smile) = {
+	decode-records(parser.parse_smiles_records(encode-parse((
+		"smiles": smile
+	))), 0).at(0)
+}
+
+/// Parses a whole list of SMILES in one plugin call. Each entry of the
+/// returned array is either `(result: ast)` or `(error: message, position: offset)`.
+#let parse-many(smiles) = {
+	cbor(parser.parse_smiles_batch(encode-parse_batch((
+		"smiles": smiles
 	))))
 }
 
+/// Checks a SMILES without building anything, as `(code: 0, position: 0)`
+/// when `parse` would succeed. Otherwise `code` is 1 where an atom was
+/// expected and 2 where text is left after the SMILES, and `position` is the
+/// byte offset `parse` would report. Ring bonds are not paired.
+#let validate(smile) = {
+	decode-validation(parser.validate_smiles(encode-parse((
+		"smiles": smile
+	))), 0).at(0).result
+}
+
+/// Same as `validate` for a whole list of SMILES in one plugin call.
+#let validate-many(smiles) = {
+	decode-validation_batch(parser.validate_smiles_batch(encode-parse_batch((
+		"smiles": smiles
+	))), 0).at(0).results
+}
+
+/// Parses a SMILES into its molecular graph, with ring bonds already paired.
+/// Atoms and bonds are numbered in input order and the neighbours of atom `i`
+/// are `adjacency.slice(adjacency_offsets.at(i), adjacency_offsets.at(i + 1))`,
+/// through the bonds at the same indices of `adjacency_bonds`. Atoms written
+/// without brackets get their `implicit_hydrogens` from their default valence.
+/// `chirality` is 0 for none, 1 for `@` and 2 for `@@`, then `@TH1` to `@TH2`
+/// are 3 to 4, `@AL1` to `@AL2` 5 to 6, `@SP1` to `@SP3` 7 to 9, `@TB1` to
+/// `@TB20` 10 to 29 and `@OH1` to `@OH30` 30 to 59.
+#let graph(smile) = {
+	decode-graph(parser.graph_smiles(encode-parse((
+		"smiles": smile
+	))), 0).at(0)
+}
+
+/// Same as `graph` with every aromatic bond given an explicit `order` of 1
+/// or 2, alternating around the aromatic rings.
+#let kekulize(smile) = {
+	decode-graph(parser.kekulize_smiles(encode-parse((
+		"smiles": smile
+	))), 0).at(0)
+}
+
+/// Same as `kekulize` with 2D coordinates on every atom, in bond lengths
+/// with `y` pointing up, ready to be drawn.
+#let depict(smile) = {
+	decode-graph(parser.depict_smiles(encode-parse((
+		"smiles": smile
+	))), 0).at(0)
+}
+
+/// Finds the smallest set of smallest rings of a SMILES. Ring `i` is
+/// `rings.slice(ring_offsets.at(i), ring_offsets.at(i + 1))`, its atoms in
+/// cyclic order, and the rings holding atom `j` are
+/// `atom_rings.slice(atom_ring_offsets.at(j), atom_ring_offsets.at(j + 1))`.
+#let rings(smile) = {
+	decode-ring_membership(parser.rings_smiles(encode-parse((
+		"smiles": smile
+	))), 0).at(0)
+}
+
+/// Hill formula of a SMILES with its masses in daltons, as
+/// `(formula: "C2H6O", exact_mass: 46.04186, average_mass: 46.069)`. The
+/// exact mass uses the most abundant isotope of each element, and labelled
+/// atoms such as `[13C]` count with their own mass and appear apart in the
+/// formula.
+#let formula(smile) = {
+	decode-molecular_formula(parser.formula_smiles(encode-parse((
+		"smiles": smile
+	))), 0).at(0)
+}
+
+/// Canonical SMILES of a SMILES with a hash of it, as
+/// `(smiles: "CCO", hash: "0b783019aa3ace44")`. Both are the same for every spelling of
+/// the same molecule, to deduplicate or key a cache. Tetrahedral and double
+/// bond stereo are kept. Aromaticity is found from the rings, so that
+/// `"Oc1ccccc1C"` and `"OC1=CC=CC=C1C"` give `"Cc1ccccc1O"`.
+#let canonical(smile) = {
+	decode-canonical(parser.canonical_smiles(encode-parse((
+		"smiles": smile
+	))), 0).at(0)
+}
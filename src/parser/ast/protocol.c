@@ -73,67 +73,618 @@ size_t string_list_size(char **list, size_t size) {
 	return result;
 }
 
-void free_ASTElement(ASTElement *s) {
-    if (s->value) {
-        free(s->value);
+// ASTElement trees can be arbitrarily deep, they are walked in pre-order with
+// this explicit stack rather than by recursing once per level.
+typedef struct ASTElement_stack {
+    const ASTElement **items;
+    size_t len;
+    size_t capacity;
+} ASTElement_stack;
+
+static int push_ASTElement_children(ASTElement_stack *stack, const ASTElement *s) {
+    if (stack->len + s->children_len > stack->capacity) {
+        size_t capacity = stack->capacity == 0 ? 64 : stack->capacity * 2;
+        while (capacity < stack->len + s->children_len) {
+            capacity *= 2;
+        }
+        const ASTElement **items = realloc(stack->items, sizeof(*items) * capacity);
+        if (!items) {
+            return 1;
+        }
+        stack->items = items;
+        stack->capacity = capacity;
     }
-    for (size_t i = 0; i < s->children_len; i++) {
-    free_ASTElement(&s->children[i]);
+    // pushed in reverse so that the first one is popped first
+    for (size_t i = s->children_len; i-- > 0;) {
+        stack->items[stack->len++] = &s->children[i];
+    }
+    return 0;
+}
+
+void free_ASTElement(ASTElement *root) {
+    ASTElement *stack = NULL;
+    size_t len = 0, capacity = 0;
+    ASTElement element = *root;
+    ASTElement *s = &element;
+    while (true) {
+        free(s->value);
+        if (len + s->children_len > capacity) {
+            capacity = (len + s->children_len) * 2;
+            ASTElement *grown = realloc(stack, sizeof(*stack) * capacity);
+            if (!grown) {
+                // what is left cannot be reached any more
+                break;
+            }
+            stack = grown;
+        }
+        if (s->children_len > 0) {
+            memcpy(stack + len, s->children, sizeof(*stack) * s->children_len);
+            len += s->children_len;
+        }
+        free(s->children);
+        if (len == 0) {
+            break;
+        }
+        element = stack[--len];
     }
-    free(s->children);
+    free(stack);
 }
-size_t ASTElement_size(const void *s){
-	return TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE + string_size(((ASTElement*)s)->value) + TYPST_INT_SIZE + list_size(((ASTElement*)s)->children, ((ASTElement*)s)->children_len, ASTElement_size, sizeof(*((ASTElement*)s)->children));
+
+static size_t ASTElement_header_size(const ASTElement *s) {
+    return TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE + string_size(s->value) +
+           TYPST_INT_SIZE;
 }
-int encode_ASTElement(const ASTElement *s, uint8_t *__input_buffer, size_t *buffer_len, size_t *buffer_offset) {
-    size_t __buffer_offset = 0;    size_t s_size = ASTElement_size(s);
-    if (s_size > *buffer_len) {
+
+size_t ASTElement_size(const void *p) {
+    const ASTElement *s = p;
+    size_t result = 0;
+    ASTElement_stack stack = {0};
+    while (s) {
+        result += ASTElement_header_size(s);
+        if (push_ASTElement_children(&stack, s)) {
+            result = 0;
+            break;
+        }
+        s = stack.len > 0 ? stack.items[--stack.len] : NULL;
+    }
+    free(stack.items);
+    return result;
+}
+
+static int encode_ASTElement_header(const ASTElement *s, uint8_t *__input_buffer,
+                                    size_t *buffer_len, size_t *buffer_offset) {
+    size_t __buffer_offset = *buffer_offset;
+    if (__buffer_offset + ASTElement_header_size(s) > *buffer_len) {
         return 2;
     }
     int err;
-	(void)err;
+    (void)err;
     INT_PACK(s->type)
     INT_PACK(s->from)
     INT_PACK(s->to)
     STR_PACK(s->value)
     INT_PACK(s->children_len)
-    for (size_t i = 0; i < s->children_len; i++) {
-        if ((err = encode_ASTElement(&s->children[i], __input_buffer + __buffer_offset, buffer_len, &__buffer_offset))) {
-            return err;
+    *buffer_offset = __buffer_offset;
+    return 0;
+}
+
+int encode_ASTElement(const ASTElement *s, uint8_t *__input_buffer, size_t *buffer_len,
+                      size_t *buffer_offset) {
+    ASTElement_stack stack = {0};
+    int err = 0;
+    while (s) {
+        if ((err = encode_ASTElement_header(s, __input_buffer, buffer_len, buffer_offset))) {
+            break;
+        }
+        if (push_ASTElement_children(&stack, s)) {
+            err = 1;
+            break;
         }
+        s = stack.len > 0 ? stack.items[--stack.len] : NULL;
+    }
+    free(stack.items);
+    return err;
+}
+
+void free_AtomRecord(AtomRecord *s) {
+}
+
+size_t AtomRecord_size(const void *p) {
+    const AtomRecord *s = p;
+    (void)s;
+    return 1 + 1 + 1 + 1 + 1 + TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE;
+}
+
+int encode_AtomRecord(const AtomRecord *s, uint8_t *__input_buffer, size_t *buffer_len,
+                      size_t *buffer_offset) {
+    size_t __buffer_offset = *buffer_offset;
+    if (__buffer_offset + AtomRecord_size(s) > *buffer_len) {
+        return 2;
     }
+    int err;
+    (void)err;
+    CHAR_PACK(s->element)
+    CHAR_PACK(s->aromatic)
+    CHAR_PACK(s->chirality)
+    CHAR_PACK(s->hydrogens)
+    CHAR_PACK(s->charge)
+    INT_PACK(s->isotope)
+    INT_PACK(s->atom_class)
+    INT_PACK(s->from)
+    INT_PACK(s->to)
+    *buffer_offset = __buffer_offset;
+    return 0;
+}
+
+void free_BondRecord(BondRecord *s) {
+}
+
+size_t BondRecord_size(const void *p) {
+    const BondRecord *s = p;
+    (void)s;
+    return TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE + 1 + 1;
+}
 
-    *buffer_offset += __buffer_offset;
+int encode_BondRecord(const BondRecord *s, uint8_t *__input_buffer, size_t *buffer_len,
+                      size_t *buffer_offset) {
+    size_t __buffer_offset = *buffer_offset;
+    if (__buffer_offset + BondRecord_size(s) > *buffer_len) {
+        return 2;
+    }
+    int err;
+    (void)err;
+    INT_PACK(s->begin)
+    INT_PACK(s->end)
+    INT_PACK(s->from)
+    CHAR_PACK(s->symbol)
+    CHAR_PACK(s->ring)
+    *buffer_offset = __buffer_offset;
+    return 0;
+}
+
+void free_Atom(Atom *s) {
+}
+
+size_t Atom_size(const void *p) {
+    const Atom *s = p;
+    (void)s;
+    return 1 + 1 + 1 + 1 + TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE +
+           TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE;
+}
+
+int encode_Atom(const Atom *s, uint8_t *__input_buffer, size_t *buffer_len, size_t *buffer_offset) {
+    size_t __buffer_offset = *buffer_offset;
+    if (__buffer_offset + Atom_size(s) > *buffer_len) {
+        return 2;
+    }
+    int err;
+    (void)err;
+    CHAR_PACK(s->element)
+    CHAR_PACK(s->aromatic)
+    CHAR_PACK(s->implicit_hydrogens)
+    CHAR_PACK(s->chirality)
+    INT_PACK(s->isotope)
+    INT_PACK(s->charge)
+    INT_PACK(s->hydrogens)
+    INT_PACK(s->atom_class)
+    INT_PACK(s->from)
+    INT_PACK(s->to)
+    FLOAT_PACK(s->x)
+    FLOAT_PACK(s->y)
+    *buffer_offset = __buffer_offset;
     return 0;
 }
+
+void free_Bond(Bond *s) {
+}
+
+size_t Bond_size(const void *p) {
+    const Bond *s = p;
+    (void)s;
+    return TYPST_INT_SIZE + TYPST_INT_SIZE + 1 + 1 + 1;
+}
+
+int encode_Bond(const Bond *s, uint8_t *__input_buffer, size_t *buffer_len, size_t *buffer_offset) {
+    size_t __buffer_offset = *buffer_offset;
+    if (__buffer_offset + Bond_size(s) > *buffer_len) {
+        return 2;
+    }
+    int err;
+    (void)err;
+    INT_PACK(s->begin)
+    INT_PACK(s->end)
+    CHAR_PACK(s->order)
+    CHAR_PACK(s->aromatic)
+    CHAR_PACK(s->symbol)
+    *buffer_offset = __buffer_offset;
+    return 0;
+}
+
+void free_Validation(Validation *s) {
+}
+
+size_t Validation_size(const void *p) {
+    const Validation *s = p;
+    (void)s;
+    return TYPST_INT_SIZE + TYPST_INT_SIZE;
+}
+
+int encode_Validation(const Validation *s, uint8_t *__input_buffer, size_t *buffer_len,
+                      size_t *buffer_offset) {
+    size_t __buffer_offset = *buffer_offset;
+    if (__buffer_offset + Validation_size(s) > *buffer_len) {
+        return 2;
+    }
+    int err;
+    (void)err;
+    INT_PACK(s->code)
+    INT_PACK(s->position)
+    *buffer_offset = __buffer_offset;
+    return 0;
+}
+
+void free_RuleStats(RuleStats *s) {
+    free(s->rule);
+}
+
+size_t RuleStats_size(const void *p) {
+    const RuleStats *s = p;
+    return string_size(s->rule) + TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE +
+           TYPST_INT_SIZE + TYPST_INT_SIZE;
+}
+
+int encode_RuleStats(const RuleStats *s, uint8_t *__input_buffer, size_t *buffer_len,
+                     size_t *buffer_offset) {
+    size_t __buffer_offset = *buffer_offset;
+    if (__buffer_offset + RuleStats_size(s) > *buffer_len) {
+        return 2;
+    }
+    int err;
+    (void)err;
+    STR_PACK(s->rule)
+    INT_PACK(s->calls)
+    INT_PACK(s->failures)
+    INT_PACK(s->backtracks)
+    INT_PACK(s->rescanned)
+    INT_PACK(s->allocations)
+    *buffer_offset = __buffer_offset;
+    return 0;
+}
+
+void free_parse(parse *s) {
+    free(s->smiles);
+}
+
+int decode_parse(size_t buffer_len, parse *out) {
+    INIT_BUFFER_UNPACK(buffer_len)
+    NEXT_STR(out->smiles)
+    FREE_BUFFER()
+    return 0;
+}
+
+void free_parse_batch(parse_batch *s) {
+    for (size_t i = 0; i < s->smiles_len; i++) {
+        free(s->smiles[i]);
+    }
+    free(s->smiles);
+}
+
+int decode_parse_batch(size_t buffer_len, parse_batch *out) {
+    INIT_BUFFER_UNPACK(buffer_len)
+    NEXT_INT(out->smiles_len)
+    out->smiles = calloc(out->smiles_len, sizeof(*out->smiles));
+    if (out->smiles_len && !out->smiles) {
+        FREE_BUFFER()
+        return 1;
+    }
+    for (size_t i = 0; i < out->smiles_len; i++) {
+        NEXT_STR(out->smiles[i])
+    }
+    FREE_BUFFER()
+    return 0;
+}
+
 void free_result(result *s) {
     free_ASTElement(&s->result);
 }
-size_t result_size(const void *s){
-	return ASTElement_size((void*)&((result*)s)->result);
+
+size_t result_size(const void *p) {
+    const result *s = p;
+    return ASTElement_size(&s->result);
 }
+
 int encode_result(const result *s) {
     size_t buffer_len = result_size(s);
     INIT_BUFFER_PACK(buffer_len)
     int err;
-	(void)err;
-        if ((err = encode_ASTElement(&s->result, __input_buffer + __buffer_offset, &buffer_len, &__buffer_offset))) {
+    (void)err;
+    if ((err = encode_ASTElement(&s->result, __input_buffer, &buffer_len, &__buffer_offset))) {
+        FREE_BUFFER()
+        return err;
+    }
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
+    return 0;
+}
+
+void free_records(records *s) {
+    for (size_t i = 0; i < s->atoms_len; i++) {
+        free_AtomRecord(&s->atoms[i]);
+    }
+    free(s->atoms);
+    for (size_t i = 0; i < s->bonds_len; i++) {
+        free_BondRecord(&s->bonds[i]);
+    }
+    free(s->bonds);
+}
+
+size_t records_size(const void *p) {
+    const records *s = p;
+    return TYPST_INT_SIZE + list_size(s->atoms, s->atoms_len, AtomRecord_size, sizeof(*s->atoms)) +
+           TYPST_INT_SIZE + list_size(s->bonds, s->bonds_len, BondRecord_size, sizeof(*s->bonds));
+}
+
+int encode_records(const records *s) {
+    size_t buffer_len = records_size(s);
+    INIT_BUFFER_PACK(buffer_len)
+    int err;
+    (void)err;
+    INT_PACK(s->atoms_len)
+    for (size_t i = 0; i < s->atoms_len; i++) {
+        if ((err = encode_AtomRecord(&s->atoms[i], __input_buffer, &buffer_len,
+                                     &__buffer_offset))) {
+            FREE_BUFFER()
             return err;
         }
+    }
+    INT_PACK(s->bonds_len)
+    for (size_t i = 0; i < s->bonds_len; i++) {
+        if ((err = encode_BondRecord(&s->bonds[i], __input_buffer, &buffer_len,
+                                     &__buffer_offset))) {
+            FREE_BUFFER()
+            return err;
+        }
+    }
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
+    return 0;
+}
+
+void free_graph(graph *s) {
+    for (size_t i = 0; i < s->atoms_len; i++) {
+        free_Atom(&s->atoms[i]);
+    }
+    free(s->atoms);
+    for (size_t i = 0; i < s->bonds_len; i++) {
+        free_Bond(&s->bonds[i]);
+    }
+    free(s->bonds);
+    free(s->adjacency_offsets);
+    free(s->adjacency);
+    free(s->adjacency_bonds);
+}
 
+size_t graph_size(const void *p) {
+    const graph *s = p;
+    return TYPST_INT_SIZE + list_size(s->atoms, s->atoms_len, Atom_size, sizeof(*s->atoms)) +
+           TYPST_INT_SIZE + list_size(s->bonds, s->bonds_len, Bond_size, sizeof(*s->bonds)) +
+           TYPST_INT_SIZE + TYPST_INT_SIZE * s->adjacency_offsets_len + TYPST_INT_SIZE +
+           TYPST_INT_SIZE * s->adjacency_len + TYPST_INT_SIZE +
+           TYPST_INT_SIZE * s->adjacency_bonds_len;
+}
+
+int encode_graph(const graph *s) {
+    size_t buffer_len = graph_size(s);
+    INIT_BUFFER_PACK(buffer_len)
+    int err;
+    (void)err;
+    INT_PACK(s->atoms_len)
+    for (size_t i = 0; i < s->atoms_len; i++) {
+        if ((err = encode_Atom(&s->atoms[i], __input_buffer, &buffer_len, &__buffer_offset))) {
+            FREE_BUFFER()
+            return err;
+        }
+    }
+    INT_PACK(s->bonds_len)
+    for (size_t i = 0; i < s->bonds_len; i++) {
+        if ((err = encode_Bond(&s->bonds[i], __input_buffer, &buffer_len, &__buffer_offset))) {
+            FREE_BUFFER()
+            return err;
+        }
+    }
+    INT_PACK(s->adjacency_offsets_len)
+    for (size_t i = 0; i < s->adjacency_offsets_len; i++) {
+        INT_PACK(s->adjacency_offsets[i])
+    }
+    INT_PACK(s->adjacency_len)
+    for (size_t i = 0; i < s->adjacency_len; i++) {
+        INT_PACK(s->adjacency[i])
+    }
+    INT_PACK(s->adjacency_bonds_len)
+    for (size_t i = 0; i < s->adjacency_bonds_len; i++) {
+        INT_PACK(s->adjacency_bonds[i])
+    }
     wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
     return 0;
 }
-void free_parse(parse *s) {
-    if (s->smiles) {
-        free(s->smiles);
+
+void free_ring_membership(ring_membership *s) {
+    free(s->rings);
+    free(s->ring_offsets);
+    free(s->atom_rings);
+    free(s->atom_ring_offsets);
+}
+
+size_t ring_membership_size(const void *p) {
+    const ring_membership *s = p;
+    return TYPST_INT_SIZE + TYPST_INT_SIZE * s->rings_len + TYPST_INT_SIZE +
+           TYPST_INT_SIZE * s->ring_offsets_len + TYPST_INT_SIZE +
+           TYPST_INT_SIZE * s->atom_rings_len + TYPST_INT_SIZE +
+           TYPST_INT_SIZE * s->atom_ring_offsets_len;
+}
+
+int encode_ring_membership(const ring_membership *s) {
+    size_t buffer_len = ring_membership_size(s);
+    INIT_BUFFER_PACK(buffer_len)
+    int err;
+    (void)err;
+    INT_PACK(s->rings_len)
+    for (size_t i = 0; i < s->rings_len; i++) {
+        INT_PACK(s->rings[i])
+    }
+    INT_PACK(s->ring_offsets_len)
+    for (size_t i = 0; i < s->ring_offsets_len; i++) {
+        INT_PACK(s->ring_offsets[i])
+    }
+    INT_PACK(s->atom_rings_len)
+    for (size_t i = 0; i < s->atom_rings_len; i++) {
+        INT_PACK(s->atom_rings[i])
+    }
+    INT_PACK(s->atom_ring_offsets_len)
+    for (size_t i = 0; i < s->atom_ring_offsets_len; i++) {
+        INT_PACK(s->atom_ring_offsets[i])
     }
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
+    return 0;
 }
-int decode_parse(size_t buffer_len, parse *out) {
-    INIT_BUFFER_UNPACK(buffer_len)
+
+void free_molecular_formula(molecular_formula *s) {
+    free(s->formula);
+}
+
+size_t molecular_formula_size(const void *p) {
+    const molecular_formula *s = p;
+    return string_size(s->formula) + TYPST_INT_SIZE + TYPST_INT_SIZE;
+}
+
+int encode_molecular_formula(const molecular_formula *s) {
+    size_t buffer_len = molecular_formula_size(s);
+    INIT_BUFFER_PACK(buffer_len)
     int err;
     (void)err;
-    NEXT_STR(out->smiles)
+    STR_PACK(s->formula)
+    FLOAT_PACK(s->exact_mass)
+    FLOAT_PACK(s->average_mass)
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
+    return 0;
+}
+
+void free_canonical(canonical *s) {
+    free(s->smiles);
+    free(s->hash);
+}
+
+size_t canonical_size(const void *p) {
+    const canonical *s = p;
+    return string_size(s->smiles) + string_size(s->hash);
+}
+
+int encode_canonical(const canonical *s) {
+    size_t buffer_len = canonical_size(s);
+    INIT_BUFFER_PACK(buffer_len)
+    int err;
+    (void)err;
+    STR_PACK(s->smiles)
+    STR_PACK(s->hash)
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
     FREE_BUFFER()
     return 0;
 }
+
+void free_validation(validation *s) {
+    free_Validation(&s->result);
+}
+
+size_t validation_size(const void *p) {
+    const validation *s = p;
+    return Validation_size(&s->result);
+}
+
+int encode_validation(const validation *s) {
+    size_t buffer_len = validation_size(s);
+    INIT_BUFFER_PACK(buffer_len)
+    int err;
+    (void)err;
+    if ((err = encode_Validation(&s->result, __input_buffer, &buffer_len, &__buffer_offset))) {
+        FREE_BUFFER()
+        return err;
+    }
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
+    return 0;
+}
+
+void free_validation_batch(validation_batch *s) {
+    for (size_t i = 0; i < s->results_len; i++) {
+        free_Validation(&s->results[i]);
+    }
+    free(s->results);
+}
+
+size_t validation_batch_size(const void *p) {
+    const validation_batch *s = p;
+    return TYPST_INT_SIZE +
+           list_size(s->results, s->results_len, Validation_size, sizeof(*s->results));
+}
+
+int encode_validation_batch(const validation_batch *s) {
+    size_t buffer_len = validation_batch_size(s);
+    INIT_BUFFER_PACK(buffer_len)
+    int err;
+    (void)err;
+    INT_PACK(s->results_len)
+    for (size_t i = 0; i < s->results_len; i++) {
+        if ((err = encode_Validation(&s->results[i], __input_buffer, &buffer_len,
+                                     &__buffer_offset))) {
+            FREE_BUFFER()
+            return err;
+        }
+    }
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
+    return 0;
+}
+
+void free_parse_stats(parse_stats *s) {
+    free_Validation(&s->result);
+    for (size_t i = 0; i < s->rules_len; i++) {
+        free_RuleStats(&s->rules[i]);
+    }
+    free(s->rules);
+}
+
+size_t parse_stats_size(const void *p) {
+    const parse_stats *s = p;
+    return Validation_size(&s->result) + TYPST_INT_SIZE +
+           list_size(s->rules, s->rules_len, RuleStats_size, sizeof(*s->rules)) + TYPST_INT_SIZE +
+           TYPST_INT_SIZE + TYPST_INT_SIZE + TYPST_INT_SIZE;
+}
+
+int encode_parse_stats(const parse_stats *s) {
+    size_t buffer_len = parse_stats_size(s);
+    INIT_BUFFER_PACK(buffer_len)
+    int err;
+    (void)err;
+    if ((err = encode_Validation(&s->result, __input_buffer, &buffer_len, &__buffer_offset))) {
+        FREE_BUFFER()
+        return err;
+    }
+    INT_PACK(s->rules_len)
+    for (size_t i = 0; i < s->rules_len; i++) {
+        if ((err = encode_RuleStats(&s->rules[i], __input_buffer, &buffer_len, &__buffer_offset))) {
+            FREE_BUFFER()
+            return err;
+        }
+    }
+    INT_PACK(s->max_depth)
+    INT_PACK(s->max_branch_depth)
+    INT_PACK(s->allocations)
+    INT_PACK(s->arena_bytes)
+    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);
+    FREE_BUFFER()
+    return 0;
+}
+
@@ -108,26 +108,174 @@ PROTOCOL_FUNCTION void wasm_minimal_protocol_write_args_to_buffer(uint8_t *ptr);
         __input_buffer[__buffer_offset + __str_len] = '\0';                                       \
         __buffer_offset += __str_len + 1;                                                          \
     }
+
 typedef struct ASTElement_t {
     int type;
     int from;
     int to;
-    char* value;
-    struct ASTElement_t * children;
+    char *value;
+    struct ASTElement_t *children;
     size_t children_len;
 } ASTElement;
 void free_ASTElement(ASTElement *s);
 
+typedef struct AtomRecord_t {
+    char element;
+    char aromatic;
+    char chirality;
+    int8_t hydrogens;
+    int8_t charge;
+    int isotope;
+    int atom_class;
+    int from;
+    int to;
+} AtomRecord;
+void free_AtomRecord(AtomRecord *s);
+
+typedef struct BondRecord_t {
+    int begin;
+    int end;
+    int from;
+    char symbol;
+    int8_t ring;
+} BondRecord;
+void free_BondRecord(BondRecord *s);
+
+typedef struct Atom_t {
+    char element;
+    char aromatic;
+    char implicit_hydrogens;
+    char chirality;
+    int isotope;
+    int charge;
+    int hydrogens;
+    int atom_class;
+    int from;
+    int to;
+    float x;
+    float y;
+} Atom;
+void free_Atom(Atom *s);
+
+typedef struct Bond_t {
+    int begin;
+    int end;
+    char order;
+    char aromatic;
+    char symbol;
+} Bond;
+void free_Bond(Bond *s);
+
+typedef struct Validation_t {
+    int code;
+    int position;
+} Validation;
+void free_Validation(Validation *s);
+
+typedef struct RuleStats_t {
+    char *rule;
+    int calls;
+    int failures;
+    int backtracks;
+    int rescanned;
+    int allocations;
+} RuleStats;
+void free_RuleStats(RuleStats *s);
+
+typedef struct parse_t {
+    char *smiles;
+} parse;
+void free_parse(parse *s);
+int decode_parse(size_t buffer_len, parse *out);
+
+typedef struct parse_batch_t {
+    char **smiles;
+    size_t smiles_len;
+} parse_batch;
+void free_parse_batch(parse_batch *s);
+int decode_parse_batch(size_t buffer_len, parse_batch *out);
+
 typedef struct result_t {
     struct ASTElement_t result;
 } result;
 void free_result(result *s);
 int encode_result(const result *s);
 
-typedef struct parse_t {
-    char* smiles;
-} parse;
-void free_parse(parse *s);
-int decode_parse(size_t buffer_len, parse *out);
+typedef struct records_t {
+    struct AtomRecord_t *atoms;
+    size_t atoms_len;
+    struct BondRecord_t *bonds;
+    size_t bonds_len;
+} records;
+void free_records(records *s);
+int encode_records(const records *s);
+
+typedef struct graph_t {
+    struct Atom_t *atoms;
+    size_t atoms_len;
+    struct Bond_t *bonds;
+    size_t bonds_len;
+    int *adjacency_offsets;
+    size_t adjacency_offsets_len;
+    int *adjacency;
+    size_t adjacency_len;
+    int *adjacency_bonds;
+    size_t adjacency_bonds_len;
+} graph;
+void free_graph(graph *s);
+int encode_graph(const graph *s);
+
+typedef struct ring_membership_t {
+    int *rings;
+    size_t rings_len;
+    int *ring_offsets;
+    size_t ring_offsets_len;
+    int *atom_rings;
+    size_t atom_rings_len;
+    int *atom_ring_offsets;
+    size_t atom_ring_offsets_len;
+} ring_membership;
+void free_ring_membership(ring_membership *s);
+int encode_ring_membership(const ring_membership *s);
+
+typedef struct molecular_formula_t {
+    char *formula;
+    float exact_mass;
+    float average_mass;
+} molecular_formula;
+void free_molecular_formula(molecular_formula *s);
+int encode_molecular_formula(const molecular_formula *s);
+
+typedef struct canonical_t {
+    char *smiles;
+    char *hash;
+} canonical;
+void free_canonical(canonical *s);
+int encode_canonical(const canonical *s);
+
+typedef struct validation_t {
+    struct Validation_t result;
+} validation;
+void free_validation(validation *s);
+int encode_validation(const validation *s);
+
+typedef struct validation_batch_t {
+    struct Validation_t *results;
+    size_t results_len;
+} validation_batch;
+void free_validation_batch(validation_batch *s);
+int encode_validation_batch(const validation_batch *s);
+
+typedef struct parse_stats_t {
+    struct Validation_t result;
+    struct RuleStats_t *rules;
+    size_t rules_len;
+    int max_depth;
+    int max_branch_depth;
+    int allocations;
+    int arena_bytes;
+} parse_stats;
+void free_parse_stats(parse_stats *s);
+int encode_parse_stats(const parse_stats *s);
 
 #endif
@@ -0,0 +1,277 @@
+// Native throughput benchmark of smile() and encode_result over generated
+// corpora of different shapes, then of encode_result alone on 10000-atom
+// molecules. Every measure runs in a process of its own and prints one JSON
+// object, so that numbers can be compared across releases:
+//   ./bench_parser [seconds per corpus]
+#include "parser/parser.h"
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Results are only measured, never sent anywhere.
+static size_t sent_bytes = 0;
+
+void wasm_minimal_protocol_write_args_to_buffer(uint8_t *ptr) {
+}
+
+void wasm_minimal_protocol_send_result_to_host(const uint8_t *ptr, size_t len) {
+    sent_bytes += len;
+}
+
+// Molecules of a corpus, one per line.
+typedef struct corpus {
+    const char *name;
+    char *text;
+    size_t len;
+    size_t capacity;
+    size_t molecules;
+} corpus;
+
+void append(corpus *c, const char *str) {
+    size_t len = strlen(str);
+    if (c->len + len + 1 > c->capacity) {
+        c->capacity = (c->len + len + 1) * 2;
+        c->text = realloc(c->text, c->capacity);
+    }
+    memcpy(c->text + c->len, str, len + 1);
+    c->len += len;
+}
+
+void end_molecule(corpus *c) {
+    append(c, "\n");
+    c->molecules++;
+}
+
+// xorshift32, so that every run benchmarks the same molecules.
+static uint32_t random_state = 2463534242u;
+
+uint32_t next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+const char *drugs[] = {
+    "CC(=O)Oc1ccccc1C(=O)O",
+    "CN1C=NC2=C1C(=O)N(C(=O)N2C)C",
+    "CC(C)Cc1ccc(cc1)[C@@H](C)C(=O)O",
+    "CC(=O)Nc1ccc(O)cc1",
+    "CN1[C@@H]2CC[C@H]1[C@H]([C@H](C2)OC(=O)c1ccccc1)C(=O)OC",
+    "OC[C@@H](O1)[C@@H](O)[C@H](O)[C@@H](O)[C@@H]1O",
+    "CN1CCC[C@H]1c1cccnc1",
+    "CN1C(=O)CN=C(c2ccccc2)c2cc(Cl)ccc21",
+    "C[C@]12CC[C@H]3[C@@H](CCc4cc(O)ccc34)[C@@H]1CC[C@@H]2O",
+    "CC(C)NCC(O)COc1cccc2ccccc12",
+    "C/C=C/C(=O)N[C@@H](Cc1c[nH]c2ccccc12)C(=O)O",
+    "[Na+].[O-]C(=O)c1ccccc1O",
+};
+
+corpus drug_like(void) {
+    corpus c = {.name = "drug_like"};
+    for (size_t i = 0; i < 20000; i++) {
+        append(&c, drugs[i % (sizeof(drugs) / sizeof(drugs[0]))]);
+        end_molecule(&c);
+    }
+    return c;
+}
+
+corpus long_chains(void) {
+    corpus c = {.name = "long_chains"};
+    const char *atoms[] = {"C", "C", "C", "O", "N", "C=C", "CC#C"};
+    for (size_t i = 0; i < 20; i++) {
+        for (size_t j = 0; j < 10000; j++) {
+            append(&c, atoms[next_random() % (sizeof(atoms) / sizeof(atoms[0]))]);
+        }
+        end_molecule(&c);
+    }
+    return c;
+}
+
+corpus deep_branches(void) {
+    corpus c = {.name = "deep_branches"};
+    for (size_t i = 0; i < 100; i++) {
+        size_t depth = 500 + next_random() % 1000;
+        for (size_t j = 0; j < depth; j++) {
+            append(&c, next_random() % 4 ? "C(" : "C(C)(");
+        }
+        append(&c, "C");
+        for (size_t j = 0; j < depth; j++) {
+            append(&c, ")");
+        }
+        end_molecule(&c);
+    }
+    return c;
+}
+
+corpus bracket_heavy(void) {
+    corpus c = {.name = "bracket_heavy"};
+    const char *atoms[] = {"[13CH3]", "[NH4+]", "[O-]", "[C@@H]",  "[Fe+2]",  "[2H]",
+                           "[CH2:7]", "[nH]",   "[Se]", "[C@TH1]", "[OH2+]", "[Pt@SP1]"};
+    const char *bonds[] = {"", "", "-", "=", "."};
+    for (size_t i = 0; i < 5000; i++) {
+        size_t len = 5 + next_random() % 20;
+        for (size_t j = 0; j < len; j++) {
+            if (j > 0) {
+                append(&c, bonds[next_random() % (sizeof(bonds) / sizeof(bonds[0]))]);
+            }
+            append(&c, atoms[next_random() % (sizeof(atoms) / sizeof(atoms[0]))]);
+        }
+        end_molecule(&c);
+    }
+    return c;
+}
+
+// Ring closures opened and closed at random, up to 30 open at once, so that
+// both digits and %nn labels are used.
+corpus ring_closures(void) {
+    corpus c = {.name = "ring_closures"};
+    char label[8];
+    for (size_t i = 0; i < 2000; i++) {
+        bool open[100] = {false};
+        size_t open_len = 0;
+        size_t len = 50 + next_random() % 200;
+        for (size_t j = 0; j < len || open_len > 0; j++) {
+            append(&c, "C");
+            int n = next_random() % 31;
+            if (j < len && !open[n] && open_len < 30) {
+                open[n] = true;
+                open_len++;
+            } else if (j > 0) {
+                for (n = 0; !open[n]; n++) {
+                }
+                open[n] = false;
+                open_len--;
+            } else {
+                continue;
+            }
+            snprintf(label, sizeof(label), n < 10 ? "%d" : "%%%d", n);
+            append(&c, label);
+        }
+        end_molecule(&c);
+    }
+    return c;
+}
+
+double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Parses and encodes the whole corpus as many times as fit in the given
+// time, at least once.
+void bench(corpus *c, double seconds) {
+    size_t passes = 0, failed = 0, allocations = 0, arena_bytes = 0, peak_arena = 0;
+    sent_bytes = 0;
+    double start = now(), elapsed;
+    do {
+        char *line = c->text;
+        for (size_t i = 0; i < c->molecules; i++) {
+            size_t len = strcspn(line, "\n");
+            parser_ctx ctx = init_ctx(line, len);
+            result r = {.result = smile(&ctx)};
+            if (ctx.errored || encode_result(&r)) {
+                failed++;
+            }
+            size_t reserved = 0;
+            for (arena_block *block = ctx.arena.head; block; block = block->next) {
+                arena_bytes += block->used;
+                reserved += sizeof(arena_block) + block->size;
+            }
+            if (reserved > peak_arena) {
+                peak_arena = reserved;
+            }
+            allocations += ctx.arena.allocations;
+            free_ctx(&ctx);
+            line += len + 1;
+        }
+        passes++;
+        elapsed = now() - start;
+    } while (elapsed < seconds);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double molecules = (double)c->molecules * passes;
+    printf("{\"corpus\": \"%s\", \"molecules\": %zu, \"bytes\": %zu, \"passes\": %zu, "
+           "\"failed\": %zu, \"seconds\": %.3f, \"molecules_per_s\": %.0f, \"mb_per_s\": %.2f, "
+           "\"allocations_per_molecule\": %.1f, \"arena_bytes_per_molecule\": %.0f, "
+           "\"output_bytes_per_molecule\": %.0f, \"peak_arena_bytes\": %zu, "
+           "\"peak_rss_kb\": %ld}\n",
+           c->name, c->molecules, c->len, passes, failed / passes, elapsed, molecules / elapsed,
+           (double)c->len * passes / elapsed / 1e6, allocations / molecules,
+           arena_bytes / molecules, sent_bytes / molecules, peak_arena, usage.ru_maxrss);
+}
+
+// Times encode_result alone on one parsed molecule of 10000 atoms, as a
+// flat chain and as branches nested 10000 deep, which an encoder re-sizing
+// every subtree would take quadratic time on.
+void bench_encode(const char *name, bool nested, double seconds) {
+    size_t atoms = 10000;
+    corpus c = {0};
+    for (size_t i = 0; i < atoms; i++) {
+        append(&c, nested && i > 0 ? "(C" : "C");
+    }
+    for (size_t i = 1; nested && i < atoms; i++) {
+        append(&c, ")");
+    }
+    parser_ctx ctx = init_ctx(c.text, c.len);
+    result r = {.result = smile(&ctx)};
+    size_t passes = 0, failed = 0;
+    sent_bytes = 0;
+    double start = now(), elapsed;
+    do {
+        failed += ctx.errored || encode_result(&r);
+        passes++;
+        elapsed = now() - start;
+    } while (elapsed < seconds);
+    printf("{\"encode\": \"%s\", \"atoms\": %zu, \"passes\": %zu, \"failed\": %zu, "
+           "\"output_bytes\": %zu, \"ms_per_encode\": %.3f}\n",
+           name, atoms, passes, failed, sent_bytes / passes, elapsed * 1e3 / passes);
+    free_ctx(&ctx);
+    free(c.text);
+}
+
+// Runs a measure in a child process so that the peak RSS it reports is its
+// own, not the largest of every measure run before it.
+bool run_forked(void (*measure)(size_t, double), size_t index, double seconds) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        measure(index, seconds);
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0) {
+        perror("bench_parser");
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+corpus (*corpora[])(void) = {drug_like, long_chains, deep_branches, bracket_heavy, ring_closures};
+
+void bench_corpus(size_t index, double seconds) {
+    corpus c = corpora[index]();
+    bench(&c, seconds);
+    free(c.text);
+}
+
+void bench_encodes(size_t index, double seconds) {
+    bench_encode(index == 0 ? "chain" : "nested_branches", index != 0, seconds);
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+        ok &= run_forked(bench_corpus, i, seconds);
+    }
+    for (size_t i = 0; i < 2; i++) {
+        ok &= run_forked(bench_encodes, i, seconds);
+    }
+    return ok ? 0 : 1;
+}
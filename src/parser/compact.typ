@@ -0,0 +1,65 @@
+/// Decoder of the compact encoding of parse_smiles_compact, see
+/// parser/compact.h for the layout.
+
+/// Decodes a LEB128 varint from the given bytes at the given offset.
+#let decode-varint(bytes, offset) = {
+  let result = 0
+  let shift = 1
+  while bytes.at(offset) >= 0x80 {
+    result += (bytes.at(offset) - 0x80) * shift
+    shift *= 0x80
+    offset += 1
+  }
+  (result + bytes.at(offset) * shift, offset + 1)
+}
+
+/// Decodes a zigzag varint, negative numbers being the odd ones.
+#let decode-zigzag(bytes, offset) = {
+  let (value, offset) = decode-varint(bytes, offset)
+  if calc.odd(value) {
+    (-calc.quo(value + 1, 2), offset)
+  } else {
+    (calc.quo(value, 2), offset)
+  }
+}
+
+/// Decodes an element and its children at the given offset, `from` being
+/// the start of the element written before it. Returns the element, the
+/// offset after it and the start of the last element read.
+#let decode-compact-element(bytes, offset, from) = {
+  let tag = bytes.at(offset)
+  let (delta, offset) = decode-zigzag(bytes, offset + 1)
+  let (length, offset) = decode-zigzag(bytes, offset)
+  let start = from + delta
+  let value = ""
+  if tag >= 0x80 {
+    let (len, value-offset) = decode-varint(bytes, offset)
+    value = str(bytes.slice(value-offset, value-offset + len))
+    offset = value-offset + len
+  }
+  let children = ()
+  let last = start
+  if calc.rem(calc.quo(tag, 0x40), 2) == 1 {
+    let (count, children-offset) = decode-varint(bytes, offset)
+    offset = children-offset
+    for i in range(0, count) {
+      let (child, next-offset, next-last) = decode-compact-element(bytes, offset, last)
+      children.push(child)
+      offset = next-offset
+      last = next-last
+    }
+  }
+  ((
+    type: calc.rem(tag, 0x40) - 1,
+    from: start,
+    to: start + length,
+    value: value,
+    children: children,
+  ), offset, last)
+}
+
+/// Decodes a tree sent by parse_smiles_compact, the same dictionary as
+/// decode-ASTElement gives.
+#let decode-compact(bytes) = {
+  decode-compact-element(bytes, 0, 0).at(0)
+}
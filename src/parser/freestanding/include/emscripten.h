@@ -0,0 +1,7 @@
+#ifndef FREESTANDING_EMSCRIPTEN_H
+#define FREESTANDING_EMSCRIPTEN_H
+
+// Exports of the module, everything else is hidden and may be removed.
+#define EMSCRIPTEN_KEEPALIVE __attribute__((used, visibility("default")))
+
+#endif
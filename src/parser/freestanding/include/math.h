@@ -0,0 +1,18 @@
+#ifndef FREESTANDING_MATH_H
+#define FREESTANDING_MATH_H
+
+#define M_PI 3.14159265358979323846
+#define M_PI_4 0.78539816339744830962
+
+double sqrt(double x);
+double floor(double x);
+double fabs(double x);
+double fmin(double x, double y);
+double fmax(double x, double y);
+
+double sin(double x);
+double cos(double x);
+void sincos(double x, double *s, double *c);
+double atan2(double y, double x);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef FREESTANDING_STDLIB_H
+#define FREESTANDING_STDLIB_H
+
+#include <stddef.h>
+
+void *malloc(size_t size);
+void *calloc(size_t count, size_t size);
+void *realloc(void *ptr, size_t size);
+void free(void *ptr);
+
+int atoi(const char *str);
+void qsort(void *base, size_t len, size_t size, int (*compare)(const void *, const void *));
+
+#endif
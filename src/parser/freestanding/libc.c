@@ -0,0 +1,393 @@
+// The little of the C library the parser uses, for the freestanding build:
+// an allocator over the wasm linear memory, string functions, qsort and the
+// math functions of the depiction. There is no printf family, the parser
+// writes its numbers with parser/text.c.
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PAGE_SIZE 65536
+
+// Blocks start with a header holding their size, which keeps the 16-byte
+// alignment of max_align_t for what follows it.
+#define HEADER_SIZE 16
+
+typedef struct block_header {
+    size_t size;
+    size_t size_class;
+} block_header;
+
+// Sizes are rounded up to 32, 48 or 64 bytes, then to one of four sizes per
+// power of two, wasting at most a fifth of a block. Freed blocks are kept on
+// one list per size class and taken again by the next allocation of that
+// class. Everything else is bumped from the end of the heap.
+#define CLASS_COUNT (3 + 4 * (sizeof(size_t) * CHAR_BIT - 6))
+
+typedef struct free_block {
+    struct free_block *next;
+} free_block;
+
+static free_block *free_lists[CLASS_COUNT];
+static uintptr_t heap_top = 0;
+
+// First free byte after the data and the stack, set by the linker.
+extern unsigned char __heap_base;
+
+static size_t size_class(size_t size, size_t *block_size) {
+    if (size <= 64) {
+        *block_size = size <= 32 ? 32 : (size + 15) & ~(size_t)15;
+        return *block_size / 16 - 2;
+    }
+    int log = sizeof(size_t) * CHAR_BIT - 1 - __builtin_clzl(size - 1);
+    size_t step = (size_t)1 << (log - 2);
+    *block_size = (size + step - 1) & ~(step - 1);
+    return 3 + (log - 6) * 4 + (*block_size >> (log - 2)) - 5;
+}
+
+// Takes size bytes from the end of the heap, growing the memory as needed.
+static void *bump(size_t size) {
+    if (!heap_top) {
+        heap_top = ((uintptr_t)&__heap_base + HEADER_SIZE - 1) & ~(uintptr_t)(HEADER_SIZE - 1);
+    }
+    uintptr_t end = __builtin_wasm_memory_size(0) * PAGE_SIZE;
+    if (size > UINTPTR_MAX - heap_top) {
+        return NULL;
+    }
+    if (heap_top + size > end) {
+        size_t pages = (heap_top + size - end + PAGE_SIZE - 1) / PAGE_SIZE;
+        if (__builtin_wasm_memory_grow(0, pages) == (size_t)-1) {
+            return NULL;
+        }
+    }
+    void *ptr = (void *)heap_top;
+    heap_top += size;
+    return ptr;
+}
+
+void *malloc(size_t size) {
+    if (size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    size_t block_size;
+    size_t cls = size_class(size + HEADER_SIZE, &block_size);
+    block_header *block = (block_header *)free_lists[cls];
+    if (block) {
+        free_lists[cls] = free_lists[cls]->next;
+    } else {
+        block = bump(block_size);
+        if (!block) {
+            return NULL;
+        }
+    }
+    block->size = block_size;
+    block->size_class = cls;
+    return (unsigned char *)block + HEADER_SIZE;
+}
+
+void free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    block_header *block = (block_header *)((unsigned char *)ptr - HEADER_SIZE);
+    size_t cls = block->size_class;
+    free_block *freed = (free_block *)block;
+    freed->next = free_lists[cls];
+    free_lists[cls] = freed;
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return malloc(size);
+    }
+    block_header *block = (block_header *)((unsigned char *)ptr - HEADER_SIZE);
+    size_t capacity = block->size - HEADER_SIZE;
+    if (size <= capacity) {
+        return ptr;
+    }
+    void *moved = malloc(size);
+    if (moved) {
+        memcpy(moved, ptr, capacity);
+        free(ptr);
+    }
+    return moved;
+}
+
+void *calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = malloc(count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *memcpy(void *restrict dest, const void *restrict src, size_t n) {
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    while (n--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t n) {
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    if (d < s) {
+        while (n--) {
+            *d++ = *s++;
+        }
+    } else {
+        while (n--) {
+            d[n] = s[n];
+        }
+    }
+    return dest;
+}
+
+void *memset(void *dest, int c, size_t n) {
+    unsigned char *d = dest;
+    while (n--) {
+        *d++ = (unsigned char)c;
+    }
+    return dest;
+}
+
+int memcmp(const void *a, const void *b, size_t n) {
+    const unsigned char *x = a, *y = b;
+    for (size_t i = 0; i < n; i++) {
+        if (x[i] != y[i]) {
+            return x[i] - y[i];
+        }
+    }
+    return 0;
+}
+
+size_t strlen(const char *str) {
+    const char *end = str;
+    while (*end) {
+        end++;
+    }
+    return end - str;
+}
+
+int strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+char *strcpy(char *restrict dest, const char *restrict src) {
+    memcpy(dest, src, strlen(src) + 1);
+    return dest;
+}
+
+char *strcat(char *restrict dest, const char *restrict src) {
+    strcpy(dest + strlen(dest), src);
+    return dest;
+}
+
+char *strncat(char *restrict dest, const char *restrict src, size_t n) {
+    char *end = dest + strlen(dest);
+    while (n-- && *src) {
+        *end++ = *src++;
+    }
+    *end = '\0';
+    return dest;
+}
+
+int atoi(const char *str) {
+    bool negative = *str == '-';
+    if (*str == '-' || *str == '+') {
+        str++;
+    }
+    int value = 0;
+    while (*str >= '0' && *str <= '9') {
+        value = value * 10 + (*str++ - '0');
+    }
+    return negative ? -value : value;
+}
+
+static void swap_bytes(unsigned char *a, unsigned char *b, size_t size) {
+    while (size--) {
+        unsigned char tmp = *a;
+        *a++ = *b;
+        *b++ = tmp;
+    }
+}
+
+static void sift_down(unsigned char *base, size_t root, size_t len, size_t size,
+                      int (*compare)(const void *, const void *)) {
+    while (2 * root + 1 < len) {
+        size_t child = 2 * root + 1;
+        if (child + 1 < len && compare(base + child * size, base + (child + 1) * size) < 0) {
+            child++;
+        }
+        if (compare(base + root * size, base + child * size) >= 0) {
+            return;
+        }
+        swap_bytes(base + root * size, base + child * size, size);
+        root = child;
+    }
+}
+
+// Heapsort: no recursion and no extra memory.
+void qsort(void *base, size_t len, size_t size, int (*compare)(const void *, const void *)) {
+    unsigned char *bytes = base;
+    for (size_t i = len / 2; i-- > 0;) {
+        sift_down(bytes, i, len, size, compare);
+    }
+    for (size_t end = len; end-- > 1;) {
+        swap_bytes(bytes, bytes + end * size, size);
+        sift_down(bytes, 0, end, size, compare);
+    }
+}
+
+double sqrt(double x) {
+    return __builtin_sqrt(x);
+}
+
+double floor(double x) {
+    return __builtin_floor(x);
+}
+
+double fabs(double x) {
+    return __builtin_fabs(x);
+}
+
+double fmin(double x, double y) {
+    return x < y || y != y ? x : y;
+}
+
+double fmax(double x, double y) {
+    return x > y || y != y ? x : y;
+}
+
+// The kernels of sin, cos and atan use the minimax polynomials of fdlibm.
+// Arguments are reduced by multiples of pi / 2, which stays accurate for the
+// angles of a depiction, not for huge ones.
+#define PIO2_HI 1.57079632673412561417e+00
+#define PIO2_LO 6.07710050650619224932e-11
+
+static double sin_kernel(double x) {
+    double z = x * x;
+    return x + x * z *
+                   (-1.66666666666666324348e-01 +
+                    z * (8.33333333332248946124e-03 +
+                         z * (-1.98412698298579493134e-04 +
+                              z * (2.75573137070700676789e-06 +
+                                   z * (-2.50507602534068634195e-08 +
+                                        z * 1.58969099521155010221e-10)))));
+}
+
+static double cos_kernel(double x) {
+    double z = x * x;
+    return 1.0 - 0.5 * z +
+           z * z *
+               (4.16666666666666019037e-02 +
+                z * (-1.38888888888741095749e-03 +
+                     z * (2.48015872894767294178e-05 +
+                          z * (-2.75573143513906633035e-07 +
+                               z * (2.08757232129817482790e-09 +
+                                    z * -1.13596475577881948265e-11)))));
+}
+
+// x - n * pi / 2 in [-pi / 4, pi / 4], returning n modulo 4.
+static int reduce(double x, double *r) {
+    double n = __builtin_floor(x * 6.36619772367581382433e-01 + 0.5);
+    *r = (x - n * PIO2_HI) - n * PIO2_LO;
+    return (int)((long long)n & 3);
+}
+
+void sincos(double x, double *s, double *c) {
+    double r;
+    double sin_r, cos_r;
+    int quadrant = reduce(x, &r);
+    sin_r = sin_kernel(r);
+    cos_r = cos_kernel(r);
+    switch (quadrant) {
+        case 0:
+            *s = sin_r;
+            *c = cos_r;
+            break;
+        case 1:
+            *s = cos_r;
+            *c = -sin_r;
+            break;
+        case 2:
+            *s = -sin_r;
+            *c = -cos_r;
+            break;
+        default:
+            *s = -cos_r;
+            *c = sin_r;
+            break;
+    }
+}
+
+double sin(double x) {
+    double s, c;
+    sincos(x, &s, &c);
+    return s;
+}
+
+double cos(double x) {
+    double s, c;
+    sincos(x, &s, &c);
+    return c;
+}
+
+// atan of x in [-tan(pi / 8), tan(pi / 8)].
+static double atan_kernel(double x) {
+    double z = x * x, w = z * z;
+    double odd = z * (3.33333333333329318027e-01 +
+                      w * (1.42857142725034663711e-01 +
+                           w * (9.09088713343650656196e-02 +
+                                w * (6.66107313738753120669e-02 +
+                                     w * (4.97687799461593236017e-02 +
+                                          w * 1.62858201153657823623e-02)))));
+    double even = w * (-1.99999999998764832476e-01 +
+                       w * (-1.11111104054623557880e-01 +
+                            w * (-7.69187620504482999495e-02 +
+                                 w * (-5.83357013379057348645e-02 +
+                                      w * -3.65315727442169155270e-02))));
+    return x - x * (odd + even);
+}
+
+static double arctan(double x) {
+    bool negative = x < 0;
+    x = __builtin_fabs(x);
+    double offset = 0;
+    if (x > 1) {
+        // atan(x) = pi / 2 - atan(1 / x)
+        x = -1 / x;
+        offset = 2 * M_PI_4;
+    }
+    if (x > 4.14213562373095034199e-01) {
+        x = (x - 1) / (x + 1);
+        offset += M_PI_4;
+    } else if (x < -4.14213562373095034199e-01) {
+        x = (x + 1) / (1 - x);
+        offset -= M_PI_4;
+    }
+    double result = offset + atan_kernel(x);
+    return negative ? -result : result;
+}
+
+double atan2(double y, double x) {
+    if (x == 0) {
+        return y > 0 ? 2 * M_PI_4 : y < 0 ? -2 * M_PI_4 : y;
+    }
+    double a = arctan(y / x);
+    if (x > 0) {
+        return a;
+    }
+    return __builtin_signbit(y) ? a - M_PI : a + M_PI;
+}
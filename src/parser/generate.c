@@ -0,0 +1,320 @@
+// Deterministic generator of random SMILES for benchmarks and scaling tests,
+// one molecule per line on stdout. The same options and seed always give
+// the same molecules. Every production of the grammar is used: organic,
+// aromatic and bracket atoms with isotopes, every chirality class, hydrogen
+// counts, charges and classes, all bond symbols, dots, branches and ring
+// bonds with digits, %nn labels and bond symbols. Rings are always closed,
+// never on their own atom or on an existing bond, so that build_graph
+// accepts every molecule.
+//   ./generate_smiles [-s seed] [-n molecules] [-a atoms] [-d depth]
+//                     [-B branches] [-r rings] [-p percent] [-b brackets]
+#include "parser/elements.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct generator_options {
+    uint64_t seed;
+    long molecules;
+    long atoms;
+    // deepest nesting of branches and chance of opening one after an atom
+    int depth;
+    double branches;
+    // chance of opening a ring bond on an atom and share of ring labels
+    // written as %nn
+    double rings;
+    double percent;
+    // share of atoms written in brackets
+    double brackets;
+} generator_options;
+
+// xorshift64*
+static uint64_t random_state;
+
+uint64_t next_random(void) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [0, n).
+int random_below(int n) {
+    return (next_random() >> 33) % n;
+}
+
+bool chance(double p) {
+    return (next_random() >> 11) * 0x1.0p-53 < p;
+}
+
+const char *organic_atoms[] = {"C", "C", "C", "C", "N", "O", "S", "P", "B", "F", "Cl", "Br", "I"};
+
+// Aromatic rings written as one unit, 1 standing for a free ring label. They
+// are only bonded through their first and last atom, which keeps them
+// kekulizable.
+const struct {
+    const char *smiles;
+    int atoms;
+} aromatic_rings[] = {
+    {"c1ccccc1", 6}, {"c1ccncc1", 6},   {"c1cc[nH]c1", 5},      {"c1ccoc1", 5},
+    {"c1ccsc1", 5},  {"c1c[se]cc1", 5}, {"c1:c:c:c:c:c:1", 6},
+};
+
+const struct {
+    const char *name;
+    int max;
+} chiral_classes[] = {{"TH", 2}, {"AL", 2}, {"SP", 3}, {"TB", 20}, {"OH", 30}};
+
+// State of the molecule being written. Atoms are numbered in order.
+typedef struct generator {
+    const generator_options *options;
+    int atoms;
+    // atom opening each ring label, -1 when the label is free
+    int ring_opener[100];
+    int open_rings;
+    // atom each open branch starts from
+    int *branch_parents;
+    int depth;
+} generator;
+
+void write_label(int label) {
+    if (label < 10) {
+        printf("%d", label);
+    } else {
+        printf("%%%02d", label);
+    }
+}
+
+// Free ring label, from 10 to 99 for the requested share of them and from 0
+// to 9 otherwise, falling back on the other range. -1 when all are used.
+int free_label(generator *gen) {
+    const int ranges[2][2] = {{0, 10}, {10, 90}};
+    bool percent = chance(gen->options->percent);
+    for (int r = 0; r < 2; r++) {
+        int first = ranges[percent ^ r][0], count = ranges[percent ^ r][1];
+        int start = random_below(count);
+        for (int i = 0; i < count; i++) {
+            int label = first + (start + i) % count;
+            if (gen->ring_opener[label] < 0) {
+                return label;
+            }
+        }
+    }
+    return -1;
+}
+
+void write_bracket_atom(void) {
+    putchar('[');
+    if (chance(0.2)) {
+        printf("%d", 1 + random_below(250));
+    }
+    // drawn again until the parser knows the symbol, it lacks the newest ones
+    const char *symbol;
+    size_t len;
+    do {
+        symbol = atomic_symbols[random_below(ELEMENT_COUNT)];
+    } while (symbol[0] != '*' &&
+             (!lookup_symbol(&element_symbols_table, symbol, strlen(symbol), &len) ||
+              len != strlen(symbol)));
+    fputs(symbol, stdout);
+    if (chance(0.3)) {
+        int n = random_below(7);
+        if (n < 2) {
+            fputs(n ? "@@" : "@", stdout);
+        } else {
+            n -= 2;
+            printf("@%s%d", chiral_classes[n].name, 1 + random_below(chiral_classes[n].max));
+        }
+    }
+    if (chance(0.5)) {
+        putchar('H');
+        if (chance(0.5)) {
+            printf("%d", random_below(10));
+        }
+    }
+    if (chance(0.3)) {
+        putchar(chance(0.5) ? '+' : '-');
+        if (chance(0.5)) {
+            printf("%d", random_below(16));
+        }
+    }
+    if (chance(0.1)) {
+        printf(":%d", random_below(1000));
+    }
+    putchar(']');
+}
+
+// Writes the next atom, bonded to parent unless it is -1, and returns
+// whether it is aromatic.
+bool write_atom(generator *gen, int parent, bool parent_aromatic) {
+    int label = chance(0.05) ? free_label(gen) : -1;
+    bool aromatic = label >= 0;
+    if (parent >= 0) {
+        int n = random_below(12);
+        if (aromatic && parent_aromatic) {
+            // a bond between two aromatic rings is spelled out as single
+            putchar('-');
+        } else if (aromatic || parent_aromatic) {
+            fputs(n < 2 ? "-" : "", stdout);
+        } else if (n < 7) {
+            fputs((const char *[]){"-", "=", "#", "$", "/", "\\", ""}[n], stdout);
+        }
+    }
+    if (aromatic) {
+        int n = random_below(sizeof(aromatic_rings) / sizeof(aromatic_rings[0]));
+        for (const char *c = aromatic_rings[n].smiles; *c; c++) {
+            if (*c == '1') {
+                write_label(label);
+            } else {
+                putchar(*c);
+            }
+        }
+        gen->atoms += aromatic_rings[n].atoms;
+        return true;
+    }
+    if (chance(gen->options->brackets)) {
+        write_bracket_atom();
+    } else if (chance(0.02)) {
+        putchar('*');
+    } else {
+        fputs(organic_atoms[random_below(sizeof(organic_atoms) / sizeof(organic_atoms[0]))],
+              stdout);
+    }
+    gen->atoms++;
+    return false;
+}
+
+// Closes at most one open ring on the atom, never one opened by the atom
+// itself or by its parent, then maybe opens a new one.
+void write_ring_bonds(generator *gen, int atom, int parent, bool must_close) {
+    if (gen->open_rings > 0 && (must_close || chance(0.5))) {
+        int start = random_below(100);
+        for (int i = 0; i < 100; i++) {
+            int label = (start + i) % 100;
+            int opener = gen->ring_opener[label];
+            if (opener < 0 || opener == atom || opener == parent) {
+                continue;
+            }
+            if (chance(0.2)) {
+                putchar(chance(0.5) ? '=' : '-');
+            }
+            write_label(label);
+            gen->ring_opener[label] = -1;
+            gen->open_rings--;
+            break;
+        }
+    }
+    int label;
+    if (!must_close && chance(gen->options->rings) && (label = free_label(gen)) >= 0) {
+        write_label(label);
+        gen->ring_opener[label] = atom;
+        gen->open_rings++;
+    }
+}
+
+void write_molecule(generator *gen) {
+    gen->atoms = 0;
+    gen->open_rings = 0;
+    gen->depth = 0;
+    for (int i = 0; i < 100; i++) {
+        gen->ring_opener[i] = -1;
+    }
+    int parent = -1;
+    bool parent_aromatic = false;
+    while (gen->atoms < gen->options->atoms || gen->open_rings > 0) {
+        bool closing = gen->atoms >= gen->options->atoms;
+        if (parent >= 0 && gen->depth == 0 && gen->open_rings == 0 && chance(0.01)) {
+            putchar('.');
+            parent = -1;
+        }
+        bool aromatic = write_atom(gen, parent, parent_aromatic);
+        int atom = gen->atoms - 1;
+        if (!aromatic) {
+            write_ring_bonds(gen, atom, parent, closing);
+        }
+        parent = atom;
+        parent_aromatic = aromatic;
+        if (!aromatic && gen->atoms < gen->options->atoms && gen->depth < gen->options->depth &&
+            chance(gen->options->branches)) {
+            putchar('(');
+            gen->branch_parents[gen->depth] = atom;
+            gen->depth++;
+            continue;
+        }
+        while (gen->depth > 0 && (closing || chance(gen->options->branches))) {
+            putchar(')');
+            gen->depth--;
+            parent = gen->branch_parents[gen->depth];
+            parent_aromatic = false;
+        }
+    }
+    for (; gen->depth > 0; gen->depth--) {
+        putchar(')');
+    }
+    putchar('\n');
+}
+
+int main(int argc, char **argv) {
+    generator_options options = {
+        .seed = 1,
+        .molecules = 1000,
+        .atoms = 30,
+        .depth = 4,
+        .branches = 0.2,
+        .rings = 0.1,
+        .percent = 0.1,
+        .brackets = 0.1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:a:d:B:r:p:b:")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.molecules = atol(optarg);
+                break;
+            case 'a':
+                options.atoms = atol(optarg);
+                break;
+            case 'd':
+                options.depth = atoi(optarg);
+                break;
+            case 'B':
+                options.branches = atof(optarg);
+                break;
+            case 'r':
+                options.rings = atof(optarg);
+                break;
+            case 'p':
+                options.percent = atof(optarg);
+                break;
+            case 'b':
+                options.brackets = atof(optarg);
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-s seed] [-n molecules] [-a atoms] [-d depth] "
+                        "[-B branches] [-r rings] [-p percent] [-b brackets]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (options.depth < 0 || options.atoms < 1) {
+        fprintf(stderr, "%s: atoms must be positive and depth not negative\n", argv[0]);
+        return 1;
+    }
+
+    random_state = options.seed * 0x9E3779B97F4A7C15ULL + 1;
+    generator gen = {
+        .options = &options,
+        .branch_parents = malloc(sizeof(int) * (options.depth + 1)),
+    };
+    for (long i = 0; i < options.molecules; i++) {
+        write_molecule(&gen);
+    }
+    free(gen.branch_parents);
+    return 0;
+}
@@ -0,0 +1,293 @@
+// Host running the built smiles.wasm outside Typst, the counterpart of
+// test/wasm.h for the wasm module. It embeds any runtime implementing the
+// standard wasm C API (wasm.h), provides the typst_env imports and calls an
+// export on every line of a corpus, then prints one JSON object with the
+// module size, instantiation time, call latencies and linear memory growth:
+//   ./wasm_host [-r] smiles.wasm [function] < corpus
+// Each line is passed as the only argument of the function, NUL terminated as
+// Typst's encode-parse does. With -r the host prints, per line, the return
+// value and the bytes sent back in hex instead, as test/exports.c does for
+// the native build.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wasm.h>
+
+#define WASM_PAGE_SIZE 65536
+
+typedef struct host {
+    wasm_memory_t *memory;
+    // argument of the current call and last result sent back
+    const char *args;
+    size_t args_len;
+    size_t result_len;
+    bool out_of_bounds;
+    // copy of the last result, kept with -r only
+    bool keep_result;
+    uint8_t *result;
+} host;
+
+double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Memory is looked up on every access as the module may grow it.
+bool in_memory(host *h, uint32_t ptr, size_t len) {
+    if ((size_t)ptr + len > wasm_memory_data_size(h->memory)) {
+        h->out_of_bounds = true;
+        return false;
+    }
+    return true;
+}
+
+wasm_trap_t *write_args_to_buffer(void *env, const wasm_val_vec_t *args, wasm_val_vec_t *results) {
+    host *h = env;
+    uint32_t ptr = args->data[0].of.i32;
+    if (in_memory(h, ptr, h->args_len)) {
+        memcpy(wasm_memory_data(h->memory) + ptr, h->args, h->args_len);
+    }
+    return NULL;
+}
+
+wasm_trap_t *send_result_to_host(void *env, const wasm_val_vec_t *args, wasm_val_vec_t *results) {
+    host *h = env;
+    uint32_t ptr = args->data[0].of.i32, len = args->data[1].of.i32;
+    if (in_memory(h, ptr, len)) {
+        h->result_len = len;
+        if (h->keep_result) {
+            free(h->result);
+            h->result = malloc(len + 1);
+            memcpy(h->result, wasm_memory_data(h->memory) + ptr, len);
+        }
+    }
+    return NULL;
+}
+
+wasm_byte_vec_t read_file(const char *path) {
+    wasm_byte_vec_t bytes = {0};
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return bytes;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    wasm_byte_vec_new_uninitialized(&bytes, size);
+    if (fread(bytes.data, 1, size, f) != (size_t)size) {
+        wasm_byte_vec_delete(&bytes);
+    }
+    fclose(f);
+    return bytes;
+}
+
+void print_trap(const char *what, wasm_trap_t *trap) {
+    wasm_message_t message;
+    wasm_trap_message(trap, &message);
+    fprintf(stderr, "%s: %.*s\n", what, (int)message.size, message.data);
+    wasm_byte_vec_delete(&message);
+    wasm_trap_delete(trap);
+}
+
+// Export of the instance with the given name, NULL when there is none.
+wasm_extern_t *find_export(const wasm_module_t *module, const wasm_extern_vec_t *exports,
+                           const char *name) {
+    wasm_exporttype_vec_t types;
+    wasm_module_exports(module, &types);
+    wasm_extern_t *found = NULL;
+    for (size_t i = 0; i < types.size && i < exports->size; i++) {
+        const wasm_name_t *export_name = wasm_exporttype_name(types.data[i]);
+        if (export_name->size == strlen(name) &&
+            memcmp(export_name->data, name, export_name->size) == 0) {
+            found = exports->data[i];
+            break;
+        }
+    }
+    wasm_exporttype_vec_delete(&types);
+    return found;
+}
+
+int main(int argc, char **argv) {
+    bool print_results = argc > 1 && strcmp(argv[1], "-r") == 0;
+    int arg = print_results ? 2 : 1;
+    if (argc <= arg) {
+        fprintf(stderr, "usage: %s [-r] module.wasm [function] < corpus\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[arg];
+    const char *function = argc > arg + 1 ? argv[arg + 1] : "parse_smiles";
+    wasm_byte_vec_t binary = read_file(path);
+    if (!binary.data) {
+        fprintf(stderr, "%s: cannot read %s\n", argv[0], path);
+        return 1;
+    }
+
+    size_t module_bytes = binary.size;
+    double start = now();
+    wasm_engine_t *engine = wasm_engine_new();
+    wasm_store_t *store = wasm_store_new(engine);
+    wasm_module_t *module = wasm_module_new(store, &binary);
+    wasm_byte_vec_delete(&binary);
+    if (!module) {
+        fprintf(stderr, "%s: cannot compile %s\n", argv[0], path);
+        return 1;
+    }
+    double compiled = now();
+
+    // typst_env imports, in the order the module declares them
+    host h = {.keep_result = print_results};
+    wasm_importtype_vec_t import_types;
+    wasm_module_imports(module, &import_types);
+    wasm_extern_t *imports[import_types.size];
+    wasm_func_t *funcs[import_types.size];
+    for (size_t i = 0; i < import_types.size; i++) {
+        const wasm_name_t *name = wasm_importtype_name(import_types.data[i]);
+        const wasm_functype_t *type =
+            wasm_externtype_as_functype_const(wasm_importtype_type(import_types.data[i]));
+        wasm_func_callback_with_env_t callback = NULL;
+        if (name->size == strlen("wasm_minimal_protocol_write_args_to_buffer") &&
+            memcmp(name->data, "wasm_minimal_protocol_write_args_to_buffer", name->size) == 0) {
+            callback = write_args_to_buffer;
+        } else if (name->size == strlen("wasm_minimal_protocol_send_result_to_host") &&
+                   memcmp(name->data, "wasm_minimal_protocol_send_result_to_host",
+                          name->size) == 0) {
+            callback = send_result_to_host;
+        }
+        if (!callback || !type) {
+            fprintf(stderr, "%s: unknown import %.*s\n", argv[0], (int)name->size, name->data);
+            return 1;
+        }
+        funcs[i] = wasm_func_new_with_env(store, type, callback, &h, NULL);
+        imports[i] = wasm_func_as_extern(funcs[i]);
+    }
+    wasm_extern_vec_t import_vec = {import_types.size, imports};
+    wasm_trap_t *trap = NULL;
+    wasm_instance_t *instance = wasm_instance_new(store, module, &import_vec, &trap);
+    wasm_importtype_vec_delete(&import_types);
+    if (!instance) {
+        if (trap) {
+            print_trap("instantiation", trap);
+        }
+        return 1;
+    }
+
+    wasm_extern_vec_t exports;
+    wasm_instance_exports(instance, &exports);
+    wasm_extern_t *memory = find_export(module, &exports, "memory");
+    wasm_extern_t *export = find_export(module, &exports, function);
+    wasm_extern_t *initialize = find_export(module, &exports, "_initialize");
+    if (!memory || !export || !wasm_extern_as_func(export)) {
+        fprintf(stderr, "%s: the module exports no memory or no %s\n", argv[0], function);
+        return 1;
+    }
+    h.memory = wasm_extern_as_memory(memory);
+    wasm_func_t *func = wasm_extern_as_func(export);
+    // emscripten runs its constructors from _initialize when built without main
+    if (initialize && wasm_extern_as_func(initialize)) {
+        wasm_val_vec_t none = WASM_EMPTY_VEC;
+        trap = wasm_func_call(wasm_extern_as_func(initialize), &none, &none);
+        if (trap) {
+            print_trap("_initialize", trap);
+            return 1;
+        }
+    }
+    double instantiated = now();
+    size_t initial_memory = wasm_memory_data_size(h.memory);
+
+    size_t calls = 0, capacity = 1024, errors = 0, traps = 0, growths = 0;
+    size_t input_bytes = 0, output_bytes = 0;
+    double *latencies = malloc(sizeof(double) * capacity);
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t len;
+    while ((len = getline(&line, &line_capacity, stdin)) > 0) {
+        if (line[len - 1] == '\n') {
+            len--;
+        }
+        // Typst encodes a str argument with its terminating NUL, so does the host
+        line[len] = '\0';
+        h.args = line;
+        h.args_len = len + 1;
+        h.result_len = 0;
+        size_t memory_before = wasm_memory_data_size(h.memory);
+        wasm_val_t arg_vals[1] = {WASM_I32_VAL(len + 1)};
+        wasm_val_t result_vals[1] = {WASM_INIT_VAL};
+        wasm_val_vec_t args = WASM_ARRAY_VEC(arg_vals);
+        wasm_val_vec_t results = WASM_ARRAY_VEC(result_vals);
+        double call_start = now();
+        trap = wasm_func_call(func, &args, &results);
+        double latency = now() - call_start;
+        if (trap) {
+            print_trap(function, trap);
+            traps++;
+            if (print_results) {
+                printf("trap\n");
+            }
+            continue;
+        }
+        if (print_results) {
+            printf("%d ", result_vals[0].of.i32);
+            for (size_t i = 0; i < h.result_len; i++) {
+                printf("%02x", h.result[i]);
+            }
+            printf("\n");
+        }
+        if (calls == capacity) {
+            capacity *= 2;
+            latencies = realloc(latencies, sizeof(double) * capacity);
+        }
+        latencies[calls++] = latency;
+        errors += result_vals[0].of.i32 != 0;
+        growths += wasm_memory_data_size(h.memory) > memory_before;
+        input_bytes += len;
+        output_bytes += h.result_len;
+    }
+    free(line);
+
+    // cold start: the first call also pays for lazy compilation and the
+    // first growth of the heap
+    double first_call = calls ? latencies[0] : 0;
+    double total = 0;
+    for (size_t i = 0; i < calls; i++) {
+        total += latencies[i];
+    }
+    qsort(latencies, calls, sizeof(double), compare_doubles);
+#define PERCENTILE(p) (calls ? latencies[(size_t)((calls - 1) * (p))] * 1e6 : 0)
+    if (!print_results) {
+        printf("{\"module\": \"%s\", \"module_bytes\": %zu, \"function\": \"%s\", "
+               "\"compile_ms\": %.3f, \"instantiate_ms\": %.3f, \"first_call_us\": %.2f, "
+               "\"calls\": %zu, \"errors\": %zu, \"traps\": %zu, \"out_of_bounds\": %s, "
+               "\"seconds\": %.3f, \"calls_per_s\": %.0f, \"mb_per_s\": %.2f, "
+               "\"output_bytes_per_call\": %.0f, \"latency_us\": {\"mean\": %.2f, \"p50\": %.2f, "
+               "\"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}, \"memory_initial_pages\": %zu, "
+               "\"memory_final_pages\": %zu, \"memory_growths\": %zu}\n",
+               path, module_bytes, function, (compiled - start) * 1e3,
+               (instantiated - compiled) * 1e3, first_call * 1e6, calls, errors, traps,
+               h.out_of_bounds ? "true" : "false", total, calls / (total ? total : 1),
+               input_bytes / (total ? total : 1) / 1e6, calls ? (double)output_bytes / calls : 0,
+               calls ? total / calls * 1e6 : 0, PERCENTILE(0.5), PERCENTILE(0.9), PERCENTILE(0.99),
+               PERCENTILE(1.0), initial_memory / WASM_PAGE_SIZE,
+               wasm_memory_data_size(h.memory) / WASM_PAGE_SIZE, growths);
+    }
+#undef PERCENTILE
+    free(latencies);
+    free(h.result);
+
+    wasm_extern_vec_delete(&exports);
+    wasm_instance_delete(instance);
+    for (size_t i = 0; i < import_vec.size; i++) {
+        wasm_func_delete(funcs[i]);
+    }
+    wasm_module_delete(module);
+    wasm_store_delete(store);
+    wasm_engine_delete(engine);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "parser/arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+static size_t align_size(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static arena_block *new_block(arena *a, size_t size) {
+    size_t block_size = a->head ? a->head->size * 2 : ARENA_MIN_BLOCK_SIZE;
+    while (block_size < size) {
+        block_size *= 2;
+    }
+    arena_block *block = malloc(sizeof(arena_block) + block_size);
+    if (!block) {
+        return NULL;
+    }
+    block->next = a->head;
+    block->size = block_size;
+    block->used = 0;
+    a->head = block;
+    return block;
+}
+
+void *arena_alloc(arena *a, size_t size) {
+    size = align_size(size);
+    arena_block *block = a->head;
+    if (!block || block->size - block->used < size) {
+        block = new_block(a, size);
+        if (!block) {
+            return NULL;
+        }
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    a->allocations++;
+    return ptr;
+}
+
+void *arena_realloc(arena *a, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) {
+        return arena_alloc(a, new_size);
+    }
+    old_size = align_size(old_size);
+    new_size = align_size(new_size);
+    arena_block *block = a->head;
+    // the last allocation of the current block can grow in place
+    if ((unsigned char *)ptr + old_size == block->data + block->used &&
+        block->used - old_size + new_size <= block->size) {
+        block->used = block->used - old_size + new_size;
+        return ptr;
+    }
+    if (new_size <= old_size) {
+        return ptr;
+    }
+    void *new_ptr = arena_alloc(a, new_size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, old_size);
+    }
+    return new_ptr;
+}
+
+// Makes room for one more element at the end of an array of len elements,
+// doubling its capacity when it is full.
+void *arena_grow(arena *a, void *array, size_t len, size_t *capacity, size_t size) {
+    if (len < *capacity) {
+        return array;
+    }
+    size_t new_capacity = *capacity == 0 ? 16 : *capacity * 2;
+    array = arena_realloc(a, array, size * *capacity, size * new_capacity);
+    *capacity = new_capacity;
+    return array;
+}
+
+char *arena_strndup(arena *a, const char *str, size_t len) {
+    char *dst = arena_alloc(a, len + 1);
+    if (!dst) {
+        return NULL;
+    }
+    memcpy(dst, str, len);
+    dst[len] = '\0';
+    return dst;
+}
+
+void arena_free(arena *a) {
+    arena_block *block = a->head;
+    while (block) {
+        arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    a->head = NULL;
+    a->allocations = 0;
+}
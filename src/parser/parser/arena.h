@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_MIN_BLOCK_SIZE 4096
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    _Alignas(max_align_t) unsigned char data[];
+} arena_block;
+
+// Bump allocator owning every node, children array and value of a parse.
+// Nothing allocated from it is freed individually, the whole arena is
+// released at once with arena_free.
+typedef struct arena {
+    arena_block *head;
+    size_t allocations;
+} arena;
+
+void *arena_alloc(arena *a, size_t size);
+void *arena_realloc(arena *a, void *ptr, size_t old_size, size_t new_size);
+void *arena_grow(arena *a, void *array, size_t len, size_t *capacity, size_t size);
+char *arena_strndup(arena *a, const char *str, size_t len);
+void arena_free(arena *a);
+
+#endif // ARENA_H
@@ -0,0 +1,183 @@
+#include "parser/aromatic.h"
+#include "parser/elements.h"
+#include "parser/kekule.h"
+#include "parser/rings.h"
+
+// Pi electrons an atom of the kekulized graph gives to the rings it lies
+// in, -1 when it keeps them from being aromatic. Charges shift the group as
+// for default_valence(), C- having the lone pair of N and C+ the empty
+// orbital of B.
+int pi_electrons(const graph *g, const bool *ring_bonds, int atom) {
+    const Atom *a = &g->atoms[atom];
+    if (!(element_table[(int)a->element].flags & ELEMENT_AROMATIC)) {
+        return -1;
+    }
+    int ring_doubles = 0, exocyclic = -1;
+    int connections = a->hydrogens >= 0 ? a->hydrogens : a->implicit_hydrogens;
+    for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+        const Bond *bond = &g->bonds[g->adjacency_bonds[k]];
+        connections++;
+        if (bond->order > 2) {
+            return -1;
+        } else if (bond->order == 2 && ring_bonds[g->adjacency_bonds[k]]) {
+            ring_doubles++;
+        } else if (bond->order == 2) {
+            exocyclic = g->atoms[g->adjacency[k]].element;
+        }
+    }
+    if (ring_doubles + (exocyclic >= 0) > 1) {
+        return -1;
+    } else if (ring_doubles == 1) {
+        return 1;
+    } else if (exocyclic >= 0) {
+        return exocyclic == 7 || exocyclic == 8 || exocyclic == 16 ? 0 : -1;
+    }
+    int group = element_table[(int)a->element].group - a->charge;
+    if (group == 13 && connections == 3) {
+        return 0;
+    } else if ((group == 15 && connections == 3) || (group == 16 && connections == 2)) {
+        return 2;
+    }
+    return -1;
+}
+
+int find_bond(const graph *g, int begin, int end) {
+    for (int k = g->adjacency_offsets[begin]; k < g->adjacency_offsets[begin + 1]; k++) {
+        if (g->adjacency[k] == end) {
+            return g->adjacency_bonds[k];
+        }
+    }
+    return -1;
+}
+
+void set_ring_aromatic(graph *g, const ring_set *rings, int ring) {
+    int first = rings->offsets[ring], last = rings->offsets[ring + 1] - 1;
+    for (int i = first; i <= last; i++) {
+        int next = i < last ? rings->atoms[i + 1] : rings->atoms[first];
+        g->atoms[rings->atoms[i]].aromatic = 1;
+        g->bonds[find_bond(g, rings->atoms[i], next)].aromatic = 1;
+    }
+}
+
+// Pi electrons of the atoms of ring not yet marked with stamp, marking them,
+// or -1.
+int ring_electrons(const ring_set *rings, int ring, const int *electrons, int *marks, int stamp) {
+    int sum = 0;
+    for (int i = rings->offsets[ring]; i < rings->offsets[ring + 1]; i++) {
+        int atom = rings->atoms[i];
+        if (marks[atom] == stamp) {
+            continue;
+        }
+        marks[atom] = stamp;
+        if (electrons[atom] < 0 || sum < 0) {
+            sum = -1;
+        } else {
+            sum += electrons[atom];
+        }
+    }
+    return sum;
+}
+
+// Puts back the bond orders saved by perceive_aromaticity() and frees them.
+void restore_orders(graph *g, char *orders) {
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        g->bonds[i].order = orders[i];
+    }
+    free(orders);
+}
+
+void perceive_aromaticity(parser_ctx *ctx, graph *g) {
+    char *orders = malloc(g->bonds_len + 1);
+    if (!orders) {
+        error(ctx, "Out of memory");
+        return;
+    }
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        orders[i] = g->bonds[i].order;
+    }
+    // out of memory ctx stays errored, unlike a graph that cannot be kekulized
+    if (kekulize_bonds(ctx, g) >= 0 || ctx->errored) {
+        restore_orders(g, orders);
+        return;
+    }
+
+    bool *ring_bonds = find_ring_bonds(ctx, g);
+    ring_set rings = find_rings(ctx, g, ring_bonds);
+    atom_rings index = index_atom_rings(ctx, g->atoms_len, &rings);
+    int *electrons = malloc(sizeof(int) * (g->atoms_len + 1));
+    int *marks = calloc(g->atoms_len + 1, sizeof(int));
+    int *shared = calloc(rings.len + 1, sizeof(int));
+    int *neighbours = malloc(sizeof(int) * (rings.len + 1));
+    if (ctx->errored || !electrons || !marks || !shared || !neighbours) {
+        if (!ctx->errored) {
+            error(ctx, "Out of memory");
+        }
+        restore_orders(g, orders);
+        free(electrons);
+        free(marks);
+        free(shared);
+        free(neighbours);
+        return;
+    }
+    for (size_t i = 0; i < g->atoms_len; i++) {
+        electrons[i] = pi_electrons(g, ring_bonds, i);
+        g->atoms[i].aromatic = 0;
+    }
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        g->bonds[i].aromatic = 0;
+    }
+
+    int stamp = 0;
+    for (size_t r = 0; r < rings.len; r++) {
+        int sum = ring_electrons(&rings, r, electrons, marks, ++stamp);
+        if (sum % 4 == 2) {
+            set_ring_aromatic(g, &rings, r);
+        }
+    }
+    // fused rings aromatic together only, as in azulene, share a bond and so
+    // at least two atoms
+    for (size_t r = 0; r < rings.len; r++) {
+        size_t neighbours_len = 0;
+        for (int i = rings.offsets[r]; i < rings.offsets[r + 1]; i++) {
+            int atom = rings.atoms[i];
+            for (int k = index.offsets[atom]; k < index.offsets[atom + 1]; k++) {
+                int other = index.rings[k];
+                if (other > (int)r && shared[other]++ == 0) {
+                    neighbours[neighbours_len++] = other;
+                }
+            }
+        }
+        for (size_t n = 0; n < neighbours_len; n++) {
+            int other = neighbours[n];
+            if (shared[other] < 2) {
+                shared[other] = 0;
+                continue;
+            }
+            shared[other] = 0;
+            stamp++;
+            int sum = ring_electrons(&rings, r, electrons, marks, stamp);
+            int more = ring_electrons(&rings, other, electrons, marks, stamp);
+            if (sum >= 0 && more >= 0 && (sum + more) % 4 == 2) {
+                set_ring_aromatic(g, &rings, r);
+                set_ring_aromatic(g, &rings, other);
+            }
+        }
+    }
+    // a ring of aromatic atoms, such as the pentagons of C60, would
+    // otherwise keep bonds of the orders kekulize_graph() happened to pick
+    for (size_t r = 0; r < rings.len; r++) {
+        int i = rings.offsets[r];
+        while (i < rings.offsets[r + 1] && g->atoms[rings.atoms[i]].aromatic) {
+            i++;
+        }
+        if (i == rings.offsets[r + 1]) {
+            set_ring_aromatic(g, &rings, r);
+        }
+    }
+
+    free(orders);
+    free(electrons);
+    free(marks);
+    free(shared);
+    free(neighbours);
+}
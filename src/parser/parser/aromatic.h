@@ -0,0 +1,22 @@
+#ifndef AROMATIC_H
+#define AROMATIC_H
+
+#include "parser/graph.h"
+
+// Sets the aromatic flags of the graph from its structure rather than from
+// its spelling, so that Kekulé and aromatic SMILES of a molecule give the
+// same graph. Aromatic bonds are first given orders by kekulize_graph(),
+// then every flag is cleared and set again on the atoms and bonds of each
+// ring, and of each pair of fused rings, whose pi electrons number 4n + 2.
+// An atom gives one electron for a double bond in the ring, none for a
+// double bond out of it to N, O or S or for an empty orbital (B, C+) and
+// two for a lone pair (pyrrole N, furan O, C-). Rings whose atoms all turn
+// out aromatic get aromatic bonds too. Aromatic bonds keep the order
+// kekulize_graph() gave them.
+//
+// A graph that cannot be kekulized keeps its aromaticity as written and
+// ctx is left without error. Out of memory, the graph is left as it was and
+// ctx is errored.
+void perceive_aromaticity(parser_ctx *ctx, graph *g);
+
+#endif // AROMATIC_H
@@ -0,0 +1,1046 @@
+#include "parser/canon.h"
+#include "parser/elements.h"
+#include "parser/graph.h"
+#include "parser/text.h"
+#include "parser/valence.h"
+#include <string.h>
+
+int total_hydrogens(const Atom *atom) {
+    return atom->hydrogens >= 0 ? atom->hydrogens : atom->implicit_hydrogens;
+}
+
+char flip_direction(char direction) {
+    return direction == '/' ? '\\' : '/';
+}
+
+// Neighbour of a double bond atom across a '/' or '\' bond, -1 if none. The
+// symbol reads from the begin atom of the bond, direction is set as read
+// from atom.
+int directional_neighbour(const graph *g, int atom, int double_bond, char *direction) {
+    int degree = g->adjacency_offsets[atom + 1] - g->adjacency_offsets[atom];
+    if (degree < 2 || degree > 3) {
+        return -1;
+    }
+    for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+        const Bond *bond = &g->bonds[g->adjacency_bonds[k]];
+        if (g->adjacency_bonds[k] != double_bond && (bond->symbol == '/' || bond->symbol == '\\')) {
+            *direction = bond->begin == atom ? bond->symbol : flip_direction(bond->symbol);
+            return g->adjacency[k];
+        }
+    }
+    return -1;
+}
+
+// Neighbours of a tetrahedral centre in the order its chirality refers to,
+// -1 standing for an implicit hydrogen or a lone pair right after the
+// previous atom. Returns 1 when they turn anticlockwise ('@'), 2 when they
+// turn clockwise ('@@') and 0 for none or a class that is not carried over.
+int tetrahedral_neighbours(const graph *g, int atom, int neighbours[4]) {
+    const Atom *a = &g->atoms[atom];
+    int chirality;
+    if (a->chirality == CHIRAL_ANTICLOCKWISE || a->chirality == CHIRAL_TH + 1) {
+        chirality = 1;
+    } else if (a->chirality == CHIRAL_CLOCKWISE || a->chirality == CHIRAL_TH + 2) {
+        chirality = 2;
+    } else {
+        return 0;
+    }
+    int first = g->adjacency_offsets[atom];
+    int degree = g->adjacency_offsets[atom + 1] - first;
+    int hydrogens = total_hydrogens(a);
+    bool implicit = degree == 3 && hydrogens <= 1;
+    if (!implicit && (degree != 4 || hydrogens != 0)) {
+        return 0;
+    }
+    size_t len = 0;
+    bool previous = g->bonds[g->adjacency_bonds[first]].end == atom;
+    for (int k = first; k < first + degree; k++) {
+        if (implicit && len == (size_t)previous) {
+            neighbours[len++] = -1;
+        }
+        neighbours[len++] = g->adjacency[k];
+    }
+    return chirality;
+}
+
+// Chirality of a centre once its neighbours are listed in another order.
+int reorder_chirality(int chirality, const int before[4], const int after[4]) {
+    int positions[4];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            if (before[j] == after[i]) {
+                positions[i] = j;
+            }
+        }
+    }
+    int inversions = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int j = i + 1; j < 4; j++) {
+            inversions += positions[i] > positions[j];
+        }
+    }
+    return inversions % 2 ? 3 - chirality : chirality;
+}
+
+#define INVARIANT_COUNT 7
+
+typedef struct atom_invariant {
+    int values[INVARIANT_COUNT];
+    int atom;
+} atom_invariant;
+
+int compare_invariants(const void *a, const void *b) {
+    const atom_invariant *x = a, *y = b;
+    for (int i = 0; i < INVARIANT_COUNT; i++) {
+        if (x->values[i] != y->values[i]) {
+            return x->values[i] < y->values[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Weight of a bond in the keys splitting the cells, a 12 bit field per kind
+// of bond so that the key counts the bonds of each kind.
+uint64_t bond_weight(const Bond *bond) {
+    int kind = bond->aromatic ? 4 : bond->order - 1;
+    return (uint64_t)1 << (12 * kind);
+}
+
+typedef struct split_atom {
+    uint64_t key;
+    int cell;
+    int atom;
+} split_atom;
+
+int compare_split_atoms(const void *a, const void *b) {
+    const split_atom *x = a, *y = b;
+    if (x->cell != y->cell) {
+        return x->cell - y->cell;
+    }
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return 0;
+}
+
+// Ordered partition of the atoms. Each cell is a range of order known by
+// the position it starts at, which it keeps when it splits.
+typedef struct partition {
+    const graph *g;
+    size_t len;
+    int *order;
+    int *position; // of each atom in order
+    int *cell;     // start of the cell of each atom
+    int *cell_len; // by start
+    bool *queued;  // by start
+    int *queue;
+    size_t queue_head;
+    size_t queue_len;
+
+    uint64_t *keys;
+    int *stamps;
+    int stamp;
+    split_atom *touched;
+    size_t touched_len;
+} partition;
+
+void enqueue_cell(partition *p, int start) {
+    p->queued[start] = true;
+    p->queue[(p->queue_head + p->queue_len++) % p->len] = start;
+}
+
+// Splits the cell at start by the keys of the given atoms, sorted by key,
+// which end up after the other atoms of the cell. A cell that was already
+// used to split the others only needs all but one of its pieces to be used
+// in turn, the largest one is left out.
+void split_cell(partition *p, int start, const split_atom *atoms, size_t count) {
+    int len = p->cell_len[start];
+    int untouched = len - count;
+    if (untouched == 0 && atoms[0].key == atoms[count - 1].key) {
+        return;
+    }
+    int end = start + len;
+    for (size_t i = 0; i < count; i++) {
+        int atom = atoms[i].atom, from = p->position[atom], other = p->order[--end];
+        p->order[from] = other;
+        p->position[other] = from;
+    }
+    for (size_t i = 0; i < count; i++) {
+        p->order[end + i] = atoms[i].atom;
+        p->position[atoms[i].atom] = end + i;
+    }
+
+    bool queued = p->queued[start];
+    int largest = start, largest_len = untouched;
+    if (untouched > 0) {
+        p->cell_len[start] = untouched;
+    }
+    for (size_t i = 0, j; i < count; i = j) {
+        for (j = i; j < count && atoms[j].key == atoms[i].key; j++) {
+            p->cell[atoms[j].atom] = end + i;
+        }
+        p->cell_len[end + i] = j - i;
+        if ((int)(j - i) > largest_len) {
+            largest = end + i;
+            largest_len = j - i;
+        }
+    }
+    for (int piece = start; piece < start + len; piece += p->cell_len[piece]) {
+        if (!p->queued[piece] && (queued || piece != largest)) {
+            enqueue_cell(p, piece);
+        }
+    }
+}
+
+// Splits the cells until the number of bonds of each kind from an atom to
+// any cell only depends on the cell of the atom.
+void refine(partition *p) {
+    const graph *g = p->g;
+    while (p->queue_len > 0) {
+        int start = p->queue[p->queue_head];
+        p->queue_head = (p->queue_head + 1) % p->len;
+        p->queue_len--;
+        p->queued[start] = false;
+
+        p->stamp++;
+        p->touched_len = 0;
+        for (int i = start; i < start + p->cell_len[start]; i++) {
+            int atom = p->order[i];
+            for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+                int other = g->adjacency[k];
+                if (p->stamps[other] != p->stamp) {
+                    p->stamps[other] = p->stamp;
+                    p->keys[other] = 0;
+                    p->touched[p->touched_len++].atom = other;
+                }
+                p->keys[other] += bond_weight(&g->bonds[g->adjacency_bonds[k]]);
+            }
+        }
+        for (size_t i = 0; i < p->touched_len; i++) {
+            p->touched[i].key = p->keys[p->touched[i].atom];
+            p->touched[i].cell = p->cell[p->touched[i].atom];
+        }
+        qsort(p->touched, p->touched_len, sizeof(split_atom), compare_split_atoms);
+        for (size_t i = 0, j; i < p->touched_len; i = j) {
+            int cell = p->touched[i].cell;
+            for (j = i; j < p->touched_len && p->touched[j].cell == cell; j++) {
+            }
+            if (p->cell_len[cell] > 1) {
+                split_cell(p, cell, &p->touched[i], j - i);
+            }
+        }
+    }
+}
+
+// Atoms copied or compared while searching the tied cells, past which the
+// best ranking found so far is kept.
+#define SEARCH_BUDGET (1 << 22)
+
+// Tied cell of the search tree whose atoms are set apart in turn.
+typedef struct search_node {
+    int cell;
+    int len;
+    int choice;
+    // order, cell and cell_len before the first choice, NULL when it is the
+    // only one tried
+    int *saved;
+} search_node;
+
+// Search of the tied cells keeping the ranking with the smallest
+// certificate. Two leaves with equal certificates differ by an automorphism
+// that maps the choices where their paths part, so the choice reached
+// second is skipped.
+typedef struct search {
+    const graph *g;
+    partition *p;
+    search_node *nodes;
+    size_t depth;
+    size_t saved;
+    size_t work;
+    bool found;
+    int *ranks;
+    int *best_path;
+    int *first;
+    int *best;
+    int *certificate;
+    size_t certificate_len;
+
+    int *fill;
+    int *neighbours;
+    int *neighbour_bonds;
+} search;
+
+// First cell of more than one atom from start on, -1 if none.
+int first_tied_cell(const partition *p, int start) {
+    for (int cell = start; cell < (int)p->len; cell += p->cell_len[cell]) {
+        if (p->cell_len[cell] > 1) {
+            return cell;
+        }
+    }
+    return -1;
+}
+
+// Sets an atom of a tied cell apart at the end of the cell and refines.
+void individualize(partition *p, int atom) {
+    int cell = p->cell[atom];
+    int last = cell + --p->cell_len[cell];
+    int other = p->order[last], from = p->position[atom];
+    p->order[from] = other;
+    p->position[other] = from;
+    p->order[last] = atom;
+    p->position[atom] = last;
+    p->cell[atom] = last;
+    p->cell_len[last] = 1;
+    enqueue_cell(p, last);
+    refine(p);
+}
+
+// Configuration of a double bond for its neighbours of lowest rank, 1 for
+// cis and 2 for trans, 0 without a configuration.
+int double_bond_stereo(const graph *g, int bond, const int *ranks) {
+    const Bond *b = &g->bonds[bond];
+    if (b->order != 2 || b->aromatic) {
+        return 0;
+    }
+    int atoms[2] = {b->begin, b->end}, references[2];
+    char directions[2];
+    bool cis = true;
+    for (int i = 0; i < 2; i++) {
+        references[i] = directional_neighbour(g, atoms[i], bond, &directions[i]);
+        if (references[i] < 0) {
+            return 0;
+        }
+        int lowest = -1;
+        for (int k = g->adjacency_offsets[atoms[i]]; k < g->adjacency_offsets[atoms[i] + 1]; k++) {
+            int other = g->adjacency[k];
+            if (g->adjacency_bonds[k] != bond && (lowest < 0 || ranks[other] < ranks[lowest])) {
+                lowest = other;
+            }
+        }
+        // the other neighbour lies across from the reference
+        cis ^= lowest != references[i];
+    }
+    cis ^= directions[0] != directions[1];
+    return cis ? 1 : 2;
+}
+
+// Describes the graph numbered by the ranks, per atom in rank order its
+// chirality for its neighbours in rank order and its degree, then each
+// neighbour with the kind of its bond and the configuration of a double
+// bond. The atom invariants are left out as they follow from the ranks.
+void write_certificate(search *s) {
+    const graph *g = s->g;
+    const int *order = s->p->order, *ranks = s->p->position;
+    size_t n = g->atoms_len;
+    for (size_t i = 0; i < n; i++) {
+        s->fill[i] = g->adjacency_offsets[i];
+    }
+    for (size_t r = 0; r < n; r++) {
+        int atom = order[r];
+        for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+            int other = g->adjacency[k];
+            s->neighbours[s->fill[other]] = atom;
+            s->neighbour_bonds[s->fill[other]++] = g->adjacency_bonds[k];
+        }
+    }
+    int *out = s->certificate;
+    for (size_t r = 0; r < n; r++) {
+        int atom = order[r];
+        int first = g->adjacency_offsets[atom], degree = g->adjacency_offsets[atom + 1] - first;
+        int before[4], after[4];
+        int chirality = tetrahedral_neighbours(g, atom, before);
+        if (chirality) {
+            size_t len = 0;
+            if (degree == 3) {
+                after[len++] = -1;
+            }
+            for (int k = first; k < first + degree; k++) {
+                after[len++] = s->neighbours[k];
+            }
+            chirality = reorder_chirality(chirality, before, after);
+        }
+        *out++ = chirality;
+        *out++ = degree;
+        for (int k = first; k < first + degree; k++) {
+            const Bond *bond = &g->bonds[s->neighbour_bonds[k]];
+            int kind = bond->aromatic ? 4 : bond->order - 1;
+            *out++ = ranks[s->neighbours[k]];
+            *out++ = 3 * kind + double_bond_stereo(g, s->neighbour_bonds[k], ranks);
+        }
+    }
+    s->work += s->certificate_len;
+}
+
+int compare_certificates(const int *a, const int *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Keeps the ranking of a leaf if it is the best so far. Returns the depth
+// to go back to when the leaf repeats one already seen, -1 otherwise.
+int visit_leaf(search *s) {
+    size_t n = s->g->atoms_len;
+    if (!s->found && s->saved == 0) {
+        // no other leaf will be visited
+        s->found = true;
+        memcpy(s->ranks, s->p->position, sizeof(int) * n);
+        return -1;
+    }
+    write_certificate(s);
+    if (!s->found) {
+        s->found = true;
+        memcpy(s->first, s->certificate, sizeof(int) * s->certificate_len);
+        memcpy(s->best, s->certificate, sizeof(int) * s->certificate_len);
+        memcpy(s->ranks, s->p->position, sizeof(int) * n);
+        for (size_t d = 0; d < s->depth; d++) {
+            s->best_path[d] = 0;
+        }
+        return -1;
+    }
+    // the first leaf took the first choice everywhere
+    if (compare_certificates(s->certificate, s->first, s->certificate_len) == 0) {
+        size_t d = 0;
+        while (s->nodes[d].choice == 0) {
+            d++;
+        }
+        return d;
+    }
+    int order = compare_certificates(s->certificate, s->best, s->certificate_len);
+    if (order == 0) {
+        size_t d = 0;
+        while (s->nodes[d].choice == s->best_path[d]) {
+            d++;
+        }
+        return d;
+    }
+    if (order < 0) {
+        memcpy(s->best, s->certificate, sizeof(int) * s->certificate_len);
+        memcpy(s->ranks, s->p->position, sizeof(int) * n);
+        for (size_t d = 0; d < s->depth; d++) {
+            s->best_path[d] = s->nodes[d].choice;
+        }
+    }
+    return -1;
+}
+
+// Goes back up the search tree to the next choice left, the one after the
+// node at depth back first if it is not -1. Returns false when none is left.
+bool next_choice(search *s, int back) {
+    partition *p = s->p;
+    size_t n = s->g->atoms_len;
+    while (s->depth > 0) {
+        search_node *node = &s->nodes[s->depth - 1];
+        bool skip = back >= 0 && (int)s->depth - 1 > back;
+        if (!skip && node->saved && node->choice + 1 < node->len && s->work < SEARCH_BUDGET) {
+            node->choice++;
+            memcpy(p->order, node->saved, sizeof(int) * n);
+            memcpy(p->cell, node->saved + n, sizeof(int) * n);
+            memcpy(p->cell_len, node->saved + 2 * n, sizeof(int) * n);
+            for (size_t i = 0; i < n; i++) {
+                p->position[p->order[i]] = i;
+            }
+            s->work += 3 * n;
+            individualize(p, p->order[node->cell + node->len - 1 - node->choice]);
+            return true;
+        }
+        if (node->saved) {
+            free(node->saved);
+            s->saved--;
+        }
+        s->depth--;
+    }
+    return false;
+}
+
+void free_partition(partition *p) {
+    free(p->order);
+    free(p->position);
+    free(p->cell);
+    free(p->cell_len);
+    free(p->queued);
+    free(p->queue);
+    free(p->keys);
+    free(p->stamps);
+    free(p->touched);
+}
+
+// Frees the search with the partitions its nodes still hold.
+void free_search(search *s) {
+    for (size_t d = 0; d < s->depth; d++) {
+        free(s->nodes[d].saved);
+    }
+    free(s->nodes);
+    free(s->best_path);
+    free(s->first);
+    free(s->best);
+    free(s->certificate);
+    free(s->fill);
+    free(s->neighbours);
+    free(s->neighbour_bonds);
+}
+
+int *rank_atoms(parser_ctx *ctx, const graph *g) {
+    size_t n = g->atoms_len;
+    int *ranks = arena_alloc(&ctx->arena, sizeof(int) * (n + 1));
+    if (!ranks) {
+        error(ctx, "Out of memory");
+        return NULL;
+    }
+    if (n == 0) {
+        return ranks;
+    }
+    atom_invariant *invariants = malloc(sizeof(atom_invariant) * n);
+    partition p = {.g = g, .len = n};
+    p.order = malloc(sizeof(int) * n);
+    p.position = malloc(sizeof(int) * n);
+    p.cell = malloc(sizeof(int) * n);
+    p.cell_len = calloc(n, sizeof(int));
+    p.queued = calloc(n, sizeof(bool));
+    p.queue = malloc(sizeof(int) * n);
+    p.keys = malloc(sizeof(uint64_t) * n);
+    p.stamps = calloc(n, sizeof(int));
+    p.touched = malloc(sizeof(split_atom) * n);
+    search s = {.g = g, .p = &p, .ranks = ranks};
+    s.nodes = malloc(sizeof(search_node) * n);
+    s.best_path = malloc(sizeof(int) * n);
+    s.certificate_len = 2 * n + 4 * g->bonds_len;
+    s.first = malloc(sizeof(int) * s.certificate_len);
+    s.best = malloc(sizeof(int) * s.certificate_len);
+    s.certificate = malloc(sizeof(int) * s.certificate_len);
+    s.fill = malloc(sizeof(int) * n);
+    s.neighbours = malloc(sizeof(int) * (2 * g->bonds_len + 1));
+    s.neighbour_bonds = malloc(sizeof(int) * (2 * g->bonds_len + 1));
+    if (!invariants || !p.order || !p.position || !p.cell || !p.cell_len || !p.queued ||
+        !p.queue || !p.keys || !p.stamps || !p.touched || !s.nodes || !s.best_path || !s.first ||
+        !s.best || !s.certificate || !s.fill || !s.neighbours || !s.neighbour_bonds) {
+        error(ctx, "Out of memory");
+        free(invariants);
+        free_partition(&p);
+        free_search(&s);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const Atom *atom = &g->atoms[i];
+        invariants[i] = (atom_invariant){
+            .values = {g->adjacency_offsets[i + 1] - g->adjacency_offsets[i], atom->element,
+                       atom->isotope, atom->charge, total_hydrogens(atom), atom->aromatic,
+                       atom->atom_class},
+            .atom = i,
+        };
+    }
+    qsort(invariants, n, sizeof(atom_invariant), compare_invariants);
+
+    int start = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && compare_invariants(&invariants[i - 1], &invariants[i]) != 0) {
+            enqueue_cell(&p, start);
+            start = i;
+        }
+        p.order[i] = invariants[i].atom;
+        p.position[invariants[i].atom] = i;
+        p.cell[invariants[i].atom] = start;
+        p.cell_len[start]++;
+    }
+    enqueue_cell(&p, start);
+    refine(&p);
+
+    int cell = 0;
+    bool ok = true;
+    for (;;) {
+        cell = first_tied_cell(&p, cell);
+        if (cell >= 0) {
+            search_node node = {cell, p.cell_len[cell], 0, NULL};
+            // room to save the partition and compare two leaves
+            if (s.work + 3 * n + 2 * s.certificate_len <= SEARCH_BUDGET) {
+                node.saved = malloc(sizeof(int) * 3 * n);
+                if (!node.saved) {
+                    ok = false;
+                    break;
+                }
+                memcpy(node.saved, p.order, sizeof(int) * n);
+                memcpy(node.saved + n, p.cell, sizeof(int) * n);
+                memcpy(node.saved + 2 * n, p.cell_len, sizeof(int) * n);
+                s.saved++;
+                s.work += 3 * n;
+            }
+            s.nodes[s.depth++] = node;
+            individualize(&p, p.order[cell + node.len - 1]);
+            continue;
+        }
+        if (!next_choice(&s, visit_leaf(&s))) {
+            break;
+        }
+        cell = s.nodes[s.depth - 1].cell;
+    }
+
+    free(invariants);
+    free_partition(&p);
+    free_search(&s);
+    if (!ok) {
+        error(ctx, "Out of memory");
+        return NULL;
+    }
+    return ranks;
+}
+
+// Depth first spanning forest of the graph in rank order, with the ring
+// bonds closing it.
+typedef struct canonical_writer {
+    const graph *g;
+    int *neighbours; // adjacency of each atom sorted by rank
+    int *neighbour_bonds;
+    int *preorder; // atoms in writing order
+    int *index;    // of each atom in preorder
+    int *parent_bond;
+    int *child_offsets;
+    int *children;
+    bool *ring;        // by bond
+    int *ring_offsets; // ring bonds of each atom, by index of the other atom
+    int *ring_bonds;
+    char *marks; // direction of each bond as written, 0 for none
+    int *labels; // of each ring bond
+    bool used_labels[RING_BOND_COUNT];
+    char *out;
+} canonical_writer;
+
+int other_atom(const Bond *bond, int atom) {
+    return bond->begin == atom ? bond->end : bond->begin;
+}
+
+// Returns false when out of memory.
+bool build_forest(canonical_writer *w, const int *ranks) {
+    const graph *g = w->g;
+    size_t n = g->atoms_len;
+    int *by_rank = malloc(sizeof(int) * (n + 1));
+    int *next = malloc(sizeof(int) * (n + 1));
+    int *stack = malloc(sizeof(int) * (n + 1));
+    if (!by_rank || !next || !stack) {
+        free(by_rank);
+        free(next);
+        free(stack);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        by_rank[ranks[i]] = i;
+        next[i] = g->adjacency_offsets[i];
+        w->index[i] = -1;
+    }
+    // walking the atoms in rank order lists the neighbours in rank order
+    for (size_t r = 0; r < n; r++) {
+        int atom = by_rank[r];
+        for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+            int other = g->adjacency[k];
+            w->neighbours[next[other]] = atom;
+            w->neighbour_bonds[next[other]++] = g->adjacency_bonds[k];
+        }
+    }
+
+    size_t len = 0;
+    for (size_t r = 0; r < n; r++) {
+        int root = by_rank[r];
+        if (w->index[root] >= 0) {
+            continue;
+        }
+        size_t stack_len = 0;
+        w->index[root] = len;
+        w->preorder[len++] = root;
+        w->parent_bond[root] = -1;
+        stack[stack_len++] = root;
+        next[root] = g->adjacency_offsets[root];
+        while (stack_len > 0) {
+            int atom = stack[stack_len - 1];
+            if (next[atom] == g->adjacency_offsets[atom + 1]) {
+                stack_len--;
+                continue;
+            }
+            int other = w->neighbours[next[atom]];
+            int bond = w->neighbour_bonds[next[atom]++];
+            if (bond == w->parent_bond[atom] || w->ring[bond]) {
+                continue;
+            }
+            if (w->index[other] >= 0) {
+                w->ring[bond] = true;
+                continue;
+            }
+            w->index[other] = len;
+            w->preorder[len++] = other;
+            w->parent_bond[other] = bond;
+            next[other] = g->adjacency_offsets[other];
+            stack[stack_len++] = other;
+        }
+    }
+
+    // children and ring bonds of each atom, in the order of the other atom
+    for (size_t i = 0; i < n; i++) {
+        int atom = w->preorder[i];
+        if (w->parent_bond[atom] >= 0) {
+            w->child_offsets[other_atom(&g->bonds[w->parent_bond[atom]], atom) + 1]++;
+        }
+        for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+            w->ring_offsets[atom + 1] += w->ring[g->adjacency_bonds[k]];
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        w->child_offsets[i + 1] += w->child_offsets[i];
+        w->ring_offsets[i + 1] += w->ring_offsets[i];
+        next[i] = 0;
+    }
+    int *ring_next = stack;
+    memcpy(ring_next, w->ring_offsets, sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) {
+        int atom = w->preorder[i];
+        if (w->parent_bond[atom] >= 0) {
+            int parent = other_atom(&g->bonds[w->parent_bond[atom]], atom);
+            w->children[w->child_offsets[parent] + next[parent]++] = atom;
+        }
+        for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+            int bond = g->adjacency_bonds[k];
+            if (w->ring[bond]) {
+                w->ring_bonds[ring_next[g->adjacency[k]]++] = bond;
+            }
+        }
+    }
+    free(by_rank);
+    free(next);
+    free(stack);
+    return true;
+}
+
+// Double bond with directional bonds on both sides, as the input gives it.
+typedef struct stereo_bond {
+    int first; // index of the first atom written, to mark the bonds in order
+    int bond;
+    int atoms[2];      // in the order they are written
+    int references[2]; // neighbours of both atoms
+    bool cis;
+} stereo_bond;
+
+int compare_stereo_bonds(const void *a, const void *b) {
+    return ((const stereo_bond *)a)->first - ((const stereo_bond *)b)->first;
+}
+
+// Neighbour of a double bond atom to write its direction on: the first in
+// rank order across a single bond already marked, else across any single
+// bond. Returns its index in neighbours, -1 if none.
+int direction_carrier(const canonical_writer *w, int atom, int double_bond) {
+    const graph *g = w->g;
+    int fallback = -1;
+    for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+        const Bond *bond = &g->bonds[w->neighbour_bonds[k]];
+        if (w->neighbour_bonds[k] == double_bond || bond->order != 1 || bond->aromatic) {
+            continue;
+        }
+        if (w->marks[w->neighbour_bonds[k]]) {
+            return k;
+        }
+        if (fallback < 0) {
+            fallback = k;
+        }
+    }
+    return fallback;
+}
+
+// Marks a bond with the given direction from atom unless it already has a
+// mark, which reads from the first atom written. Returns the direction of
+// the bond from atom.
+char mark_bond(canonical_writer *w, int bond, int atom, char direction) {
+    const Bond *b = &w->g->bonds[bond];
+    bool first = w->index[atom] < w->index[other_atom(b, atom)];
+    if (!w->marks[bond]) {
+        w->marks[bond] = first ? direction : flip_direction(direction);
+    }
+    return first ? w->marks[bond] : flip_direction(w->marks[bond]);
+}
+
+// Writes '/' and '\' marks reproducing the configuration of every double
+// bond the input gives one for. Conjugated double bonds share the marks of
+// the bonds between them, a mark conflicting with an earlier one is left
+// out. Returns false when out of memory.
+bool mark_double_bonds(canonical_writer *w) {
+    const graph *g = w->g;
+    stereo_bond *stereo = malloc(sizeof(stereo_bond) * (g->bonds_len + 1));
+    if (!stereo) {
+        return false;
+    }
+    size_t len = 0;
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        const Bond *bond = &g->bonds[i];
+        if (bond->order != 2 || bond->aromatic) {
+            continue;
+        }
+        stereo_bond s = {.bond = i, .atoms = {bond->begin, bond->end}};
+        if (w->index[bond->end] < w->index[bond->begin]) {
+            s.atoms[0] = bond->end;
+            s.atoms[1] = bond->begin;
+        }
+        char directions[2];
+        s.first = w->index[s.atoms[0]];
+        s.references[0] = directional_neighbour(g, s.atoms[0], i, &directions[0]);
+        s.references[1] = directional_neighbour(g, s.atoms[1], i, &directions[1]);
+        s.cis = directions[0] == directions[1];
+        if (s.references[0] >= 0 && s.references[1] >= 0) {
+            stereo[len++] = s;
+        }
+    }
+    qsort(stereo, len, sizeof(stereo_bond), compare_stereo_bonds);
+
+    for (size_t i = 0; i < len; i++) {
+        const stereo_bond *s = &stereo[i];
+        int begin = direction_carrier(w, s->atoms[0], s->bond);
+        int end = direction_carrier(w, s->atoms[1], s->bond);
+        if (begin < 0 || end < 0) {
+            continue;
+        }
+        // the other neighbour of an atom lies across from its reference
+        bool cis = s->cis ^ (w->neighbours[begin] != s->references[0]) ^
+                   (w->neighbours[end] != s->references[1]);
+        // a new mark on the first side is written as '/'
+        bool before = w->index[w->neighbours[begin]] < w->index[s->atoms[0]];
+        char direction = mark_bond(w, w->neighbour_bonds[begin], s->atoms[0], before ? '\\' : '/');
+        char other = cis ? direction : flip_direction(direction);
+        mark_bond(w, w->neighbour_bonds[end], s->atoms[1], other);
+    }
+    free(stereo);
+    return true;
+}
+
+// Chirality of an atom for the order it is written in, 0 for none.
+int written_chirality(const canonical_writer *w, int atom) {
+    const graph *g = w->g;
+    int before[4], after[4];
+    int chirality = tetrahedral_neighbours(g, atom, before);
+    if (!chirality) {
+        return 0;
+    }
+    size_t len = 0;
+    if (w->parent_bond[atom] >= 0) {
+        after[len++] = other_atom(&g->bonds[w->parent_bond[atom]], atom);
+    }
+    if (g->adjacency_offsets[atom + 1] - g->adjacency_offsets[atom] == 3) {
+        after[len++] = -1;
+    }
+    for (int k = w->ring_offsets[atom]; k < w->ring_offsets[atom + 1]; k++) {
+        after[len++] = other_atom(&g->bonds[w->ring_bonds[k]], atom);
+    }
+    for (int k = w->child_offsets[atom]; k < w->child_offsets[atom + 1]; k++) {
+        after[len++] = w->children[k];
+    }
+    return reorder_chirality(chirality, before, after);
+}
+
+bool is_organic(int element, bool aromatic) {
+    switch (element) {
+        case 0:  // *
+        case 5:  // B
+        case 6:  // C
+        case 7:  // N
+        case 8:  // O
+        case 15: // P
+        case 16: // S
+            return true;
+        case 9:  // F
+        case 17: // Cl
+        case 35: // Br
+        case 53: // I
+            return !aromatic;
+        default:
+            return false;
+    }
+}
+
+void write_atom(canonical_writer *w, int atom) {
+    const Atom *a = &w->g->atoms[atom];
+    int chirality = written_chirality(w, atom);
+    int hydrogens = total_hydrogens(a);
+    char symbol[3];
+    strcpy(symbol, atomic_symbols[(int)a->element]);
+    if (a->aromatic) {
+        symbol[0] += 'a' - 'A';
+    }
+    if (is_organic(a->element, a->aromatic) && a->isotope == 0 && a->charge == 0 &&
+        a->atom_class == 0 && chirality == 0 && hydrogens == default_hydrogens(w->g, atom)) {
+        w->out = write_string(w->out, symbol);
+        return;
+    }
+    *w->out++ = '[';
+    if (a->isotope > 0) {
+        w->out = write_long(w->out, a->isotope);
+    }
+    w->out = write_string(w->out, symbol);
+    w->out = write_string(w->out, chirality == 2 ? "@@" : chirality ? "@" : "");
+    if (hydrogens > 0) {
+        *w->out++ = 'H';
+        if (hydrogens > 1) {
+            w->out = write_long(w->out, hydrogens);
+        }
+    }
+    if (a->charge == 1 || a->charge == -1) {
+        *w->out++ = a->charge > 0 ? '+' : '-';
+    } else if (a->charge != 0) {
+        if (a->charge > 0) {
+            *w->out++ = '+';
+        }
+        w->out = write_long(w->out, a->charge);
+    }
+    if (a->atom_class > 0) {
+        *w->out++ = ':';
+        w->out = write_long(w->out, a->atom_class);
+    }
+    *w->out++ = ']';
+}
+
+void write_bond(canonical_writer *w, int bond) {
+    const Bond *b = &w->g->bonds[bond];
+    bool aromatic_atoms = w->g->atoms[b->begin].aromatic && w->g->atoms[b->end].aromatic;
+    if (w->marks[bond]) {
+        *w->out++ = w->marks[bond];
+    } else if (b->aromatic) {
+        if (!aromatic_atoms) {
+            *w->out++ = ':';
+        }
+    } else if (b->order > 1) {
+        *w->out++ = "-=#$"[b->order - 1];
+    } else if (aromatic_atoms) {
+        *w->out++ = '-';
+    }
+}
+
+// Writes the ring bond labels of an atom, closing the bonds to atoms
+// written before it then opening the others on the lowest free labels.
+bool write_ring_bonds(canonical_writer *w, int atom) {
+    const graph *g = w->g;
+    for (int k = w->ring_offsets[atom]; k < w->ring_offsets[atom + 1]; k++) {
+        int bond = w->ring_bonds[k];
+        int other = other_atom(&g->bonds[bond], atom);
+        if (w->index[other] > w->index[atom]) {
+            int label = 1;
+            while (label < RING_BOND_COUNT && w->used_labels[label]) {
+                label++;
+            }
+            if (label == RING_BOND_COUNT) {
+                return false;
+            }
+            w->used_labels[label] = true;
+            w->labels[bond] = label;
+            write_bond(w, bond);
+        }
+        if (w->labels[bond] >= 10) {
+            *w->out++ = '%';
+        }
+        w->out = write_long(w->out, w->labels[bond]);
+    }
+    for (int k = w->ring_offsets[atom]; k < w->ring_offsets[atom + 1]; k++) {
+        int bond = w->ring_bonds[k];
+        if (w->index[other_atom(&g->bonds[bond], atom)] < w->index[atom]) {
+            w->used_labels[w->labels[bond]] = false;
+        }
+    }
+    return true;
+}
+
+typedef struct writer_frame {
+    int atom;
+    int next_child;
+    bool branch; // written between parentheses
+} writer_frame;
+
+void free_writer(canonical_writer *w) {
+    free(w->neighbours);
+    free(w->neighbour_bonds);
+    free(w->preorder);
+    free(w->index);
+    free(w->parent_bond);
+    free(w->child_offsets);
+    free(w->children);
+    free(w->ring);
+    free(w->ring_offsets);
+    free(w->ring_bonds);
+    free(w->marks);
+    free(w->labels);
+}
+
+char *write_canonical(parser_ctx *ctx, const graph *g, const int *ranks) {
+    if (ctx->errored) {
+        return NULL;
+    }
+    size_t n = g->atoms_len, m = g->bonds_len;
+    canonical_writer w = {.g = g};
+    w.neighbours = malloc(sizeof(int) * (2 * m + 1));
+    w.neighbour_bonds = malloc(sizeof(int) * (2 * m + 1));
+    w.preorder = malloc(sizeof(int) * (n + 1));
+    w.index = malloc(sizeof(int) * (n + 1));
+    w.parent_bond = malloc(sizeof(int) * (n + 1));
+    w.child_offsets = calloc(n + 1, sizeof(int));
+    w.children = malloc(sizeof(int) * (n + 1));
+    w.ring = calloc(m + 1, sizeof(bool));
+    w.ring_offsets = calloc(n + 1, sizeof(int));
+    w.ring_bonds = malloc(sizeof(int) * (2 * m + 1));
+    w.marks = calloc(m + 1, sizeof(char));
+    w.labels = malloc(sizeof(int) * (m + 1));
+    // at most 50 characters per bracket atom and its dot, and 7 per bond for
+    // a symbol and parentheses or two ring labels
+    char *smiles = arena_alloc(&ctx->arena, 50 * n + 7 * m + 1);
+    writer_frame *stack = malloc(sizeof(writer_frame) * (n + 1));
+    if (!w.neighbours || !w.neighbour_bonds || !w.preorder || !w.index || !w.parent_bond ||
+        !w.child_offsets || !w.children || !w.ring || !w.ring_offsets || !w.ring_bonds ||
+        !w.marks || !w.labels || !smiles || !stack || !build_forest(&w, ranks) ||
+        !mark_double_bonds(&w)) {
+        error(ctx, "Out of memory");
+        free_writer(&w);
+        free(stack);
+        return NULL;
+    }
+
+    w.out = smiles;
+    bool ok = true;
+    for (size_t i = 0; i < n && ok; i++) {
+        int root = w.preorder[i];
+        if (w.parent_bond[root] >= 0) {
+            continue;
+        }
+        if (i > 0) {
+            *w.out++ = '.';
+        }
+        write_atom(&w, root);
+        ok = write_ring_bonds(&w, root);
+        size_t stack_len = 0;
+        stack[stack_len++] = (writer_frame){.atom = root, .next_child = w.child_offsets[root]};
+        while (stack_len > 0 && ok) {
+            writer_frame *top = &stack[stack_len - 1];
+            if (top->next_child == w.child_offsets[top->atom + 1]) {
+                if (top->branch) {
+                    *w.out++ = ')';
+                }
+                stack_len--;
+                continue;
+            }
+            int child = w.children[top->next_child++];
+            bool branch = top->next_child < w.child_offsets[top->atom + 1];
+            if (branch) {
+                *w.out++ = '(';
+            }
+            write_bond(&w, w.parent_bond[child]);
+            write_atom(&w, child);
+            ok = write_ring_bonds(&w, child);
+            stack[stack_len++] = (writer_frame){child, w.child_offsets[child], branch};
+        }
+    }
+    *w.out = '\0';
+
+    free(stack);
+    free_writer(&w);
+    return ok ? smiles : NULL;
+}
+
+uint64_t hash_string(const char *str) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (; *str; str++) {
+        hash = (hash ^ (uint8_t)*str) * 0x100000001b3;
+    }
+    return hash;
+}
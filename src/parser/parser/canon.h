@@ -0,0 +1,34 @@
+#ifndef CANON_H
+#define CANON_H
+
+#include "ast/protocol.h"
+#include "parser/parser.h"
+#include <stdint.h>
+
+// Canonical rank of every atom, a permutation of 0 to atoms_len - 1 that
+// depends on the molecule and not on how the SMILES spells it. Atoms are
+// first sorted by their invariants (degree, element, isotope, charge,
+// hydrogens, aromaticity and class), then cells of equal atoms are split by
+// the bonds their atoms have to each other cell until nothing splits. Atoms
+// still tied are set apart one at a time, lowest cell first, refining after
+// each. Every atom of a tied cell is tried in turn, skipping those an
+// automorphism already covers, and the ranking under which the numbered
+// graph with its stereo compares lowest is kept. Past a work budget the
+// best ranking found so far is kept, which only large graphs with many
+// symmetries reach. Allocated in the arena of the context, NULL with ctx
+// errored when out of memory.
+int *rank_atoms(parser_ctx *ctx, const graph *g);
+
+// Writes the graph in rank order: each component from its lowest ranked
+// atom, neighbours visited in rank order, ring bonds on the lowest free
+// label and atoms without brackets whenever their hydrogens allow it.
+// Tetrahedral chirality and double bond directions are rewritten for the
+// new neighbour order, other chirality classes are dropped. Returns NULL
+// when more than 99 ring bonds would be open at once, and with ctx errored
+// when out of memory or when ctx had already errored.
+char *write_canonical(parser_ctx *ctx, const graph *g, const int *ranks);
+
+// 64-bit FNV-1a hash of a string.
+uint64_t hash_string(const char *str);
+
+#endif // CANON_H
@@ -0,0 +1,136 @@
+#include "parser/cbor.h"
+#include "parser/tree.h"
+
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+cbor_buffer init_cbor(size_t cap) {
+    cbor_buffer buf = {.data = malloc(cap), .len = 0, .cap = cap, .failed = false};
+    if (!buf.data) {
+        buf.cap = 0;
+        buf.failed = true;
+    }
+    return buf;
+}
+
+void free_cbor(cbor_buffer *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+static bool reserve(cbor_buffer *buf, size_t size) {
+    if (buf->failed) {
+        return false;
+    }
+    if (buf->len + size <= buf->cap) {
+        return true;
+    }
+    size_t cap = buf->cap ? buf->cap : CBOR_MIN_CAPACITY;
+    while (cap < buf->len + size) {
+        cap *= 2;
+    }
+    uint8_t *data = realloc(buf->data, cap);
+    if (!data) {
+        buf->failed = true;
+        return false;
+    }
+    buf->data = data;
+    buf->cap = cap;
+    return true;
+}
+
+static void write_head(cbor_buffer *buf, uint8_t major, uint64_t value) {
+    if (!reserve(buf, 9)) {
+        return;
+    }
+    uint8_t *p = buf->data + buf->len;
+    major <<= 5;
+    if (value < 24) {
+        p[0] = major | value;
+        buf->len += 1;
+    } else if (value <= UINT8_MAX) {
+        p[0] = major | 24;
+        p[1] = value;
+        buf->len += 2;
+    } else if (value <= UINT16_MAX) {
+        p[0] = major | 25;
+        p[1] = value >> 8;
+        p[2] = value;
+        buf->len += 3;
+    } else if (value <= UINT32_MAX) {
+        p[0] = major | 26;
+        for (int i = 0; i < 4; i++) {
+            p[1 + i] = value >> (8 * (3 - i));
+        }
+        buf->len += 5;
+    } else {
+        p[0] = major | 27;
+        for (int i = 0; i < 8; i++) {
+            p[1 + i] = value >> (8 * (7 - i));
+        }
+        buf->len += 9;
+    }
+}
+
+void cbor_uint(cbor_buffer *buf, uint64_t value) {
+    write_head(buf, CBOR_UINT, value);
+}
+
+void cbor_int(cbor_buffer *buf, int64_t value) {
+    if (value < 0) {
+        write_head(buf, CBOR_NEGINT, -(value + 1));
+    } else {
+        write_head(buf, CBOR_UINT, value);
+    }
+}
+
+void cbor_text(cbor_buffer *buf, const char *str, size_t len) {
+    write_head(buf, CBOR_TEXT, len);
+    if (len == 0 || !reserve(buf, len)) {
+        return;
+    }
+    memcpy(buf->data + buf->len, str, len);
+    buf->len += len;
+}
+
+void cbor_cstr(cbor_buffer *buf, const char *str) {
+    cbor_text(buf, str, str ? strlen(str) : 0);
+}
+
+void cbor_array(cbor_buffer *buf, size_t len) {
+    write_head(buf, CBOR_ARRAY, len);
+}
+
+void cbor_map(cbor_buffer *buf, size_t len) {
+    write_head(buf, CBOR_MAP, len);
+}
+
+// Same shape as decode-ASTElement in protocol.typ, a missing value is an
+// empty string.
+void cbor_ASTElement(cbor_buffer *buf, const ASTElement *elem) {
+    tree_stack stack = {0};
+    while (elem) {
+        cbor_map(buf, 5);
+        cbor_text(buf, "type", 4);
+        cbor_int(buf, elem->type);
+        cbor_text(buf, "from", 4);
+        cbor_int(buf, elem->from);
+        cbor_text(buf, "to", 2);
+        cbor_int(buf, elem->to);
+        cbor_text(buf, "value", 5);
+        cbor_cstr(buf, elem->value);
+        cbor_text(buf, "children", 8);
+        cbor_array(buf, elem->children_len);
+        if (push_children(&stack, elem)) {
+            buf->failed = true;
+            break;
+        }
+        elem = stack.len > 0 ? stack.items[--stack.len] : NULL;
+    }
+    free(stack.items);
+}
@@ -0,0 +1,30 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include "ast/protocol.h"
+
+// Capacity to start a buffer with, reserve() doubles it as the output grows.
+#define CBOR_MIN_CAPACITY 256
+
+// Growable output buffer written in CBOR (RFC 8949) so that Typst can
+// decode the result natively with cbor().
+typedef struct cbor_buffer {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} cbor_buffer;
+
+cbor_buffer init_cbor(size_t cap);
+void free_cbor(cbor_buffer *buf);
+
+void cbor_uint(cbor_buffer *buf, uint64_t value);
+void cbor_int(cbor_buffer *buf, int64_t value);
+void cbor_text(cbor_buffer *buf, const char *str, size_t len);
+void cbor_cstr(cbor_buffer *buf, const char *str);
+void cbor_array(cbor_buffer *buf, size_t len);
+void cbor_map(cbor_buffer *buf, size_t len);
+
+void cbor_ASTElement(cbor_buffer *buf, const ASTElement *elem);
+
+#endif // CBOR_H
@@ -0,0 +1,72 @@
+#include "parser/compact.h"
+#include "parser/tree.h"
+
+#define COMPACT_VALUE 0x80
+#define COMPACT_CHILDREN 0x40
+
+// Most bytes a varint of 32 bits takes.
+#define VARINT_MAX 5
+
+static uint8_t *write_varint(uint8_t *out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = value | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+    return out;
+}
+
+// Maps small negative and positive numbers alike to small unsigned ones.
+static uint32_t zigzag(int value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static size_t value_len(const ASTElement *elem) {
+    return elem->value ? strlen(elem->value) : 0;
+}
+
+uint8_t *compact_ASTElement(const ASTElement *elem, size_t *len) {
+    // the tree is walked twice, once to bound its size then to write it
+    tree_stack stack = {0};
+    size_t bound = 0;
+    const ASTElement *e = elem;
+    while (e) {
+        bound += 1 + 4 * VARINT_MAX + value_len(e);
+        if (push_children(&stack, e)) {
+            free(stack.items);
+            return NULL;
+        }
+        e = stack.len > 0 ? stack.items[--stack.len] : NULL;
+    }
+    uint8_t *data = malloc(bound);
+    if (!data) {
+        free(stack.items);
+        return NULL;
+    }
+
+    uint8_t *out = data;
+    int from = 0;
+    e = elem;
+    while (e) {
+        size_t e_len = value_len(e);
+        *out++ = (e->type + 1) | (e_len ? COMPACT_VALUE : 0) |
+                 (e->children_len ? COMPACT_CHILDREN : 0);
+        out = write_varint(out, zigzag(e->from - from));
+        out = write_varint(out, zigzag(e->to - e->from));
+        from = e->from;
+        if (e_len) {
+            out = write_varint(out, e_len);
+            memcpy(out, e->value, e_len);
+            out += e_len;
+        }
+        if (e->children_len) {
+            out = write_varint(out, e->children_len);
+        }
+        // the stack is already large enough for every element
+        push_children(&stack, e);
+        e = stack.len > 0 ? stack.items[--stack.len] : NULL;
+    }
+    free(stack.items);
+    *len = out - data;
+    return data;
+}
@@ -0,0 +1,21 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include "ast/protocol.h"
+
+// Compact encoding of an ASTElement tree, decoded by compact.typ. Elements
+// are written in pre-order, each as:
+//   - a tag byte, type + 1 in the low bits (0 for an invalid element), 0x80
+//     when a value follows and 0x40 when children follow
+//   - from, as a zigzag varint delta to the from of the previous element
+//   - to - from, as a zigzag varint
+//   - when flagged, the length of the value as a varint and its bytes
+//   - when flagged, the number of children as a varint
+// Varints are LEB128: 7 bits per byte, lowest first, the high bit set on
+// every byte but the last.
+//
+// Returns the encoded tree in a buffer allocated with malloc, NULL on
+// failure.
+uint8_t *compact_ASTElement(const ASTElement *elem, size_t *len);
+
+#endif // COMPACT_H
@@ -0,0 +1,736 @@
+#include "parser/depict.h"
+#include "parser/rings.h"
+#include <math.h>
+
+#define PI 3.14159265358979323846
+
+// Non bonded atoms closer than this, in bond lengths, overlap.
+#define CLASH_DISTANCE 0.5
+// Overlaps looked at per round and flips tried per component.
+#define MAX_CLASHES 32
+#define MAX_FLIPS 64
+#define COMPONENT_SPACING 1.5
+
+typedef struct vec2 {
+    double x;
+    double y;
+} vec2;
+
+vec2 vec2_add(vec2 a, vec2 b) {
+    return (vec2){a.x + b.x, a.y + b.y};
+}
+
+vec2 vec2_sub(vec2 a, vec2 b) {
+    return (vec2){a.x - b.x, a.y - b.y};
+}
+
+vec2 vec2_scale(vec2 a, double s) {
+    return (vec2){a.x * s, a.y * s};
+}
+
+double vec2_len(vec2 a) {
+    return sqrt(a.x * a.x + a.y * a.y);
+}
+
+double vec2_angle(vec2 a) {
+    return atan2(a.y, a.x);
+}
+
+vec2 vec2_polar(double angle) {
+    return (vec2){cos(angle), sin(angle)};
+}
+
+vec2 vec2_rotate(vec2 a, double angle) {
+    double c = cos(angle), s = sin(angle);
+    return (vec2){a.x * c - a.y * s, a.x * s + a.y * c};
+}
+
+vec2 vec2_normalize(vec2 a, vec2 fallback) {
+    double len = vec2_len(a);
+    return len < 1e-9 ? fallback : vec2_scale(a, 1 / len);
+}
+
+// Reflection of a across the line through origin along the unit vector axis.
+vec2 vec2_mirror(vec2 a, vec2 origin, vec2 axis) {
+    vec2 rel = vec2_sub(a, origin);
+    double along = rel.x * axis.x + rel.y * axis.y;
+    return vec2_add(origin, vec2_sub(vec2_scale(axis, 2 * along), rel));
+}
+
+typedef struct depiction {
+    graph *g;
+    ring_set rings;
+    bool *ring_bonds;
+    // representative atom of the ring system of each atom, -1 outside rings
+    int *system;
+    // rings of each atom and rings of each system, by representative atom
+    atom_rings atom_rings;
+    int *system_rings;
+    int *system_rings_offsets;
+    char *ring_state;
+
+    vec2 *pos;
+    bool *placed;
+    // atom the position was derived from, which is the atom a ring system
+    // was entered from for its first atom and that first atom for the others
+    int *parent;
+    // side the chain turns to after each atom
+    int *zig;
+    int *order;
+    size_t order_len;
+    // placed atoms whose neighbours are not placed yet
+    int *pending;
+    size_t pending_len;
+    int *queue;
+    int *deferred;
+} depiction;
+
+enum { RING_NEW, RING_QUEUED, RING_PLACED };
+
+int find_root(int *roots, int atom) {
+    while (roots[atom] != atom) {
+        roots[atom] = roots[roots[atom]];
+        atom = roots[atom];
+    }
+    return atom;
+}
+
+// Indexes the rings by the ring system of their first atom. Returns false
+// when out of memory.
+bool index_system_rings(depiction *d) {
+    const ring_set *rings = &d->rings;
+    size_t n = d->g->atoms_len;
+    int *offsets = calloc(n + 2, sizeof(int));
+    if (!offsets) {
+        return false;
+    }
+    for (size_t r = 0; r < rings->len; r++) {
+        offsets[d->system[rings->atoms[rings->offsets[r]]] + 2]++;
+    }
+    for (size_t i = 2; i < n + 2; i++) {
+        offsets[i] += offsets[i - 1];
+    }
+    int *items = malloc(sizeof(int) * (offsets[n + 1] + 1));
+    if (!items) {
+        free(offsets);
+        return false;
+    }
+    for (size_t r = 0; r < rings->len; r++) {
+        items[offsets[d->system[rings->atoms[rings->offsets[r]]] + 1]++] = r;
+    }
+    d->system_rings_offsets = offsets;
+    d->system_rings = items;
+    return true;
+}
+
+// Returns false when out of memory.
+bool find_ring_systems(depiction *d) {
+    size_t n = d->g->atoms_len;
+    int *roots = malloc(sizeof(int) * n);
+    if (!roots) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        roots[i] = i;
+        d->system[i] = -1;
+    }
+    const ring_set *rings = &d->rings;
+    for (size_t r = 0; r < rings->len; r++) {
+        int first = find_root(roots, rings->atoms[rings->offsets[r]]);
+        for (int i = rings->offsets[r] + 1; i < rings->offsets[r + 1]; i++) {
+            int root = find_root(roots, rings->atoms[i]);
+            roots[root] = first;
+            first = find_root(roots, first);
+        }
+    }
+    for (size_t i = 0; i < rings->offsets[rings->len]; i++) {
+        d->system[rings->atoms[i]] = find_root(roots, rings->atoms[i]);
+    }
+    free(roots);
+    return index_system_rings(d);
+}
+
+void put_atom(depiction *d, int atom, vec2 pos) {
+    d->pos[atom] = pos;
+    d->placed[atom] = true;
+    d->order[d->order_len++] = atom;
+}
+
+bool ring_has_atom(const depiction *d, int ring, int atom) {
+    for (int i = d->rings.offsets[ring]; i < d->rings.offsets[ring + 1]; i++) {
+        if (d->rings.atoms[i] == atom) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Direction pointing out of the ring system at one of its atoms, away from
+// its placed neighbours in the system.
+vec2 ring_outward(const depiction *d, int atom) {
+    const graph *g = d->g;
+    vec2 sum = {0, 0};
+    int count = 0;
+    for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+        int next = g->adjacency[k];
+        if (d->placed[next] && d->system[next] == d->system[atom] &&
+            d->ring_bonds[g->adjacency_bonds[k]]) {
+            sum = vec2_add(sum, d->pos[next]);
+            count++;
+        }
+    }
+    if (count == 0) {
+        return (vec2){1, 0};
+    }
+    return vec2_normalize(vec2_sub(d->pos[atom], vec2_scale(sum, 1.0 / count)), (vec2){0, 1});
+}
+
+// Point the new atoms of ring between a and b should bulge away from: the
+// centre of the placed rings holding both atoms, else of the other placed
+// atoms of the ring, else of the whole system.
+vec2 bulge_reference(const depiction *d, int ring, int a, int b) {
+    vec2 sum = {0, 0};
+    int count = 0;
+    for (int k = d->atom_rings.offsets[a]; k < d->atom_rings.offsets[a + 1]; k++) {
+        int other = d->atom_rings.rings[k];
+        if (d->ring_state[other] != RING_PLACED || !ring_has_atom(d, other, b)) {
+            continue;
+        }
+        for (int i = d->rings.offsets[other]; i < d->rings.offsets[other + 1]; i++) {
+            sum = vec2_add(sum, d->pos[d->rings.atoms[i]]);
+            count++;
+        }
+    }
+    if (count == 0) {
+        for (int i = d->rings.offsets[ring]; i < d->rings.offsets[ring + 1]; i++) {
+            int atom = d->rings.atoms[i];
+            if (d->placed[atom] && atom != a && atom != b) {
+                sum = vec2_add(sum, d->pos[atom]);
+                count++;
+            }
+        }
+    }
+    if (count == 0) {
+        int system = d->system[a];
+        for (int k = d->system_rings_offsets[system]; k < d->system_rings_offsets[system + 1];
+             k++) {
+            int other = d->system_rings[k];
+            for (int i = d->rings.offsets[other]; i < d->rings.offsets[other + 1]; i++) {
+                if (d->placed[d->rings.atoms[i]]) {
+                    sum = vec2_add(sum, d->pos[d->rings.atoms[i]]);
+                    count++;
+                }
+            }
+        }
+    }
+    return count == 0 ? d->pos[a] : vec2_scale(sum, 1.0 / count);
+}
+
+void place_polygon(depiction *d, const int *atoms, int n, int first, vec2 center, double angle) {
+    double radius = 0.5 / sin(PI / n);
+    for (int i = 0; i < n; i++) {
+        int atom = atoms[(first + i) % n];
+        if (!d->placed[atom]) {
+            vec2 offset = vec2_scale(vec2_polar(angle - 2 * PI * i / n), radius);
+            put_atom(d, atom, vec2_add(center, offset));
+        }
+    }
+}
+
+// Places the len atoms following atoms[first] on a circular arc of unit
+// steps ending at the next placed atom, bulging away from ref. A fused ring
+// gets the arc of its regular polygon, a bridge a wider or flatter one.
+void place_arc(depiction *d, const int *atoms, int n, int first, int len, vec2 ref) {
+    vec2 a = d->pos[atoms[first]];
+    vec2 b = d->pos[atoms[(first + len + 1) % n]];
+    int steps = len + 1;
+    vec2 chord = vec2_sub(b, a);
+    double dist = vec2_len(chord);
+    if (dist >= steps - 1e-6) {
+        for (int i = 1; i <= len; i++) {
+            put_atom(d, atoms[(first + i) % n], vec2_add(a, vec2_scale(chord, (double)i / steps)));
+        }
+        return;
+    }
+    // the chord of steps unit steps turning by theta is sin(steps theta / 2) /
+    // sin(theta / 2), which decreases from steps to 0 over ]0, 2 pi / steps[
+    double low = 0, high = 2 * PI / steps;
+    for (int i = 0; i < 60; i++) {
+        double theta = (low + high) / 2;
+        if (sin(steps * theta / 2) / sin(theta / 2) > dist) {
+            low = theta;
+        } else {
+            high = theta;
+        }
+    }
+    double theta = (low + high) / 2;
+    double radius = 0.5 / sin(theta / 2);
+    vec2 middle = vec2_scale(vec2_add(a, b), 0.5);
+    vec2 normal = vec2_normalize((vec2){-chord.y, chord.x}, (vec2){0, 1});
+    if ((middle.x - ref.x) * normal.x + (middle.y - ref.y) * normal.y < 0) {
+        normal = vec2_scale(normal, -1);
+    }
+    vec2 center = vec2_sub(middle, vec2_scale(normal, radius * cos(steps * theta / 2)));
+    double start = vec2_angle(vec2_sub(a, center));
+    // turn the way that lands on b
+    vec2 forward = vec2_add(center, vec2_scale(vec2_polar(start + steps * theta), radius));
+    vec2 backward = vec2_add(center, vec2_scale(vec2_polar(start - steps * theta), radius));
+    double turn = vec2_len(vec2_sub(forward, b)) <= vec2_len(vec2_sub(backward, b)) ? 1 : -1;
+    for (int i = 1; i <= len; i++) {
+        vec2 pos = vec2_add(center, vec2_scale(vec2_polar(start + turn * i * theta), radius));
+        put_atom(d, atoms[(first + i) % n], pos);
+    }
+}
+
+void place_ring(depiction *d, int ring) {
+    const int *atoms = &d->rings.atoms[d->rings.offsets[ring]];
+    int n = d->rings.offsets[ring + 1] - d->rings.offsets[ring];
+    int placed = 0, last = 0;
+    for (int i = 0; i < n; i++) {
+        if (d->placed[atoms[i]]) {
+            placed++;
+            last = i;
+        }
+    }
+    if (placed == 0) {
+        place_polygon(d, atoms, n, 0, (vec2){0, 0}, PI / 2);
+    } else if (placed == 1) {
+        // spiro ring, drawn on the outer side of the shared atom
+        vec2 pos = d->pos[atoms[last]];
+        vec2 center = vec2_add(pos, vec2_scale(ring_outward(d, atoms[last]), 0.5 / sin(PI / n)));
+        place_polygon(d, atoms, n, last, center, vec2_angle(vec2_sub(pos, center)));
+    } else {
+        for (int i = 0; i < n; i++) {
+            if (!d->placed[atoms[i]] || d->placed[atoms[(i + 1) % n]]) {
+                continue;
+            }
+            int len = 1;
+            while (!d->placed[atoms[(i + len + 1) % n]]) {
+                len++;
+            }
+            vec2 ref = bulge_reference(d, ring, atoms[i], atoms[(i + len + 1) % n]);
+            place_arc(d, atoms, n, i, len, ref);
+        }
+    }
+    d->ring_state[ring] = RING_PLACED;
+}
+
+int placed_ring_atoms(const depiction *d, int ring) {
+    int placed = 0;
+    for (int i = d->rings.offsets[ring]; i < d->rings.offsets[ring + 1]; i++) {
+        placed += d->placed[d->rings.atoms[i]];
+    }
+    return placed;
+}
+
+// Lays a whole ring system out around the origin, ring after ring going
+// through the rings sharing atoms with the placed ones. Rings sharing a
+// single atom wait until no ring shares a bond, as their orientation is only
+// a guess until then.
+void layout_ring_system(depiction *d, int system) {
+    size_t head = 0, tail = 0, deferred_head = 0, deferred_tail = 0;
+    int first = d->system_rings[d->system_rings_offsets[system]];
+    d->ring_state[first] = RING_QUEUED;
+    d->deferred[deferred_tail++] = first;
+    for (;;) {
+        int ring;
+        if (head < tail) {
+            ring = d->queue[head++];
+            if (placed_ring_atoms(d, ring) < 2) {
+                d->deferred[deferred_tail++] = ring;
+                continue;
+            }
+        } else if (deferred_head < deferred_tail) {
+            ring = d->deferred[deferred_head++];
+        } else {
+            break;
+        }
+        place_ring(d, ring);
+        for (int i = d->rings.offsets[ring]; i < d->rings.offsets[ring + 1]; i++) {
+            int atom = d->rings.atoms[i];
+            for (int k = d->atom_rings.offsets[atom]; k < d->atom_rings.offsets[atom + 1]; k++) {
+                int next = d->atom_rings.rings[k];
+                if (d->ring_state[next] == RING_NEW) {
+                    d->ring_state[next] = RING_QUEUED;
+                    d->queue[tail++] = next;
+                }
+            }
+        }
+    }
+}
+
+// Whether the mirror image of the ring system placed from start, across the
+// bond it was entered through, takes the bonds leaving it further away from
+// back, which makes chains of rings zig-zag like chains of atoms.
+bool prefers_mirror(const depiction *d, size_t start, vec2 origin, vec2 axis, vec2 back) {
+    const graph *g = d->g;
+    double kept = 0, mirrored = 0;
+    for (size_t i = start; i < d->order_len; i++) {
+        int member = d->order[i];
+        for (int k = g->adjacency_offsets[member]; k < g->adjacency_offsets[member + 1]; k++) {
+            if (d->placed[g->adjacency[k]]) {
+                continue;
+            }
+            vec2 exit = vec2_add(d->pos[member], ring_outward(d, member));
+            kept += vec2_len(vec2_sub(exit, back));
+            mirrored += vec2_len(vec2_sub(vec2_mirror(exit, origin, axis), back));
+        }
+    }
+    return mirrored > kept + 1e-6;
+}
+
+// Places the ring system of atom, entered from the placed atom from along
+// dir, or as is for the first atom of a component when from is -1.
+void place_ring_system(depiction *d, int atom, int from, vec2 dir) {
+    size_t start = d->order_len;
+    layout_ring_system(d, d->system[atom]);
+    if (from >= 0) {
+        vec2 target = vec2_add(d->pos[from], dir);
+        vec2 local = d->pos[atom];
+        double rotation = vec2_angle(vec2_scale(dir, -1)) - vec2_angle(ring_outward(d, atom));
+        for (size_t i = start; i < d->order_len; i++) {
+            int member = d->order[i];
+            vec2 offset = vec2_rotate(vec2_sub(d->pos[member], local), rotation);
+            d->pos[member] = vec2_add(target, offset);
+        }
+        int back = d->parent[from];
+        if (back >= 0 && prefers_mirror(d, start, target, dir, d->pos[back])) {
+            for (size_t i = start; i < d->order_len; i++) {
+                d->pos[d->order[i]] = vec2_mirror(d->pos[d->order[i]], target, dir);
+            }
+        }
+    }
+    for (size_t i = start; i < d->order_len; i++) {
+        int member = d->order[i];
+        d->parent[member] = member == atom ? from : atom;
+        d->zig[member] = -1;
+        d->pending[d->pending_len++] = member;
+    }
+}
+
+// Atoms with a triple bond or two double bonds keep their neighbours aligned.
+bool is_linear(const depiction *d, int atom) {
+    const graph *g = d->g;
+    int begin = g->adjacency_offsets[atom], end = g->adjacency_offsets[atom + 1];
+    if (end - begin != 2) {
+        return false;
+    }
+    int first = g->bonds[g->adjacency_bonds[begin]].order;
+    int second = g->bonds[g->adjacency_bonds[begin + 1]].order;
+    return first >= 3 || second >= 3 || (first == 2 && second == 2);
+}
+
+double normalize_angle(double angle) {
+    while (angle > PI) {
+        angle -= 2 * PI;
+    }
+    while (angle <= -PI) {
+        angle += 2 * PI;
+    }
+    return angle;
+}
+
+void place_neighbours(depiction *d, int atom) {
+    const graph *g = d->g;
+    int begin = g->adjacency_offsets[atom], end = g->adjacency_offsets[atom + 1];
+    int degree = end - begin, unplaced = 0, from = -1;
+    for (int k = begin; k < end; k++) {
+        if (!d->placed[g->adjacency[k]]) {
+            unplaced++;
+        } else if (from < 0 || g->adjacency[k] == d->parent[atom]) {
+            from = g->adjacency[k];
+        }
+    }
+    if (unplaced == 0) {
+        return;
+    }
+    double incoming = from >= 0 ? vec2_angle(vec2_sub(d->pos[atom], d->pos[from])) : 0;
+    double outward = d->system[atom] >= 0 ? vec2_angle(ring_outward(d, atom)) : 0;
+    int i = 0;
+    for (int k = begin; k < end; k++) {
+        int next = g->adjacency[k];
+        if (d->placed[next]) {
+            continue;
+        }
+        double angle;
+        if (d->system[atom] >= 0) {
+            // substituents of a ring atom fan out around the outward direction
+            double step = unplaced > 1 ? fmin(PI / 3, 2 * PI / 3 / (unplaced - 1)) : 0;
+            angle = outward + (i - (unplaced - 1) / 2.0) * step;
+        } else if (from < 0) {
+            angle = PI / 6 + i * 2 * PI / (unplaced > 3 ? unplaced : 3);
+        } else if (is_linear(d, atom)) {
+            angle = incoming;
+        } else if (degree == 2) {
+            angle = incoming + d->zig[atom] * PI / 3;
+        } else {
+            // the first neighbour carries on the zig-zag of the chain
+            int slot = d->zig[atom] > 0 ? unplaced - 1 - i : i;
+            angle = incoming + PI + 2 * PI / degree * (slot + 1);
+        }
+        vec2 dir = vec2_polar(angle);
+        if (d->system[next] >= 0) {
+            place_ring_system(d, next, atom, dir);
+        } else {
+            put_atom(d, next, vec2_add(d->pos[atom], dir));
+            double turn = from >= 0 && d->system[atom] < 0 ? normalize_angle(angle - incoming) : 0;
+            d->parent[next] = atom;
+            d->zig[next] = turn > 1e-6 ? -1 : turn < -1e-6 ? 1 : d->zig[atom];
+            d->pending[d->pending_len++] = next;
+        }
+        i++;
+    }
+}
+
+typedef struct clash_grid {
+    int *heads;
+    int *next;
+    size_t mask;
+} clash_grid;
+
+long cell_of(double value) {
+    return (long)floor(value / CLASH_DISTANCE);
+}
+
+size_t cell_hash(const clash_grid *grid, long x, long y) {
+    return ((size_t)x * 73856093u ^ (size_t)y * 19349663u) & grid->mask;
+}
+
+// Counts the pairs of atoms of the component closer than CLASH_DISTANCE, up
+// to limit, and keeps the first MAX_CLASHES of them in pairs when it is not
+// NULL. The limit keeps badly folded layouts from costing a quadratic time.
+int count_clashes(const depiction *d, clash_grid *grid, const int *atoms, size_t len, int limit,
+                  int *pairs, int *pairs_len) {
+    if (pairs_len) {
+        *pairs_len = 0;
+    }
+    for (size_t i = 0; i <= grid->mask; i++) {
+        grid->heads[i] = -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        vec2 pos = d->pos[atoms[i]];
+        size_t hash = cell_hash(grid, cell_of(pos.x), cell_of(pos.y));
+        grid->next[atoms[i]] = grid->heads[hash];
+        grid->heads[hash] = atoms[i];
+    }
+    int clashes = 0;
+    for (size_t i = 0; i < len; i++) {
+        int atom = atoms[i];
+        vec2 pos = d->pos[atom];
+        long x = cell_of(pos.x), y = cell_of(pos.y);
+        for (long dx = -1; dx <= 1; dx++) {
+            for (long dy = -1; dy <= 1; dy++) {
+                for (int other = grid->heads[cell_hash(grid, x + dx, y + dy)]; other >= 0;
+                     other = grid->next[other]) {
+                    vec2 other_pos = d->pos[other];
+                    if (other <= atom || cell_of(other_pos.x) != x + dx ||
+                        cell_of(other_pos.y) != y + dy ||
+                        vec2_len(vec2_sub(other_pos, pos)) >= CLASH_DISTANCE) {
+                        continue;
+                    }
+                    if (pairs && clashes < MAX_CLASHES) {
+                        pairs[2 * clashes] = atom;
+                        pairs[2 * clashes + 1] = other;
+                        *pairs_len = clashes + 1;
+                    }
+                    if (++clashes >= limit) {
+                        return clashes;
+                    }
+                }
+            }
+        }
+    }
+    return clashes;
+}
+
+// Mirrors everything placed from atom across its bond to its parent.
+void flip_subtree(depiction *d, const int *first_child, const int *next_sibling, int *stack,
+                  int atom) {
+    vec2 origin = d->pos[d->parent[atom]];
+    vec2 axis = vec2_normalize(vec2_sub(d->pos[atom], origin), (vec2){1, 0});
+    size_t len = 0;
+    stack[len++] = atom;
+    while (len > 0) {
+        int current = stack[--len];
+        d->pos[current] = vec2_mirror(d->pos[current], origin, axis);
+        for (int child = first_child[current]; child >= 0; child = next_sibling[child]) {
+            stack[len++] = child;
+        }
+    }
+}
+
+// Only bonds outside ring systems can be flipped around.
+bool is_flippable(const depiction *d, int atom) {
+    int parent = d->parent[atom];
+    return parent >= 0 && (d->system[atom] < 0 || d->system[atom] != d->system[parent]);
+}
+
+// Returns false when out of memory.
+bool resolve_overlaps(depiction *d, size_t start) {
+    const int *atoms = &d->order[start];
+    size_t len = d->order_len - start;
+    if (len < 3) {
+        return true;
+    }
+    size_t n = d->g->atoms_len;
+    clash_grid grid = {.next = malloc(sizeof(int) * n)};
+    size_t buckets = 16;
+    while (buckets < 2 * len) {
+        buckets *= 2;
+    }
+    grid.heads = malloc(sizeof(int) * buckets);
+    grid.mask = buckets - 1;
+    if (!grid.next || !grid.heads) {
+        free(grid.next);
+        free(grid.heads);
+        return false;
+    }
+    int pairs[2 * MAX_CLASHES];
+    int pairs_len = 0;
+    int clashes = count_clashes(d, &grid, atoms, len, len, pairs, &pairs_len);
+    if (clashes == 0) {
+        free(grid.next);
+        free(grid.heads);
+        return true;
+    }
+
+    int *first_child = malloc(sizeof(int) * n);
+    int *next_sibling = malloc(sizeof(int) * n);
+    int *stack = malloc(sizeof(int) * n);
+    if (!first_child || !next_sibling || !stack) {
+        free(grid.next);
+        free(grid.heads);
+        free(first_child);
+        free(next_sibling);
+        free(stack);
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        first_child[atoms[i]] = -1;
+    }
+    for (size_t i = len; i-- > 0;) {
+        int parent = d->parent[atoms[i]];
+        if (parent >= 0) {
+            next_sibling[atoms[i]] = first_child[parent];
+            first_child[parent] = atoms[i];
+        }
+    }
+    int flips = 0;
+    bool improved = true;
+    while (clashes > 0 && improved && flips < MAX_FLIPS) {
+        improved = false;
+        for (int p = 0; p < pairs_len && !improved && flips < MAX_FLIPS; p++) {
+            // try the nearest flippable bonds above the later atom, then the other one
+            for (int side = 1; side >= 0 && !improved; side--) {
+                int tried = 0;
+                for (int atom = pairs[2 * p + side]; atom >= 0 && tried < 3 && !improved;
+                     atom = d->parent[atom]) {
+                    if (!is_flippable(d, atom) || flips >= MAX_FLIPS) {
+                        continue;
+                    }
+                    tried++;
+                    flips++;
+                    flip_subtree(d, first_child, next_sibling, stack, atom);
+                    int after = count_clashes(d, &grid, atoms, len, clashes, NULL, NULL);
+                    if (after < clashes) {
+                        improved = true;
+                    } else {
+                        flip_subtree(d, first_child, next_sibling, stack, atom);
+                    }
+                }
+            }
+        }
+        if (improved) {
+            clashes = count_clashes(d, &grid, atoms, len, len, pairs, &pairs_len);
+        }
+    }
+    free(grid.next);
+    free(grid.heads);
+    free(first_child);
+    free(next_sibling);
+    free(stack);
+    return true;
+}
+
+// Moves the component placed from start on to the right of the previous
+// ones, centred on the x axis, and returns its right edge.
+double align_component(depiction *d, size_t start, double right) {
+    vec2 min = d->pos[d->order[start]], max = min;
+    for (size_t i = start; i < d->order_len; i++) {
+        vec2 pos = d->pos[d->order[i]];
+        min = (vec2){fmin(min.x, pos.x), fmin(min.y, pos.y)};
+        max = (vec2){fmax(max.x, pos.x), fmax(max.y, pos.y)};
+    }
+    vec2 shift = {(start == 0 ? 0 : right + COMPONENT_SPACING) - min.x, -(min.y + max.y) / 2};
+    for (size_t i = start; i < d->order_len; i++) {
+        d->pos[d->order[i]] = vec2_add(d->pos[d->order[i]], shift);
+    }
+    return max.x + shift.x;
+}
+
+void depict_graph(parser_ctx *ctx, graph *g) {
+    size_t n = g->atoms_len;
+    if (n == 0) {
+        return;
+    }
+    depiction d = {.g = g};
+    d.ring_bonds = find_ring_bonds(ctx, g);
+    d.rings = find_rings(ctx, g, d.ring_bonds);
+    if (ctx->errored) {
+        return;
+    }
+    d.system = malloc(sizeof(int) * n);
+    d.ring_state = calloc(d.rings.len + 1, sizeof(char));
+    d.pos = malloc(sizeof(vec2) * n);
+    d.placed = calloc(n, sizeof(bool));
+    d.parent = malloc(sizeof(int) * n);
+    d.zig = malloc(sizeof(int) * n);
+    d.order = malloc(sizeof(int) * n);
+    d.pending = malloc(sizeof(int) * n);
+    d.queue = malloc(sizeof(int) * (d.rings.len + 1));
+    d.deferred = malloc(sizeof(int) * (d.rings.len + 1));
+    d.atom_rings = index_atom_rings(ctx, n, &d.rings);
+    bool ok = !ctx->errored && d.system && d.ring_state && d.pos && d.placed && d.parent &&
+              d.zig && d.order && d.pending && d.queue && d.deferred && find_ring_systems(&d);
+
+    double right = 0;
+    for (size_t atom = 0; ok && atom < n; atom++) {
+        if (d.placed[atom]) {
+            continue;
+        }
+        size_t start = d.order_len;
+        if (d.system[atom] >= 0) {
+            place_ring_system(&d, atom, -1, (vec2){0, 0});
+        } else {
+            put_atom(&d, atom, (vec2){0, 0});
+            d.parent[atom] = -1;
+            d.zig[atom] = -1;
+            d.pending[d.pending_len++] = atom;
+        }
+        while (d.pending_len > 0) {
+            place_neighbours(&d, d.pending[--d.pending_len]);
+        }
+        ok = resolve_overlaps(&d, start);
+        right = align_component(&d, start, right);
+    }
+    for (size_t i = 0; ok && i < n; i++) {
+        g->atoms[i].x = d.pos[i].x;
+        g->atoms[i].y = d.pos[i].y;
+    }
+    if (!ok && !ctx->errored) {
+        error(ctx, "Out of memory");
+    }
+
+    free(d.system);
+    free(d.system_rings);
+    free(d.system_rings_offsets);
+    free(d.ring_state);
+    free(d.pos);
+    free(d.placed);
+    free(d.parent);
+    free(d.zig);
+    free(d.order);
+    free(d.pending);
+    free(d.queue);
+    free(d.deferred);
+}
@@ -0,0 +1,17 @@
+#ifndef DEPICT_H
+#define DEPICT_H
+
+#include "parser/graph.h"
+
+// Lays the graph out in 2D and stores the coordinates in the x and y fields
+// of its atoms, in bond lengths with y pointing up.
+//
+// Ring systems are drawn from regular polygons fused on their shared bonds,
+// chains zig-zag at 120 degrees and substituents are spread around their
+// atom. Overlapping atoms are then separated by flipping the substituent
+// holding them around its bond. Disconnected components are placed from
+// left to right. Out of memory, ctx is errored and the atoms keep the
+// coordinates they had.
+void depict_graph(parser_ctx *ctx, graph *g);
+
+#endif // DEPICT_H
@@ -0,0 +1,291 @@
+#include "parser/elements.h"
+
+const char atomic_symbols[ELEMENT_COUNT][3] = {
+    "*", "H", "He", "Li", "Be", "B", "C", "N", "O", "F", "Ne", "Na", "Mg", "Al", "Si", "P", "S",
+    "Cl", "Ar", "K", "Ca", "Sc", "Ti", "V", "Cr", "Mn", "Fe", "Co", "Ni", "Cu", "Zn", "Ga", "Ge",
+    "As", "Se", "Br", "Kr", "Rb", "Sr", "Y", "Zr", "Nb", "Mo", "Tc", "Ru", "Rh", "Pd", "Ag", "Cd",
+    "In", "Sn", "Sb", "Te", "I", "Xe", "Cs", "Ba", "La", "Ce", "Pr", "Nd", "Pm", "Sm", "Eu", "Gd",
+    "Tb", "Dy", "Ho", "Er", "Tm", "Yb", "Lu", "Hf", "Ta", "W", "Re", "Os", "Ir", "Pt", "Au", "Hg",
+    "Tl", "Pb", "Bi", "Po", "At", "Rn", "Fr", "Ra", "Ac", "Th", "Pa", "U", "Np", "Pu", "Am", "Cm",
+    "Bk", "Cf", "Es", "Fm", "Md", "No", "Lr", "Rf", "Db", "Sg", "Bh", "Hs", "Mt", "Ds", "Rg", "Cn",
+    "Nh", "Fl", "Mc", "Lv", "Ts", "Og",
+};
+
+const element_properties element_table[ELEMENT_COUNT] = {
+    {0, 0, 0, 0, 0, {0}},                                        // *
+    {1.008, 1.00782503, 1, 1, 0, {0}},                           // H
+    {4.002602, 4.00260325, 4, 18, 0, {0}},                       // He
+    {6.94, 7.01600344, 7, 1, 0, {0}},                            // Li
+    {9.0121831, 9.0121831, 9, 2, 0, {0}},                        // Be
+    {10.81, 11.00930536, 11, 13, ELEMENT_AROMATIC, {3}},         // B
+    {12.011, 12.0, 12, 14, ELEMENT_AROMATIC, {4}},               // C
+    {14.007, 14.00307401, 14, 15, ELEMENT_AROMATIC, {3, 5}},     // N
+    {15.999, 15.99491462, 16, 16, ELEMENT_AROMATIC, {2}},        // O
+    {18.998403163, 18.99840316, 19, 17, 0, {1}},                 // F
+    {20.1797, 19.99244018, 20, 18, 0, {0}},                      // Ne
+    {22.98976928, 22.98976928, 23, 1, 0, {0}},                   // Na
+    {24.305, 23.9850417, 24, 2, 0, {0}},                         // Mg
+    {26.9815385, 26.98153853, 27, 13, 0, {0}},                   // Al
+    {28.085, 27.97692653, 28, 14, 0, {0}},                       // Si
+    {30.973761998, 30.973762, 31, 15, ELEMENT_AROMATIC, {3, 5}}, // P
+    {32.06, 31.97207117, 32, 16, ELEMENT_AROMATIC, {2, 4, 6}},   // S
+    {35.45, 34.96885268, 35, 17, 0, {1}},                        // Cl
+    {39.948, 39.96238312, 40, 18, 0, {0}},                       // Ar
+    {39.0983, 38.96370649, 39, 1, 0, {0}},                       // K
+    {40.078, 39.96259086, 40, 2, 0, {0}},                        // Ca
+    {44.955908, 44.95590828, 45, 3, 0, {0}},                     // Sc
+    {47.867, 47.94794198, 48, 4, 0, {0}},                        // Ti
+    {50.9415, 50.94395704, 51, 5, 0, {0}},                       // V
+    {51.9961, 51.94050623, 52, 6, 0, {0}},                       // Cr
+    {54.938044, 54.93804391, 55, 7, 0, {0}},                     // Mn
+    {55.845, 55.93493633, 56, 8, 0, {0}},                        // Fe
+    {58.933194, 58.93319429, 59, 9, 0, {0}},                     // Co
+    {58.6934, 57.93534241, 58, 10, 0, {0}},                      // Ni
+    {63.546, 62.92959772, 63, 11, 0, {0}},                       // Cu
+    {65.38, 63.92914201, 64, 12, 0, {0}},                        // Zn
+    {69.723, 68.9255736, 69, 13, 0, {0}},                        // Ga
+    {72.63, 73.92117776, 74, 14, 0, {0}},                        // Ge
+    {74.921595, 74.92159457, 75, 15, ELEMENT_AROMATIC, {3, 5}},  // As
+    {78.971, 79.9165218, 80, 16, ELEMENT_AROMATIC, {2, 4, 6}},   // Se
+    {79.904, 78.9183371, 79, 17, 0, {1}},                        // Br
+    {83.798, 83.91149773, 84, 18, 0, {0}},                       // Kr
+    {85.4678, 84.91178974, 85, 1, 0, {0}},                       // Rb
+    {87.62, 87.90561226, 88, 2, 0, {0}},                         // Sr
+    {88.90584, 88.9058403, 89, 3, 0, {0}},                       // Y
+    {91.224, 89.90469876, 90, 4, 0, {0}},                        // Zr
+    {92.90637, 92.9063732, 93, 5, 0, {0}},                       // Nb
+    {95.95, 97.90540482, 98, 6, 0, {0}},                         // Mo
+    {98, 97.9072124, 98, 7, 0, {0}},                             // Tc
+    {101.07, 101.9043493, 102, 8, 0, {0}},                       // Ru
+    {102.9055, 102.905498, 103, 9, 0, {0}},                      // Rh
+    {106.42, 105.9034804, 106, 10, 0, {0}},                      // Pd
+    {107.8682, 106.9050915, 107, 11, 0, {0}},                    // Ag
+    {112.414, 113.90336509, 114, 12, 0, {0}},                    // Cd
+    {114.818, 114.90387878, 115, 13, 0, {0}},                    // In
+    {118.71, 119.90220163, 120, 14, 0, {0}},                     // Sn
+    {121.76, 120.903812, 121, 15, 0, {0}},                       // Sb
+    {127.6, 129.90622275, 130, 16, 0, {0}},                      // Te
+    {126.90447, 126.9044719, 127, 17, 0, {1}},                   // I
+    {131.293, 131.90415509, 132, 18, 0, {0}},                    // Xe
+    {132.90545196, 132.90545196, 133, 1, 0, {0}},                // Cs
+    {137.327, 137.905247, 138, 2, 0, {0}},                       // Ba
+    {138.90547, 138.9063563, 139, 3, 0, {0}},                    // La
+    {140.116, 139.9054431, 140, 0, 0, {0}},                      // Ce
+    {140.90766, 140.9076576, 141, 0, 0, {0}},                    // Pr
+    {144.242, 141.907729, 142, 0, 0, {0}},                       // Nd
+    {145, 144.9127559, 145, 0, 0, {0}},                          // Pm
+    {150.36, 151.9197397, 152, 0, 0, {0}},                       // Sm
+    {151.964, 152.921238, 153, 0, 0, {0}},                       // Eu
+    {157.25, 157.9241123, 158, 0, 0, {0}},                       // Gd
+    {158.92535, 158.9253547, 159, 0, 0, {0}},                    // Tb
+    {162.5, 163.9291819, 164, 0, 0, {0}},                        // Dy
+    {164.93033, 164.9303288, 165, 0, 0, {0}},                    // Ho
+    {167.259, 165.9302995, 166, 0, 0, {0}},                      // Er
+    {168.93422, 168.9342179, 169, 0, 0, {0}},                    // Tm
+    {173.045, 173.9388664, 174, 0, 0, {0}},                      // Yb
+    {174.9668, 174.9407752, 175, 0, 0, {0}},                     // Lu
+    {178.49, 179.946557, 180, 4, 0, {0}},                        // Hf
+    {180.94788, 180.9479958, 181, 5, 0, {0}},                    // Ta
+    {183.84, 183.95093092, 184, 6, 0, {0}},                      // W
+    {186.207, 186.9557501, 187, 7, 0, {0}},                      // Re
+    {190.23, 191.961477, 192, 8, 0, {0}},                        // Os
+    {192.217, 192.9629216, 193, 9, 0, {0}},                      // Ir
+    {195.084, 194.9647917, 195, 10, 0, {0}},                     // Pt
+    {196.966569, 196.96656879, 197, 11, 0, {0}},                 // Au
+    {200.592, 201.9706434, 202, 12, 0, {0}},                     // Hg
+    {204.38, 204.974427, 205, 13, 0, {0}},                       // Tl
+    {207.2, 207.9766525, 208, 14, 0, {0}},                       // Pb
+    {208.9804, 208.9803991, 209, 15, 0, {0}},                    // Bi
+    {209, 208.9824308, 209, 16, 0, {0}},                         // Po
+    {210, 209.9871479, 210, 17, 0, {0}},                         // At
+    {222, 222.0175782, 222, 18, 0, {0}},                         // Rn
+    {223, 223.019736, 223, 1, 0, {0}},                           // Fr
+    {226, 226.0254103, 226, 2, 0, {0}},                          // Ra
+    {227, 227.0277523, 227, 3, 0, {0}},                          // Ac
+    {232.0377, 232.0380558, 232, 0, 0, {0}},                     // Th
+    {231.03588, 231.0358842, 231, 0, 0, {0}},                    // Pa
+    {238.02891, 238.0507884, 238, 0, 0, {0}},                    // U
+    {237, 237.0481736, 237, 0, 0, {0}},                          // Np
+    {244, 244.0642053, 244, 0, 0, {0}},                          // Pu
+    {243, 243.0613813, 243, 0, 0, {0}},                          // Am
+    {247, 247.0703541, 247, 0, 0, {0}},                          // Cm
+    {247, 247.0703073, 247, 0, 0, {0}},                          // Bk
+    {251, 251.0795886, 251, 0, 0, {0}},                          // Cf
+    {252, 252.08298, 252, 0, 0, {0}},                            // Es
+    {257, 257.0951061, 257, 0, 0, {0}},                          // Fm
+    {258, 258.0984315, 258, 0, 0, {0}},                          // Md
+    {259, 259.10103, 259, 0, 0, {0}},                            // No
+    {266, 266.11983, 266, 0, 0, {0}},                            // Lr
+    {267, 267.12179, 267, 4, 0, {0}},                            // Rf
+    {268, 268.12567, 268, 5, 0, {0}},                            // Db
+    {269, 269.12863, 269, 6, 0, {0}},                            // Sg
+    {270, 270.13336, 270, 7, 0, {0}},                            // Bh
+    {269, 269.13375, 269, 8, 0, {0}},                            // Hs
+    {278, 278.15631, 278, 9, 0, {0}},                            // Mt
+    {281, 281.16451, 281, 10, 0, {0}},                           // Ds
+    {282, 282.16912, 282, 11, 0, {0}},                           // Rg
+    {285, 285.17712, 285, 12, 0, {0}},                           // Cn
+    {286, 286.18221, 286, 13, 0, {0}},                           // Nh
+    {289, 289.19042, 289, 14, 0, {0}},                           // Fl
+    {290, 290.19598, 290, 15, 0, {0}},                           // Mc
+    {293, 293.20449, 293, 16, 0, {0}},                           // Lv
+    {294, 294.21046, 294, 17, 0, {0}},                           // Ts
+    {294, 294.21392, 294, 18, 0, {0}},                           // Og
+};
+
+// Usual isotope labels other than the most abundant isotopes, sorted by
+// element then mass number.
+typedef struct isotope {
+    uint8_t element;
+    uint16_t mass_number;
+    double mass;
+} isotope;
+
+const isotope isotope_table[] = {
+    {1, 2, 2.01410177812},   {1, 3, 3.0160492779},    {2, 3, 3.0160293201},
+    {3, 6, 6.0151228874},    {5, 10, 10.01293695},    {6, 11, 11.0114336},
+    {6, 13, 13.00335483507}, {6, 14, 14.0032419884},  {7, 13, 13.00573861},
+    {7, 15, 15.00010889888}, {8, 15, 15.0030656},     {8, 17, 16.9991317565},
+    {8, 18, 17.99915961286}, {9, 18, 18.0009373},     {14, 29, 28.9764946649},
+    {14, 30, 29.973770136},  {15, 32, 31.9739076},    {16, 33, 32.9714589098},
+    {16, 34, 33.967867004},  {16, 35, 34.96903231},   {17, 36, 35.96830698},
+    {17, 37, 36.9659026},    {29, 64, 63.9297642},    {31, 67, 66.9282017},
+    {31, 68, 67.9279801},    {35, 76, 75.924542},     {35, 81, 80.9162897},
+    {40, 89, 88.9088895},    {43, 99, 98.9062508},    {49, 111, 110.9051085},
+    {53, 123, 122.905589},   {53, 124, 123.9062099},  {53, 125, 124.9046302},
+    {53, 131, 130.9061246},  {81, 201, 200.970819},
+};
+
+#define SYMBOL(a, number) [(a) - BASE][0] = (number)
+#define SYMBOL2(a, b, number) [(a) - BASE][1 + (b) - 'a'] = (number)
+
+#define BASE 'A'
+const symbol_table element_symbols_table = {
+    .base = BASE,
+    .numbers = {
+        SYMBOL2('A', 'c', 89), SYMBOL2('A', 'g', 47), SYMBOL2('A', 'l', 13), SYMBOL2('A', 'm', 95),
+        SYMBOL2('A', 'r', 18), SYMBOL2('A', 's', 33), SYMBOL2('A', 't', 85), SYMBOL2('A', 'u', 79),
+        SYMBOL('B', 5), SYMBOL2('B', 'a', 56), SYMBOL2('B', 'e', 4), SYMBOL2('B', 'h', 107),
+        SYMBOL2('B', 'i', 83), SYMBOL2('B', 'k', 97), SYMBOL2('B', 'r', 35),
+        SYMBOL('C', 6), SYMBOL2('C', 'a', 20), SYMBOL2('C', 'd', 48), SYMBOL2('C', 'e', 58),
+        SYMBOL2('C', 'f', 98), SYMBOL2('C', 'l', 17), SYMBOL2('C', 'm', 96), SYMBOL2('C', 'n', 112),
+        SYMBOL2('C', 'o', 27), SYMBOL2('C', 'r', 24), SYMBOL2('C', 's', 55), SYMBOL2('C', 'u', 29),
+        SYMBOL2('D', 'b', 105), SYMBOL2('D', 's', 110), SYMBOL2('D', 'y', 66),
+        SYMBOL2('E', 'r', 68), SYMBOL2('E', 's', 99), SYMBOL2('E', 'u', 63),
+        SYMBOL('F', 9), SYMBOL2('F', 'e', 26), SYMBOL2('F', 'l', 114), SYMBOL2('F', 'm', 100),
+        SYMBOL2('F', 'r', 87),
+        SYMBOL2('G', 'a', 31), SYMBOL2('G', 'd', 64), SYMBOL2('G', 'e', 32),
+        SYMBOL('H', 1), SYMBOL2('H', 'e', 2), SYMBOL2('H', 'f', 72), SYMBOL2('H', 'g', 80),
+        SYMBOL2('H', 'o', 67), SYMBOL2('H', 's', 108),
+        SYMBOL('I', 53), SYMBOL2('I', 'n', 49), SYMBOL2('I', 'r', 77),
+        SYMBOL('K', 19), SYMBOL2('K', 'r', 36),
+        SYMBOL2('L', 'a', 57), SYMBOL2('L', 'i', 3), SYMBOL2('L', 'r', 103), SYMBOL2('L', 'u', 71),
+        SYMBOL2('L', 'v', 116),
+        SYMBOL2('M', 'd', 101), SYMBOL2('M', 'g', 12), SYMBOL2('M', 'n', 25), SYMBOL2('M', 'o', 42),
+        SYMBOL2('M', 't', 109),
+        SYMBOL('N', 7), SYMBOL2('N', 'a', 11), SYMBOL2('N', 'b', 41), SYMBOL2('N', 'd', 60),
+        SYMBOL2('N', 'e', 10), SYMBOL2('N', 'i', 28), SYMBOL2('N', 'o', 102), SYMBOL2('N', 'p', 93),
+        SYMBOL('O', 8), SYMBOL2('O', 's', 76),
+        SYMBOL('P', 15), SYMBOL2('P', 'a', 91), SYMBOL2('P', 'b', 82), SYMBOL2('P', 'd', 46),
+        SYMBOL2('P', 'm', 61), SYMBOL2('P', 'o', 84), SYMBOL2('P', 'r', 59), SYMBOL2('P', 't', 78),
+        SYMBOL2('P', 'u', 94),
+        SYMBOL2('R', 'a', 88), SYMBOL2('R', 'b', 37), SYMBOL2('R', 'e', 75), SYMBOL2('R', 'f', 104),
+        SYMBOL2('R', 'g', 111), SYMBOL2('R', 'h', 45), SYMBOL2('R', 'n', 86), SYMBOL2('R', 'u', 44),
+        SYMBOL('S', 16), SYMBOL2('S', 'b', 51), SYMBOL2('S', 'c', 21), SYMBOL2('S', 'e', 34),
+        SYMBOL2('S', 'g', 106), SYMBOL2('S', 'i', 14), SYMBOL2('S', 'm', 62), SYMBOL2('S', 'n', 50),
+        SYMBOL2('S', 'r', 38),
+        SYMBOL2('T', 'a', 73), SYMBOL2('T', 'b', 65), SYMBOL2('T', 'c', 43), SYMBOL2('T', 'e', 52),
+        SYMBOL2('T', 'h', 90), SYMBOL2('T', 'i', 22), SYMBOL2('T', 'l', 81), SYMBOL2('T', 'm', 69),
+        SYMBOL('U', 92),
+        SYMBOL('V', 23),
+        SYMBOL('W', 74),
+        SYMBOL2('X', 'e', 54),
+        SYMBOL('Y', 39), SYMBOL2('Y', 'b', 70),
+        SYMBOL2('Z', 'n', 30), SYMBOL2('Z', 'r', 40),
+    },
+};
+
+const symbol_table aliphatic_organic_table = {
+    .base = BASE,
+    .numbers = {
+        SYMBOL('B', 5), SYMBOL2('B', 'r', 35),
+        SYMBOL('C', 6), SYMBOL2('C', 'l', 17),
+        SYMBOL('F', 9),
+        SYMBOL('I', 53),
+        SYMBOL('N', 7),
+        SYMBOL('O', 8),
+        SYMBOL('P', 15),
+        SYMBOL('S', 16),
+    },
+};
+#undef BASE
+
+#define BASE 'a'
+const symbol_table aromatic_symbols_table = {
+    .base = BASE,
+    .numbers = {
+        SYMBOL2('a', 's', 33),
+        SYMBOL('b', 5),
+        SYMBOL('c', 6),
+        SYMBOL('n', 7),
+        SYMBOL('o', 8),
+        SYMBOL('p', 15),
+        SYMBOL('s', 16), SYMBOL2('s', 'e', 34),
+    },
+};
+#undef BASE
+
+int lookup_symbol(const symbol_table *table, const char *str, size_t str_len, size_t *len) {
+    if (str_len == 0 || str[0] < table->base || str[0] >= table->base + 26) {
+        return 0;
+    }
+    const uint8_t *numbers = table->numbers[str[0] - table->base];
+    if (str_len > 1 && str[1] >= 'a' && str[1] <= 'z' && numbers[1 + str[1] - 'a']) {
+        *len = 2;
+        return numbers[1 + str[1] - 'a'];
+    }
+    *len = 1;
+    return numbers[0];
+}
+
+int default_valence(int element, int charge, int bonds) {
+    if (element < 0 || element >= ELEMENT_COUNT) {
+        return -1;
+    }
+    const element_properties *properties = &element_table[element];
+    int shift = charge;
+    if (properties->group == 14) {
+        shift = charge < 0 ? charge : -charge;
+    } else if (properties->group < 14) {
+        shift = -charge;
+    }
+    for (int i = 0; i < 3 && properties->valences[i]; i++) {
+        int valence = properties->valences[i] + shift;
+        if (valence >= bonds && valence >= 0) {
+            return valence;
+        }
+    }
+    return -1;
+}
+
+double isotope_mass(int element, int mass_number) {
+    if (element > 0 && element < ELEMENT_COUNT &&
+        element_table[element].mass_number == mass_number) {
+        return element_table[element].exact_mass;
+    }
+    size_t low = 0, high = sizeof(isotope_table) / sizeof(isotope_table[0]);
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        const isotope *entry = &isotope_table[mid];
+        if (entry->element == element && entry->mass_number == mass_number) {
+            return entry->mass;
+        }
+        if (entry->element < element ||
+            (entry->element == element && entry->mass_number < mass_number)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return mass_number;
+}
@@ -0,0 +1,55 @@
+#ifndef ELEMENTS_H
+#define ELEMENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ELEMENT_COUNT 119
+
+// Symbols indexed by atomic number, index 0 is the '*' wildcard atom.
+extern const char atomic_symbols[ELEMENT_COUNT][3];
+
+// Two-letter lookup table: numbers[first][0] is the atomic number of the
+// single letter symbol, numbers[first][1 + second] the one of the two letter
+// symbol, 0 when there is no such symbol. Letters are relative to base.
+typedef struct symbol_table {
+    char base;
+    uint8_t numbers[26][27];
+} symbol_table;
+
+// Element may be written with an aromatic symbol.
+#define ELEMENT_AROMATIC 1
+
+// Properties of an element, indexed by atomic number like atomic_symbols.
+// Elements without stable isotopes use their longest lived one for both
+// masses.
+typedef struct element_properties {
+    double average_mass;  // standard atomic weight
+    double exact_mass;    // mass of the most abundant isotope
+    uint16_t mass_number; // of the most abundant isotope
+    uint8_t group;        // 0 for the lanthanides and actinides after La and Ac
+    uint8_t flags;
+    uint8_t valences[3]; // default valences in increasing order, 0 terminated
+} element_properties;
+
+extern const element_properties element_table[ELEMENT_COUNT];
+
+extern const symbol_table element_symbols_table;
+extern const symbol_table aliphatic_organic_table;
+extern const symbol_table aromatic_symbols_table;
+
+// Longest symbol of the table at the start of str (two letters before one).
+// Returns its atomic number and stores its length in len, or returns 0.
+int lookup_symbol(const symbol_table *table, const char *str, size_t str_len, size_t *len);
+
+// Lowest default valence of the element at least bonds once shifted by the
+// charge, as for the isoelectronic element ([N+] like C, [B-] like C, [C+]
+// like B). Returns -1 for elements without default valences or when bonds
+// exceeds them all.
+int default_valence(int element, int charge, int bonds);
+
+// Exact mass of an isotope. Isotopes missing from the table of the usual
+// labels fall back to their mass number.
+double isotope_mass(int element, int mass_number);
+
+#endif // ELEMENTS_H
@@ -0,0 +1,125 @@
+#include "parser/formula.h"
+#include "parser/elements.h"
+#include "parser/text.h"
+
+// Atoms of one element and isotope.
+typedef struct isotope_count {
+    int element;
+    int isotope;
+    long count;
+} isotope_count;
+
+int compare_isotopes(const void *a, const void *b) {
+    const isotope_count *x = a, *y = b;
+    if (x->element != y->element) {
+        return x->element - y->element;
+    }
+    return x->isotope - y->isotope;
+}
+
+// Writes an element of the formula, its plain atoms then its isotopes.
+char *append_element(char *out, int element, const long *counts, const isotope_count *isotopes,
+                     const int *isotope_offsets) {
+    if (counts[element] > 0) {
+        out = write_string(out, atomic_symbols[element]);
+        if (counts[element] > 1) {
+            out = write_long(out, counts[element]);
+        }
+    }
+    for (int i = isotope_offsets[element]; i < isotope_offsets[element + 1]; i++) {
+        *out++ = '[';
+        out = write_long(out, isotopes[i].isotope);
+        out = write_string(out, atomic_symbols[element]);
+        out = write_string(out, "]");
+        if (isotopes[i].count > 1) {
+            out = write_long(out, isotopes[i].count);
+        }
+    }
+    return out;
+}
+
+molecular_formula compute_formula(parser_ctx *ctx, const graph *g) {
+    long counts[ELEMENT_COUNT] = {0};
+    int isotope_offsets[ELEMENT_COUNT + 1] = {0};
+    isotope_count *isotopes = malloc(sizeof(isotope_count) * (g->atoms_len + 1));
+    if (!isotopes) {
+        error(ctx, "Out of memory");
+        return (molecular_formula){0};
+    }
+    size_t isotopes_len = 0;
+    long charge = 0;
+    double exact_mass = 0, average_mass = 0;
+    for (size_t i = 0; i < g->atoms_len; i++) {
+        const Atom *a = &g->atoms[i];
+        counts[1] += a->implicit_hydrogens + (a->hydrogens > 0 ? a->hydrogens : 0);
+        charge += a->charge;
+        if (a->element == 0) {
+            continue;
+        }
+        if (a->isotope > 0) {
+            double mass = isotope_mass(a->element, a->isotope);
+            exact_mass += mass;
+            average_mass += mass;
+            isotopes[isotopes_len++] = (isotope_count){a->element, a->isotope, 1};
+        } else {
+            counts[(int)a->element]++;
+        }
+    }
+    for (int element = 1; element < ELEMENT_COUNT; element++) {
+        exact_mass += counts[element] * element_table[element].exact_mass;
+        average_mass += counts[element] * element_table[element].average_mass;
+    }
+
+    // merge the atoms of the same isotope, then index them by element
+    qsort(isotopes, isotopes_len, sizeof(isotope_count), compare_isotopes);
+    size_t len = 0;
+    for (size_t i = 0; i < isotopes_len; i++) {
+        if (len > 0 && compare_isotopes(&isotopes[len - 1], &isotopes[i]) == 0) {
+            isotopes[len - 1].count++;
+        } else {
+            isotopes[len++] = isotopes[i];
+            isotope_offsets[isotopes[i].element + 1]++;
+        }
+    }
+    for (int element = 1; element <= ELEMENT_COUNT; element++) {
+        isotope_offsets[element] += isotope_offsets[element - 1];
+    }
+
+    // at most a bracketed isotope, a symbol and a count per entry
+    char *formula = arena_alloc(&ctx->arena, (ELEMENT_COUNT + len + 1) * 40);
+    if (!formula) {
+        free(isotopes);
+        error(ctx, "Out of memory");
+        return (molecular_formula){0};
+    }
+    char *out = formula;
+    *out = '\0';
+    bool carbon = counts[6] > 0 || isotope_offsets[6] < isotope_offsets[7];
+    if (carbon) {
+        out = append_element(out, 6, counts, isotopes, isotope_offsets);
+        out = append_element(out, 1, counts, isotopes, isotope_offsets);
+    }
+    // the symbol table is laid out in alphabetical order
+    for (int first = 0; first < 26; first++) {
+        for (int second = 0; second < 27; second++) {
+            int element = element_symbols_table.numbers[first][second];
+            if (element > 0 && !(carbon && (element == 6 || element == 1))) {
+                out = append_element(out, element, counts, isotopes, isotope_offsets);
+            }
+        }
+    }
+    if (charge != 0) {
+        long magnitude = charge < 0 ? -charge : charge;
+        if (magnitude > 1) {
+            out = write_long(out, magnitude);
+        }
+        write_string(out, charge < 0 ? "-" : "+");
+    }
+    free(isotopes);
+
+    return (molecular_formula){
+        .formula = formula,
+        .exact_mass = exact_mass,
+        .average_mass = average_mass,
+    };
+}
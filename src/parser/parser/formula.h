@@ -0,0 +1,18 @@
+#ifndef FORMULA_H
+#define FORMULA_H
+
+#include "ast/protocol.h"
+#include "parser/parser.h"
+
+// Hill formula of the graph, C then H then the other elements in
+// alphabetical order, or all of them in alphabetical order without carbon.
+// Atoms with an isotope follow their element as [13C] and the net charge
+// ends the formula, as in C2H3O2-. Wildcard atoms are left out.
+//
+// The masses are those of the neutral atoms, implicit and explicit
+// hydrogens included, isotopes counting with their own mass. The formula is
+// allocated in the arena of the context. Out of memory, ctx is errored and
+// the result empty.
+molecular_formula compute_formula(parser_ctx *ctx, const graph *g);
+
+#endif // FORMULA_H
@@ -0,0 +1,231 @@
+#include "parser/graph.h"
+#include "parser/elements.h"
+#include "parser/text.h"
+#include "parser/valence.h"
+#include <limits.h>
+
+// Ring bond waiting for the matching label.
+typedef struct ring_slot {
+    int atom; // -1 when the label is free
+    int from;
+    char symbol;
+    int half; // entry of half_bonds waiting for the bond
+} ring_slot;
+
+typedef struct graph_builder {
+    parser_ctx *ctx;
+    graph graph;
+    ring_slot rings[RING_BOND_COUNT];
+    // Bond ends in the order the SMILES writes them, 2 * bond for the begin
+    // atom and 2 * bond + 1 for the end atom.
+    int *half_bonds;
+    size_t half_bonds_len;
+} graph_builder;
+
+// Reports an error of ring bond n at the given position of the input, the
+// message being "Ring bond <n>" followed by problem.
+void ring_error(graph_builder *b, int pos, int n, const char *problem) {
+    char message[64];
+    char *out = write_string(message, "Ring bond ");
+    out = write_long(out, n);
+    write_string(out, problem);
+    b->ctx->buffer_pos = pos;
+    error(b->ctx, message);
+}
+
+// Order of a bond symbol. Aromatic and directional bonds count as single.
+int bond_order(char symbol) {
+    switch (symbol) {
+        case '=':
+            return 2;
+        case '#':
+            return 3;
+        case '$':
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+void add_bond(graph_builder *b, int begin, int end, char symbol) {
+    graph *g = &b->graph;
+    bool aromatic = symbol == ':' ||
+                    (symbol == '\0' && g->atoms[begin].aromatic && g->atoms[end].aromatic);
+    g->bonds[g->bonds_len++] = (Bond){
+        .begin = begin,
+        .end = end,
+        .order = bond_order(symbol),
+        .aromatic = aromatic,
+        .symbol = symbol,
+    };
+}
+
+void push_half_bond(graph_builder *b, int half) {
+    b->half_bonds[b->half_bonds_len++] = half;
+}
+
+// Both ends of a ring bond may carry a symbol, they have to agree on the
+// bond. '/' and '\' only give the direction as seen from their own atom.
+bool same_bond(char a, char b) {
+    return !a || !b || (bond_order(a) == bond_order(b) && (a == ':') == (b == ':'));
+}
+
+// Opens or closes a ring bond of atom. The bonds from first_bond on are the
+// ones of atom, a ring bond to one of their atoms would be a second bond.
+void ring_bond(graph_builder *b, int atom, size_t first_bond, const BondRecord *ringbond) {
+    int n = ringbond->ring;
+    char symbol = ringbond->symbol;
+    ring_slot *slot = &b->rings[n];
+    if (slot->atom < 0) {
+        *slot = (ring_slot){
+            .atom = atom,
+            .from = ringbond->from,
+            .symbol = symbol,
+            .half = b->half_bonds_len,
+        };
+        // the opening atom writes the bond here, it is only known once closed
+        push_half_bond(b, -1);
+        return;
+    }
+    if (slot->atom == atom) {
+        ring_error(b, ringbond->from, n, " closes on its own atom");
+        return;
+    }
+    if (!same_bond(slot->symbol, symbol)) {
+        char problem[32];
+        char *out = write_string(problem, " has conflicting bonds ");
+        *out++ = slot->symbol;
+        out = write_string(out, " and ");
+        *out++ = symbol;
+        *out = '\0';
+        ring_error(b, ringbond->from, n, problem);
+        return;
+    }
+    const graph *g = &b->graph;
+    for (size_t i = first_bond; i < g->bonds_len; i++) {
+        if (g->bonds[i].begin == slot->atom || g->bonds[i].end == slot->atom) {
+            ring_error(b, ringbond->from, n, " duplicates an existing bond");
+            return;
+        }
+    }
+    add_bond(b, slot->atom, atom, slot->symbol ? slot->symbol : symbol);
+    int bond = g->bonds_len - 1;
+    b->half_bonds[slot->half] = 2 * bond;
+    push_half_bond(b, 2 * bond + 1);
+    slot->atom = -1;
+}
+
+bool check_rings_closed(graph_builder *b) {
+    const ring_slot *open = NULL;
+    for (int i = 0; i < RING_BOND_COUNT; i++) {
+        if (b->rings[i].atom >= 0 && (!open || b->rings[i].from < open->from)) {
+            open = &b->rings[i];
+        }
+    }
+    if (open) {
+        ring_error(b, open->from, open - b->rings, " is never closed");
+    }
+    return !open;
+}
+
+// Lays the neighbours of every atom out contiguously, in the order the SMILES
+// writes them.
+void build_adjacency(graph_builder *b) {
+    graph *g = &b->graph;
+    size_t n = g->atoms_len;
+    g->adjacency_offsets_len = n + 1;
+    g->adjacency_offsets = arena_alloc(&b->ctx->arena, sizeof(int) * (n + 1));
+    g->adjacency_len = g->adjacency_bonds_len = 2 * g->bonds_len;
+    g->adjacency = arena_alloc(&b->ctx->arena, sizeof(int) * g->adjacency_len);
+    g->adjacency_bonds = arena_alloc(&b->ctx->arena, sizeof(int) * g->adjacency_len);
+
+    int *offsets = g->adjacency_offsets;
+    memset(offsets, 0, sizeof(int) * (n + 1));
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        offsets[g->bonds[i].begin + 1]++;
+        offsets[g->bonds[i].end + 1]++;
+    }
+    for (size_t i = 1; i <= n; i++) {
+        offsets[i] += offsets[i - 1];
+    }
+    // offsets[i] is used as the insertion point of atom i, which leaves it
+    // at the start of atom i + 1 once all bonds are placed
+    for (size_t i = 0; i < b->half_bonds_len; i++) {
+        int bond = b->half_bonds[i] / 2;
+        int atom = b->half_bonds[i] % 2 ? g->bonds[bond].end : g->bonds[bond].begin;
+        int other = b->half_bonds[i] % 2 ? g->bonds[bond].begin : g->bonds[bond].end;
+        g->adjacency[offsets[atom]] = other;
+        g->adjacency_bonds[offsets[atom]++] = bond;
+    }
+    for (size_t i = n; i > 0; i--) {
+        offsets[i] = offsets[i - 1];
+    }
+    offsets[0] = 0;
+}
+
+// Typed fields of an atom record, the graph adds hydrogens and coordinates.
+Atom graph_atom(const AtomRecord *record) {
+    return (Atom){
+        .element = record->element,
+        .aromatic = record->aromatic,
+        .chirality = record->chirality,
+        .isotope = record->isotope,
+        .charge = record->charge,
+        .hydrogens = record->hydrogens,
+        .atom_class = record->atom_class,
+        .from = record->from,
+        .to = record->to,
+    };
+}
+
+graph build_graph(parser_ctx *ctx, const records *r) {
+    graph_builder b = {.ctx = ctx};
+    for (int i = 0; i < RING_BOND_COUNT; i++) {
+        b.rings[i].atom = -1;
+    }
+    graph *g = &b.graph;
+    g->atoms = arena_alloc(&ctx->arena, sizeof(Atom) * (r->atoms_len + 1));
+    // every record gives at most one bond and two of its ends
+    g->bonds = arena_alloc(&ctx->arena, sizeof(Bond) * (r->bonds_len + 1));
+    b.half_bonds = arena_alloc(&ctx->arena, sizeof(int) * (2 * r->bonds_len + 1));
+    if (!g->atoms || !g->bonds || !b.half_bonds) {
+        error(ctx, "Out of memory");
+        return (graph){0};
+    }
+    for (size_t i = 0; i < r->atoms_len; i++) {
+        const AtomRecord *record = &r->atoms[i];
+        if (record->isotope < 0 || record->atom_class < 0) {
+            ctx->buffer_pos = record->from;
+            error(ctx, record->isotope < 0 ? "Isotope too large" : "Atom class too large");
+            return (graph){0};
+        }
+        g->atoms[i] = graph_atom(record);
+    }
+    g->atoms_len = r->atoms_len;
+
+    // bonds of the atom read last start at first_bond, the records of an
+    // atom coming right after it is read
+    int last_atom = -1;
+    size_t first_bond = 0;
+    for (size_t i = 0; i < r->bonds_len && !ctx->errored; i++) {
+        const BondRecord *record = &r->bonds[i];
+        int atom = record->ring >= 0 ? record->begin : record->end;
+        if (atom > last_atom) {
+            last_atom = atom;
+            first_bond = g->bonds_len;
+        }
+        if (record->ring >= 0) {
+            ring_bond(&b, atom, first_bond, record);
+            continue;
+        }
+        add_bond(&b, record->begin, record->end, record->symbol);
+        push_half_bond(&b, 2 * (g->bonds_len - 1));
+        push_half_bond(&b, 2 * (g->bonds_len - 1) + 1);
+    }
+    if (ctx->errored || !check_rings_closed(&b)) {
+        return (graph){0};
+    }
+    build_adjacency(&b);
+    add_implicit_hydrogens(&b.graph);
+    return b.graph;
+}
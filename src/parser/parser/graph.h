@@ -0,0 +1,26 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "ast/protocol.h"
+#include "parser/parser.h"
+
+// Number of ring bond labels, 0 to 9 and %10 to %99.
+#define RING_BOND_COUNT 100
+
+// Builds the molecular graph of the records returned by parse_records().
+// Atoms are numbered in input order and bonds follow chains, branches and
+// paired ring bonds. Bonds without a symbol are single, or aromatic between
+// two aromatic atoms. adjacency_offsets[i] to adjacency_offsets[i + 1] index
+// the neighbours of atom i in adjacency and the matching bonds in
+// adjacency_bonds, in the order the SMILES writes them (previous atom, ring
+// bonds, branches then next atom), which is the order chirality refers to.
+// Atoms of the organic subset get their implicit hydrogens, see
+// add_implicit_hydrogens(). Everything is allocated in the arena of the
+// context.
+//
+// On failure ctx->errored is set and the position is moved to the
+// offending ring bond, or atom for an isotope or class too large for an
+// int, as for a parse error.
+graph build_graph(parser_ctx *ctx, const records *r);
+
+#endif // GRAPH_H
@@ -0,0 +1,256 @@
+#include "parser/kekule.h"
+#include "parser/rings.h"
+#include "parser/valence.h"
+
+// Matching state over the atoms needing a double bond, renumbered from 0.
+// The search of an augmenting path only resets the vertices it reaches,
+// recorded in touched, so that each search costs what it explores.
+typedef struct matching {
+    int *offsets;
+    int *edges;
+    int *edge_bonds;
+    int *mate;
+
+    int *base;
+    int *parent;
+    bool *used;
+    int *seen;
+    int *marks;
+    int *blossoms;
+    int *queue;
+    int *touched;
+    size_t touched_len;
+    int stamp;
+    int mark_stamp;
+    int blossom_stamp;
+} matching;
+
+void touch(matching *m, int v) {
+    if (m->seen[v] == m->stamp) {
+        return;
+    }
+    m->seen[v] = m->stamp;
+    m->base[v] = v;
+    m->parent[v] = -1;
+    m->used[v] = false;
+    m->touched[m->touched_len++] = v;
+}
+
+// Lowest common ancestor of a and b in the alternating tree.
+int common_base(matching *m, int a, int b) {
+    m->mark_stamp++;
+    for (;;) {
+        a = m->base[a];
+        m->marks[a] = m->mark_stamp;
+        if (m->mate[a] < 0) {
+            break;
+        }
+        a = m->parent[m->mate[a]];
+    }
+    for (;;) {
+        b = m->base[b];
+        if (m->marks[b] == m->mark_stamp) {
+            return b;
+        }
+        b = m->parent[m->mate[b]];
+    }
+}
+
+void mark_blossom(matching *m, int v, int base, int child) {
+    while (m->base[v] != base) {
+        m->blossoms[m->base[v]] = m->blossoms[m->base[m->mate[v]]] = m->blossom_stamp;
+        m->parent[v] = child;
+        child = m->mate[v];
+        v = m->parent[m->mate[v]];
+    }
+}
+
+// Breadth first search of an augmenting path from the unmatched vertex
+// root, contracting odd cycles as they are met. Returns the free vertex the
+// path ends on, or -1.
+int find_augmenting_path(matching *m, int root) {
+    m->stamp++;
+    m->touched_len = 0;
+    touch(m, root);
+    m->used[root] = true;
+    size_t head = 0, tail = 0;
+    m->queue[tail++] = root;
+    while (head < tail) {
+        int v = m->queue[head++];
+        for (int k = m->offsets[v]; k < m->offsets[v + 1]; k++) {
+            int to = m->edges[k];
+            touch(m, to);
+            if (m->mate[to] >= 0) {
+                touch(m, m->mate[to]);
+            }
+            if (m->base[v] == m->base[to] || m->mate[v] == to) {
+                continue;
+            }
+            if (to == root || (m->mate[to] >= 0 && m->parent[m->mate[to]] >= 0)) {
+                int base = common_base(m, v, to);
+                m->blossom_stamp++;
+                mark_blossom(m, v, base, to);
+                mark_blossom(m, to, base, v);
+                for (size_t i = 0; i < m->touched_len; i++) {
+                    int u = m->touched[i];
+                    if (m->blossoms[m->base[u]] == m->blossom_stamp) {
+                        m->base[u] = base;
+                        if (!m->used[u]) {
+                            m->used[u] = true;
+                            m->queue[tail++] = u;
+                        }
+                    }
+                }
+            } else if (m->parent[to] < 0) {
+                m->parent[to] = v;
+                if (m->mate[to] < 0) {
+                    return to;
+                }
+                m->used[m->mate[to]] = true;
+                m->queue[tail++] = m->mate[to];
+            }
+        }
+    }
+    return -1;
+}
+
+void free_matching(matching *m) {
+    free(m->offsets);
+    free(m->edges);
+    free(m->edge_bonds);
+    free(m->mate);
+    free(m->base);
+    free(m->parent);
+    free(m->used);
+    free(m->seen);
+    free(m->marks);
+    free(m->blossoms);
+    free(m->queue);
+    free(m->touched);
+}
+
+int kekulize_bonds(parser_ctx *ctx, graph *g) {
+    size_t n = g->atoms_len;
+    bool *ring_bonds = find_ring_bonds(ctx, g);
+    int *index = malloc(sizeof(int) * (n + 1));
+    int *atoms = malloc(sizeof(int) * (n + 1));
+    matching m = {0};
+    bool ok = ring_bonds && index && atoms;
+    size_t len = 0;
+    for (size_t i = 0; ok && i < n; i++) {
+        index[i] = -1;
+        if (needs_double_bond(g, i)) {
+            index[i] = len;
+            atoms[len++] = i;
+        }
+    }
+    if (ok) {
+        m.offsets = calloc(len + 2, sizeof(int));
+        m.edges = malloc(sizeof(int) * (2 * g->bonds_len + 1));
+        m.edge_bonds = malloc(sizeof(int) * (2 * g->bonds_len + 1));
+        m.mate = malloc(sizeof(int) * (len + 1));
+        m.base = malloc(sizeof(int) * (len + 1));
+        m.parent = malloc(sizeof(int) * (len + 1));
+        m.used = malloc(sizeof(bool) * (len + 1));
+        m.seen = calloc(len + 1, sizeof(int));
+        m.marks = calloc(len + 1, sizeof(int));
+        m.blossoms = calloc(len + 1, sizeof(int));
+        m.queue = malloc(sizeof(int) * (len + 1));
+        m.touched = malloc(sizeof(int) * (len + 1));
+        ok = m.offsets && m.edges && m.edge_bonds && m.mate && m.base && m.parent && m.used &&
+             m.seen && m.marks && m.blossoms && m.queue && m.touched;
+    }
+    if (!ok) {
+        // find_ring_bonds() has already said so when it failed
+        if (!ctx->errored) {
+            error(ctx, "Out of memory");
+        }
+        free(index);
+        free(atoms);
+        free_matching(&m);
+        return -1;
+    }
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        if (g->bonds[i].aromatic) {
+            g->bonds[i].order = 1;
+        }
+    }
+
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        const Bond *bond = &g->bonds[i];
+        if (bond->aromatic && ring_bonds[i] && index[bond->begin] >= 0 && index[bond->end] >= 0) {
+            m.offsets[index[bond->begin] + 2]++;
+            m.offsets[index[bond->end] + 2]++;
+        }
+    }
+    for (size_t i = 2; i < len + 2; i++) {
+        m.offsets[i] += m.offsets[i - 1];
+    }
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        const Bond *bond = &g->bonds[i];
+        if (bond->aromatic && ring_bonds[i] && index[bond->begin] >= 0 && index[bond->end] >= 0) {
+            int a = index[bond->begin], b = index[bond->end];
+            m.edge_bonds[m.offsets[a + 1]] = i;
+            m.edges[m.offsets[a + 1]++] = b;
+            m.edge_bonds[m.offsets[b + 1]] = i;
+            m.edges[m.offsets[b + 1]++] = a;
+        }
+    }
+
+    // a greedy pass matches most atoms, the rest are reached by augmenting
+    for (size_t v = 0; v < len; v++) {
+        m.mate[v] = -1;
+    }
+    for (size_t v = 0; v < len; v++) {
+        for (int k = m.offsets[v]; k < m.offsets[v + 1] && m.mate[v] < 0; k++) {
+            if (m.mate[m.edges[k]] < 0) {
+                m.mate[v] = m.edges[k];
+                m.mate[m.edges[k]] = v;
+            }
+        }
+    }
+    int unmatched = -1;
+    for (size_t v = 0; v < len; v++) {
+        if (m.mate[v] >= 0) {
+            continue;
+        }
+        int end = find_augmenting_path(&m, v);
+        if (end < 0) {
+            if (unmatched < 0) {
+                unmatched = v;
+            }
+            continue;
+        }
+        while (end >= 0) {
+            int parent = m.parent[end];
+            int next = m.mate[parent];
+            m.mate[end] = parent;
+            m.mate[parent] = end;
+            end = next;
+        }
+    }
+
+    for (size_t v = 0; v < len; v++) {
+        for (int k = m.offsets[v]; k < m.offsets[v + 1]; k++) {
+            if (m.edges[k] == m.mate[v]) {
+                g->bonds[m.edge_bonds[k]].order = 2;
+            }
+        }
+    }
+    if (unmatched >= 0) {
+        unmatched = atoms[unmatched];
+    }
+
+    free(index);
+    free(atoms);
+    free_matching(&m);
+    return unmatched;
+}
+
+void kekulize_graph(parser_ctx *ctx, graph *g) {
+    int unmatched = kekulize_bonds(ctx, g);
+    if (unmatched >= 0) {
+        ctx->buffer_pos = g->atoms[unmatched].from;
+        error(ctx, "Aromatic atom cannot be given a double bond");
+    }
+}
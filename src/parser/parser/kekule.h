@@ -0,0 +1,23 @@
+#ifndef KEKULE_H
+#define KEKULE_H
+
+#include "parser/graph.h"
+
+// Gives every aromatic bond of the graph an explicit order of 1 or 2, each
+// aromatic atom left with a free valence getting exactly one double bond.
+// Aromatic bonds outside rings stay single. The bonds keep their aromatic
+// flag.
+//
+// The double bonds are a perfect matching of those atoms over the aromatic
+// ring bonds, found greedily then completed with augmenting paths (Edmonds'
+// blossoms, as five membered rings make the graph non bipartite). On
+// failure ctx->errored is set and the position is moved to an atom left
+// without a double bond. Out of memory, ctx->errored is set as well and the
+// bonds are left as they were.
+void kekulize_graph(parser_ctx *ctx, graph *g);
+
+// Same as kekulize_graph() without the error, returning the atom left
+// without a double bond or -1. Out of memory, ctx->errored is still set.
+int kekulize_bonds(parser_ctx *ctx, graph *g);
+
+#endif // KEKULE_H
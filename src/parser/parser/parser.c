@@ -1,17 +1,24 @@
 #include "parser/parser.h"
-#include <stdarg.h>
-#include <stdio.h>
+#include "parser/elements.h"
+#include <limits.h>
 
 parser_ctx init_ctx(char *buffer, size_t len) {
     parser_ctx ctx = {.buffer = buffer,
                       .buffer_len = len,
                       .buffer_pos = 0,
                       .errored = false,
-                      .error = NULL,
-                      .no_error_message = 0};
+                      .error = {0},
+                      .message = NULL,
+                      .arena = {0}};
     return ctx;
 }
 
+void free_ctx(parser_ctx *ctx) {
+    arena_free(&ctx->arena);
+    free(ctx->message);
+    ctx->message = NULL;
+}
+
 size_t save_pos(parser_ctx *ctx) {
     return ctx->buffer_pos;
 }
@@ -40,46 +47,203 @@ char peek(parser_ctx *ctx) {
     return ctx->buffer[ctx->buffer_pos];
 }
 
-ASTElement new_ASTElement(int type, size_t nb_children, int from) {
+// Character classes used to pick a production from the next character(s)
+// without trying the alternatives one after the other.
+typedef enum char_class {
+    CC_DIGIT = 1 << 0,
+    CC_BOND = 1 << 1,
+    CC_ALIPHATIC = 1 << 2,
+    CC_AROMATIC = 1 << 3,
+    CC_AROMATIC_SYMBOL = 1 << 4,
+    CC_STAR = 1 << 5,
+    CC_BRACKET = 1 << 6,
+    CC_TERMINATOR = 1 << 7,
+} char_class;
+
+#define CC_ATOM (CC_ALIPHATIC | CC_AROMATIC | CC_STAR | CC_BRACKET)
+
+static const uint8_t char_classes[256] = {
+    ['0' ... '9'] = CC_DIGIT,
+    ['-'] = CC_BOND,
+    ['='] = CC_BOND,
+    ['#'] = CC_BOND,
+    ['$'] = CC_BOND,
+    [':'] = CC_BOND,
+    ['/'] = CC_BOND,
+    ['\\'] = CC_BOND,
+    ['B'] = CC_ALIPHATIC,
+    ['C'] = CC_ALIPHATIC,
+    ['N'] = CC_ALIPHATIC,
+    ['O'] = CC_ALIPHATIC,
+    ['P'] = CC_ALIPHATIC,
+    ['S'] = CC_ALIPHATIC,
+    ['F'] = CC_ALIPHATIC,
+    ['I'] = CC_ALIPHATIC,
+    ['a'] = CC_AROMATIC_SYMBOL,
+    ['b'] = CC_AROMATIC | CC_AROMATIC_SYMBOL,
+    ['c'] = CC_AROMATIC | CC_AROMATIC_SYMBOL,
+    ['n'] = CC_AROMATIC | CC_AROMATIC_SYMBOL,
+    ['o'] = CC_AROMATIC | CC_AROMATIC_SYMBOL,
+    ['s'] = CC_AROMATIC | CC_AROMATIC_SYMBOL,
+    ['p'] = CC_AROMATIC | CC_AROMATIC_SYMBOL,
+    ['*'] = CC_STAR,
+    ['['] = CC_BRACKET,
+    [' '] = CC_TERMINATOR,
+    ['\t'] = CC_TERMINATOR,
+    ['\r'] = CC_TERMINATOR,
+    ['\n'] = CC_TERMINATOR,
+    ['\0'] = CC_TERMINATOR,
+};
+
+// Character at offset from the current position, '\0' past the end. Unlike
+// peek, looking past the end is not an error.
+char lookahead(const parser_ctx *ctx, size_t offset) {
+    size_t pos = ctx->buffer_pos + offset;
+    return pos < ctx->buffer_len ? ctx->buffer[pos] : '\0';
+}
+
+uint8_t char_class_at(const parser_ctx *ctx, size_t offset) {
+    return char_classes[(uint8_t)lookahead(ctx, offset)];
+}
+
+ASTElement new_ASTElement(parser_ctx *ctx, int type, size_t nb_children, int from) {
+    ASTElement *children =
+        nb_children == 0 ? NULL : arena_alloc(&ctx->arena, sizeof(ASTElement) * nb_children);
     return (ASTElement){.type = type,
                         .from = from,
                         .to = from + 1,
                         .value = NULL,
-                        .children =
-                            nb_children == 0 ? NULL : malloc(sizeof(ASTElement) * nb_children),
+                        .children = children,
                         .children_len = 0};
 }
 
-void error(parser_ctx *ctx, char *fmt, ...) {
+void fail(parser_ctx *ctx, smiles_error code, uint8_t expected, char expected_char) {
     ctx->errored = true;
-    if (ctx->error != NULL) {
-        free(ctx->error);
+    ctx->error = (parse_error){.code = code,
+                               .expected = expected,
+                               .expected_char = expected_char,
+                               .got = lookahead(ctx, 0),
+                               .position = ctx->buffer_pos};
+}
+
+void error(parser_ctx *ctx, const char *message) {
+    fail(ctx, SMILES_MESSAGE, 0, '\0');
+    free(ctx->message);
+    ctx->message = malloc(strlen(message) + 1);
+    if (ctx->message) {
+        strcpy(ctx->message, message);
     }
-    if (ctx->no_error_message > 0) {
-        ctx->error = NULL;
-        return;
+}
+
+void clear_error(parser_ctx *ctx) {
+    ctx->errored = false;
+    ctx->error.code = SMILES_VALID;
+}
+
+// Names of the alternatives of an expected set, in the order of its bits.
+static const char *expected_names[] = {
+    NULL, "an element symbol", "a number", "a digit", "a bond", "a sign (- or +)",
+};
+
+char *error_message(const parser_ctx *ctx) {
+    const parse_error *e = &ctx->error;
+    const char *text = NULL;
+    switch (e->code) {
+        case SMILES_VALID:
+            return NULL;
+        case SMILES_EXPECTED_ATOM:
+            text = "Expected an atom";
+            break;
+        case SMILES_EXPECTED_END:
+            text = "Expected end of expression";
+            break;
+        case SMILES_MESSAGE:
+            // NULL when there was no memory for it
+            text = ctx->message;
+            if (!text) {
+                return NULL;
+            }
+            break;
+        case SMILES_EXPECTED:
+            break;
+    }
+    if (text != NULL) {
+        char *message = malloc(strlen(text) + 1);
+        if (message) {
+            strcpy(message, text);
+        }
+        return message;
+    }
+    // "Expected a or b, got c", the character found ending the text when it
+    // is the end of the input
+    size_t len = sizeof("Expected , got c");
+    for (size_t i = 0; i < sizeof(expected_names) / sizeof(expected_names[0]); i++) {
+        if (e->expected & (1 << i)) {
+            len += (i == 0 ? 1 : strlen(expected_names[i])) + sizeof(" or ");
+        }
+    }
+    char *message = malloc(len);
+    if (!message) {
+        return NULL;
     }
-    va_list args;
-    va_start(args, fmt);
-    int size = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-    if (size < 0) {
-        ctx->error = NULL;
+    strcpy(message, "Expected ");
+    bool first = true;
+    for (size_t i = 0; i < sizeof(expected_names) / sizeof(expected_names[0]); i++) {
+        if (!(e->expected & (1 << i))) {
+            continue;
+        }
+        if (!first) {
+            strcat(message, " or ");
+        }
+        first = false;
+        if (i == 0) {
+            strncat(message, &e->expected_char, 1);
+        } else {
+            strcat(message, expected_names[i]);
+        }
     }
-    ctx->error = malloc(sizeof(char) * size + 1);
-    va_start(args, fmt);
-    if (vsprintf(ctx->error, fmt, args) < 0) {
-        free(ctx->error);
-        ctx->error = NULL;
+    strcat(message, ", got ");
+    strncat(message, &e->got, 1);
+    return message;
+}
+
+// One character strings for every byte, shared by the values of one
+// character instead of copies.
+#define ONE_CHAR(c) {(char)(c), '\0'}
+#define ONE_CHAR_4(c) ONE_CHAR(c), ONE_CHAR((c) + 1), ONE_CHAR((c) + 2), ONE_CHAR((c) + 3)
+#define ONE_CHAR_16(c)                                                                             \
+    ONE_CHAR_4(c), ONE_CHAR_4((c) + 4), ONE_CHAR_4((c) + 8), ONE_CHAR_4((c) + 12)
+#define ONE_CHAR_64(c)                                                                             \
+    ONE_CHAR_16(c), ONE_CHAR_16((c) + 16), ONE_CHAR_16((c) + 32), ONE_CHAR_16((c) + 48)
+
+static const char one_char_values[256][2] = {ONE_CHAR_64(0), ONE_CHAR_64(64), ONE_CHAR_64(128),
+                                             ONE_CHAR_64(192)};
+
+// Value of an element spanning len characters of the input. Nearly every
+// value is a single character and shares a constant string, only longer
+// numbers and chirality classes are copied. Values are never written to.
+char *span_value(parser_ctx *ctx, const char *str, size_t len) {
+    if (len == 1) {
+        return (char *)one_char_values[(uint8_t)str[0]];
     }
-    va_end(args);
+    return arena_strndup(&ctx->arena, str, len);
 }
 
 bool is_invalid(const ASTElement *elem) {
     return elem->type == -1;
 }
 
-#define INVALID_ELEMENT new_ASTElement(-1, 0, 0);
+void push_child(parser_ctx *ctx, ASTElement *elem, size_t *capacity, ASTElement child) {
+    if (elem->children_len == *capacity) {
+        elem->children =
+            arena_realloc(&ctx->arena, elem->children, sizeof(ASTElement) * *capacity,
+                          sizeof(ASTElement) * *capacity * 2);
+        *capacity *= 2;
+    }
+    elem->children[elem->children_len++] = child;
+}
+
+#define INVALID_ELEMENT new_ASTElement(ctx, -1, 0, 0)
 
 #define RETURN_ELEMENT(elem, ctx)                                                                  \
     elem.to = ctx->buffer_pos - 1;                                                                 \
@@ -87,156 +251,184 @@ bool is_invalid(const ASTElement *elem) {
 
 #define EXPECT_CHAR(char_, ctx, elem)                                                              \
     if (peek(ctx) != char_) {                                                                      \
-        free_ASTElement(&elem);                                                                    \
-        error(ctx, "Expected %c, got %c", char_, peek(ctx));                                       \
+        fail(ctx, SMILES_EXPECTED, EXPECTED_CHAR, char_);                                          \
         return INVALID_ELEMENT;                                                                    \
     }                                                                                              \
     next(ctx);
 
 #define CHECK_CTX(ctx, elem)                                                                       \
     if (ctx->errored) {                                                                            \
-        free_ASTElement(&elem);                                                                    \
         return INVALID_ELEMENT;                                                                    \
     }
 
-bool start_by(parser_ctx *ctx, const char *str) {
-    size_t i = 0;
-    size_t pos = save_pos(ctx);
-    while (!is_eof(ctx) && str[i] != '\0') {
-        if (next(ctx) != str[i]) {
-            restore_pos(ctx, pos);
-            return false;
-        }
-        i++;
+#ifdef PARSER_STATS
+const char *parser_rule_names[RULE_COUNT] = {
+    "aliphatic_organic", "aromatic_organic", "element_symbol", "aromatic_symbol", "char",
+    "number",            "digit",            "option",         "bond",            "symbol",
+    "chiral",            "hcount",           "charge",         "class",           "bracket_atom",
+    "atom",              "ringbond",         "branched_atom",  "branch",          "chain",
+    "terminator",        "smiles",
+};
+
+typedef struct rule_frame {
+    size_t allocations;
+    size_t counted_allocations;
+} rule_frame;
+
+rule_frame stats_enter(parser_ctx *ctx, parser_rule rule) {
+    parser_stats *stats = &ctx->stats;
+    stats->rules[rule].calls++;
+    if (++stats->depth > stats->max_depth) {
+        stats->max_depth = stats->depth;
     }
-    return true;
+    return (rule_frame){ctx->arena.allocations, stats->counted_allocations};
+}
+
+void stats_exit(parser_ctx *ctx, parser_rule rule, rule_frame frame) {
+    parser_stats *stats = &ctx->stats;
+    // allocations of the rules called in between are already counted
+    size_t own = ctx->arena.allocations - frame.allocations -
+                 (stats->counted_allocations - frame.counted_allocations);
+    stats->rules[rule].allocations += own;
+    stats->counted_allocations += own;
+    stats->rules[rule].failures += ctx->errored;
+    stats->depth--;
+    stats->last_rule = rule;
+}
+
+// Rewinds to pos, the input read since being given back by rule.
+void backtrack(parser_ctx *ctx, size_t pos, parser_rule rule) {
+    ctx->stats.rules[rule].backtracks++;
+    ctx->stats.rules[rule].rescanned += ctx->buffer_pos - pos;
+    restore_pos(ctx, pos);
+}
+
+ASTElement run_rule(parser_ctx *ctx, parser_rule rule, ASTElementParser body) {
+    rule_frame frame = stats_enter(ctx, rule);
+    ASTElement elem = body(ctx);
+    stats_exit(ctx, rule, frame);
+    return elem;
 }
 
+// Defines a rule whose body is counted by run_rule.
+#define RULE(name, rule)                                                                           \
+    static ASTElement name##_body(parser_ctx *ctx);                                                \
+    ASTElement name(parser_ctx *ctx) {                                                             \
+        return run_rule(ctx, rule, name##_body);                                                   \
+    }                                                                                              \
+    static ASTElement name##_body(parser_ctx *ctx)
+#define STATS_ENTER(ctx, rule) rule_frame stats_frame = stats_enter(ctx, rule)
+#define STATS_EXIT(ctx, rule) stats_exit(ctx, rule, stats_frame)
+#define STATS_ADD(ctx, rule, field, n) ((ctx)->stats.rules[rule].field += (n))
+#define BACKTRACK(ctx, pos, rule) backtrack(ctx, pos, rule)
+#else
+// Without PARSER_STATS the instrumentation compiles to nothing.
+#define RULE(name, rule) ASTElement name(parser_ctx *ctx)
+#define STATS_ENTER(ctx, rule)
+#define STATS_EXIT(ctx, rule)
+#define STATS_ADD(ctx, rule, field, n)
+#define BACKTRACK(ctx, pos, rule) restore_pos(ctx, pos)
+#endif
+
 bool is_digit(char c) {
     return c >= '0' && c <= '9';
 }
 
-ASTElement stringElement(parser_ctx *ctx, ASTElementType type, const char strings[][5],
-                         size_t len) {
-    ASTElement elem = new_ASTElement(type, 0, ctx->buffer_pos);
-    for (int i = 0; i < len; i++) {
-        size_t pos = save_pos(ctx);
-        if (start_by(ctx, strings[i])) {
-            size_t len = strlen(strings[i]);
-            elem.value = malloc(sizeof(char) * len + 1);
-            elem.value = strcpy(elem.value, strings[i]);
-            RETURN_ELEMENT(elem, ctx);
-        }
-        restore_pos(ctx, pos);
-    }
-    char *concat = malloc(sizeof(char) * len * 7 + 1);
-    size_t clen = 0;
-    for (int i = 0; i < len; i++) {
-        strcpy(concat + clen, strings[i]);
-        clen += strlen(strings[i]);
-        if (i != len - 1) {
-            concat[clen++] = ',';
-            concat[clen++] = ' ';
-        }
+// Longest symbol of the table at the current position, at most max_len
+// characters long.
+ASTElement symbolElement(parser_ctx *ctx, ASTElementType type, const symbol_table *table,
+                         size_t max_len) {
+    ASTElement elem = new_ASTElement(ctx, type, 0, ctx->buffer_pos);
+    size_t len = ctx->buffer_len - ctx->buffer_pos;
+    if (len > max_len) {
+        len = max_len;
     }
-    concat[clen] = '\0';
-
-    error(ctx, "Expected one of %s, got %s", concat, ctx->buffer + ctx->buffer_pos);
-    free(concat);
-    return INVALID_ELEMENT;
+    const char *str = ctx->buffer + ctx->buffer_pos;
+    int number = lookup_symbol(table, str, len, &len);
+    if (!number) {
+        fail(ctx, SMILES_EXPECTED, EXPECTED_SYMBOL, '\0');
+        return INVALID_ELEMENT;
+    }
+    // two letter symbols written as in the periodic table share its string
+    if (len == 2 && atomic_symbols[number][0] == str[0] && atomic_symbols[number][1] == str[1]) {
+        elem.value = (char *)atomic_symbols[number];
+    } else {
+        elem.value = span_value(ctx, str, len);
+    }
+    ctx->buffer_pos += len;
+    RETURN_ELEMENT(elem, ctx);
 }
 
 ASTElement single_char(parser_ctx *ctx, ASTElementType type, char c) {
     if (peek(ctx) == c) {
         next(ctx);
-        ASTElement elem = new_ASTElement(type, 0, ctx->buffer_pos);
-        elem.value = malloc(sizeof(char) * 2);
-        elem.value[0] = c;
-        elem.value[1] = '\0';
+        ASTElement elem = new_ASTElement(ctx, type, 0, ctx->buffer_pos);
+        elem.value = span_value(ctx, &c, 1);
         RETURN_ELEMENT(elem, ctx);
     }
-    error(ctx, "Expected %c, got %c", c, peek(ctx));
+    fail(ctx, SMILES_EXPECTED, EXPECTED_CHAR, c);
     return INVALID_ELEMENT;
 }
 
-ASTElement number(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(NUMBER, 0, ctx->buffer_pos);
-    char *value = malloc(sizeof(char) * 5);
-    int cap = 4;
-    size_t i = 0;
+RULE(number, RULE_NUMBER) {
+    ASTElement elem = new_ASTElement(ctx, NUMBER, 0, ctx->buffer_pos);
+    size_t start = save_pos(ctx);
     while (!is_eof(ctx) && is_digit(peek(ctx))) {
-        if (i == cap) {
-            cap *= 2;
-            value = realloc(value, cap);
-        }
-        value[i++] = next(ctx);
+        next(ctx);
     }
-    if (i == 0) {
-        error(ctx, "Expected a number, got %c", peek(ctx));
-        free(value);
+    if (ctx->buffer_pos == start) {
+        fail(ctx, SMILES_EXPECTED, EXPECTED_NUMBER, '\0');
         return INVALID_ELEMENT;
     }
-    value[i] = '\0';
-    elem.value = value;
+    elem.value = span_value(ctx, ctx->buffer + start, ctx->buffer_pos - start);
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement digit(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(NUMBER, 0, ctx->buffer_pos);
+RULE(digit, RULE_DIGIT) {
+    ASTElement elem = new_ASTElement(ctx, NUMBER, 0, ctx->buffer_pos);
     if (is_digit(peek(ctx))) {
-        elem.value = malloc(sizeof(char) * 2);
-        elem.value[0] = next(ctx);
-        elem.value[1] = '\0';
+        elem.value = span_value(ctx, ctx->buffer + ctx->buffer_pos, 1);
+        next(ctx);
         RETURN_ELEMENT(elem, ctx);
     }
-    error(ctx, "Expected a digit, got %c", peek(ctx));
+    fail(ctx, SMILES_EXPECTED, EXPECTED_DIGIT, '\0');
     return INVALID_ELEMENT;
 }
 
+// Runs a production already chosen from the lookahead that can still fail
+// further in on malformed input. The failure is silent and rewinds to the
+// start so the caller can carry on, as if the production was optional.
 ASTElement option(parser_ctx *ctx, ASTElementParser parser) {
     if (is_eof(ctx)) {
         return INVALID_ELEMENT;
     }
+    STATS_ADD(ctx, RULE_OPTION, calls, 1);
     size_t pos = save_pos(ctx);
-    ctx->no_error_message++;
     ASTElement elem = parser(ctx);
-    ctx->no_error_message--;
     if (ctx->errored) {
-        restore_pos(ctx, pos);
-        ctx->errored = false;
-        free(ctx->error);
-        free_ASTElement(&elem);
+        STATS_ADD(ctx, RULE_OPTION, failures, 1);
+        // counted as a backtrack of the production that failed
+        BACKTRACK(ctx, pos, ctx->stats.last_rule);
+        clear_error(ctx);
         return INVALID_ELEMENT;
     }
     RETURN_ELEMENT(elem, ctx);
 }
 
-#define STRING(name, type, ...)                                                                    \
-    const char name##_strings[][5] = {__VA_ARGS__};                                                \
-    ASTElement name(parser_ctx *ctx) {                                                             \
-        return stringElement(ctx, type, name##_strings,                                            \
-                             sizeof(name##_strings) / sizeof(name##_strings[0]));                  \
+#define SYMBOL(name, type, table, max_len)                                                         \
+    RULE(name, RULE_##type) {                                                                      \
+        return symbolElement(ctx, type, &table, max_len);                                          \
     }
 
 #define SINGLE_CHAR(name, type, c)                                                                 \
-    ASTElement name(parser_ctx *ctx) {                                                             \
+    RULE(name, RULE_CHAR) {                                                                        \
         return single_char(ctx, type, c);                                                          \
     }
 
-STRING(aliphatic_organic, ALIPHATIC_ORGANIC, "Br", "Cl", "N", "O", "P", "S", "F", "C", "B", "I")
-STRING(aromatic_organic, AROMATIC_ORGANIC, "b", "c", "n", "o", "s", "p")
-STRING(element_symbols, ELEMENT_SYMBOL, "He", "Li", "Be", "Bi", "Ne", "Na", "Mg", "Al", "Si", "Cl",
-       "Ar", "Ca", "Sc", "Ti", "Cr", "Mn", "Fe", "Co", "Ni", "Cu", "Zn", "Ga", "Ge", "As", "Se",
-       "Br", "Kr", "Rb", "Sr", "Zr", "Nb", "Mo", "Tc", "Ru", "Rh", "Pd", "Ag", "Cd", "In", "Sn",
-       "Sb", "Te", "Xe", "Cs", "Ba", "Hf", "Ta", "Re", "Os", "Ir", "Pt", "Au", "Hg", "Tl", "Pb",
-       "Po", "At", "Rn", "Fr", "Ra", "Rf", "Db", "Sg", "Bh", "Hs", "Mt", "Ds", "Rg", "Cn", "Fl",
-       "Lv", "La", "Ce", "Pr", "Nd", "Pm", "Sm", "Eu", "Gd", "Tb", "Dy", "Ho", "Er", "Tm", "Yb",
-       "Lu", "Ac", "Th", "Pa", "Np", "Pu", "Am", "Cm", "Bk", "Cf", "Es", "Fm", "Md", "No", "Lr",
-       "H", "C", "N", "O", "F", "P", "S", "K", "V", "Y", "I", "W", "B", "U")
-STRING(aromatic_symbols, AROMATIC_SYMBOL, "se", "as", "b", "c", "n", "o", "p", "s")
-STRING(bond, BOND, "-", "=", "#", "$", ":", "/", "\\")
-STRING(chiral_, CHIRAL, "@", "@@", "@TH1", "@TH2", "@AL1", "@AL2", "@SP1", "@SP2", "@SP3", "@TB",
-       "@OH")
+SYMBOL(aliphatic_organic, ALIPHATIC_ORGANIC, aliphatic_organic_table, 2)
+SYMBOL(aromatic_organic, AROMATIC_ORGANIC, aromatic_symbols_table, 1)
+SYMBOL(element_symbols, ELEMENT_SYMBOL, element_symbols_table, 2)
+SYMBOL(aromatic_symbols, AROMATIC_SYMBOL, aromatic_symbols_table, 2)
 SINGLE_CHAR(star, CHAR, '*')
 SINGLE_CHAR(minus, CHAR, '-')
 SINGLE_CHAR(plus, CHAR, '+')
@@ -247,42 +439,83 @@ SINGLE_CHAR(hydrogen, CHAR, 'H')
 SINGLE_CHAR(open_paren, CHAR, '(')
 SINGLE_CHAR(close_paren, CHAR, ')')
 
-ASTElement symbol(parser_ctx *ctx) {
-    ASTElement elem = option(ctx, aromatic_symbols);
-    if (is_invalid(&elem)) {
-        elem = option(ctx, star);
-    }
-    if (is_invalid(&elem)) {
-        return element_symbols(ctx);
+RULE(bond, RULE_BOND) {
+    ASTElement elem = new_ASTElement(ctx, BOND, 0, ctx->buffer_pos);
+    if (!(char_class_at(ctx, 0) & CC_BOND)) {
+        fail(ctx, SMILES_EXPECTED, EXPECTED_BOND, '\0');
+        return INVALID_ELEMENT;
     }
+    elem.value = span_value(ctx, ctx->buffer + ctx->buffer_pos, 1);
+    next(ctx);
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement chiral(parser_ctx *ctx) {
-    ASTElement elem = chiral_(ctx);
-    CHECK_CTX(ctx, elem);
-    if (strcmp(elem.value, "@OH") == 0 || strcmp(elem.value, "@TB") == 0) {
-        char d1 = next(ctx);
-        char d2 = peek(ctx);
-        if (d1 == 0 || !is_digit(d1)) {
-            return digit(ctx);
+RULE(symbol, RULE_SYMBOL) {
+    uint8_t cls = char_class_at(ctx, 0);
+    if (cls & CC_AROMATIC_SYMBOL) {
+        return aromatic_symbols(ctx);
+    }
+    if (cls & CC_STAR) {
+        return star(ctx);
+    }
+    return element_symbols(ctx);
+}
+
+// Chirality classes allowed after @ with the highest number of each one and
+// the code of their number 0, see the chirality enum.
+const struct {
+    char name[3];
+    int max;
+    int base;
+} chiral_classes[] = {{"TH", 2, CHIRAL_TH},
+                      {"AL", 2, CHIRAL_AL},
+                      {"SP", 3, CHIRAL_SP},
+                      {"TB", 20, CHIRAL_TB},
+                      {"OH", 30, CHIRAL_OH}};
+
+// Length of the chirality class and number after @, 0 when there is none.
+// code is set to the chirality of the class and number.
+size_t chiral_class_len(const parser_ctx *ctx, int *code) {
+    for (size_t i = 0; i < sizeof(chiral_classes) / sizeof(chiral_classes[0]); i++) {
+        if (lookahead(ctx, 0) != chiral_classes[i].name[0] ||
+            lookahead(ctx, 1) != chiral_classes[i].name[1] || !is_digit(lookahead(ctx, 2))) {
+            continue;
         }
-        elem.value[3] = d1;
-        if (is_digit(d2)) {
-            next(ctx);
-            elem.value[4] = d2;
+        int n = lookahead(ctx, 2) - '0';
+        size_t len = 3;
+        int n2 = n * 10 + lookahead(ctx, 3) - '0';
+        if (is_digit(lookahead(ctx, 3)) && n2 <= chiral_classes[i].max) {
+            n = n2;
+            len = 4;
         }
-        RETURN_ELEMENT(elem, ctx);
+        if (n < 1 || n > chiral_classes[i].max) {
+            return 0;
+        }
+        *code = chiral_classes[i].base + n;
+        return len;
     }
+    return 0;
+}
+
+RULE(chiral, RULE_CHIRAL) {
+    ASTElement elem = new_ASTElement(ctx, CHIRAL, 0, ctx->buffer_pos);
+    EXPECT_CHAR('@', ctx, elem);
+    if (lookahead(ctx, 0) == '@') {
+        next(ctx);
+    } else {
+        int code;
+        ctx->buffer_pos += chiral_class_len(ctx, &code);
+    }
+    elem.value = span_value(ctx, ctx->buffer + elem.from, ctx->buffer_pos - elem.from);
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement hcount(parser_ctx *ctx) {
+RULE(hcount, RULE_HCOUNT) {
     ASTElement H = hydrogen(ctx);
     CHECK_CTX(ctx, H);
     ASTElement elem = {
         .type = HCOUNT,
-        .children = malloc(sizeof(ASTElement) * 2),
+        .children = arena_alloc(&ctx->arena, sizeof(ASTElement) * 2),
         .children_len = 1,
     };
     elem.children[0] = H;
@@ -294,28 +527,31 @@ ASTElement hcount(parser_ctx *ctx) {
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement charge(parser_ctx *ctx) {
+RULE(charge, RULE_CHARGE) {
 	size_t start = save_pos(ctx);
-    ASTElement sign = option(ctx, minus);
-    if (is_invalid(&sign)) {
-        sign = option(ctx, plus);
-    }
-    if (is_invalid(&sign)) {
-        error(ctx, "Expected a sign (- or +), got %c", peek(ctx));
-        free_ASTElement(&sign);
-        return INVALID_ELEMENT;
+    ASTElement sign;
+    switch (lookahead(ctx, 0)) {
+        case '-':
+            sign = minus(ctx);
+            break;
+        case '+':
+            sign = plus(ctx);
+            break;
+        default:
+            fail(ctx, SMILES_EXPECTED, EXPECTED_SIGN, '\0');
+            return INVALID_ELEMENT;
     }
 
-    ASTElement elem = new_ASTElement(CHARGE, 3, start);
+    ASTElement elem = new_ASTElement(ctx, CHARGE, 3, start);
     elem.children_len = 3;
     elem.children[0] = sign;
-    elem.children[1] = option(ctx, digit);
-    elem.children[2] = option(ctx, digit);
+    elem.children[1] = char_class_at(ctx, 0) & CC_DIGIT ? digit(ctx) : INVALID_ELEMENT;
+    elem.children[2] = char_class_at(ctx, 0) & CC_DIGIT ? digit(ctx) : INVALID_ELEMENT;
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement class(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(CLASS, 1, ctx->buffer_pos);
+RULE(class, RULE_CLASS) {
+    ASTElement elem = new_ASTElement(ctx, CLASS, 1, ctx->buffer_pos);
     EXPECT_CHAR(':', ctx, elem);
     elem.children[0] = number(ctx);
     elem.children_len++;
@@ -323,48 +559,52 @@ ASTElement class(parser_ctx *ctx) {
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement bracket_atom(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(BRACKET_ATOM, 6, ctx->buffer_pos);
+RULE(bracket_atom, RULE_BRACKET_ATOM) {
+    ASTElement elem = new_ASTElement(ctx, BRACKET_ATOM, 6, ctx->buffer_pos);
     EXPECT_CHAR('[', ctx, elem);
-    elem.children[0] = option(ctx, number);
+    elem.children[0] = char_class_at(ctx, 0) & CC_DIGIT ? number(ctx) : INVALID_ELEMENT;
     elem.children_len++;
     elem.children[1] = symbol(ctx);
     elem.children_len++;
     CHECK_CTX(ctx, elem);
-    elem.children[2] = option(ctx, chiral);
+    elem.children[2] = lookahead(ctx, 0) == '@' ? chiral(ctx) : INVALID_ELEMENT;
     elem.children_len++;
-    elem.children[3] = option(ctx, hcount);
+    elem.children[3] = lookahead(ctx, 0) == 'H' ? option(ctx, hcount) : INVALID_ELEMENT;
     elem.children_len++;
-    elem.children[4] = option(ctx, charge);
+    char sign = lookahead(ctx, 0);
+    elem.children[4] = sign == '-' || sign == '+' ? charge(ctx) : INVALID_ELEMENT;
     elem.children_len++;
-    elem.children[5] = option(ctx, class);
+    elem.children[5] = lookahead(ctx, 0) == ':' ? option(ctx, class) : INVALID_ELEMENT;
     elem.children_len++;
     EXPECT_CHAR(']', ctx, elem);
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement atom(parser_ctx *ctx) {
-    ASTElement elem = option(ctx, aliphatic_organic);
-    if (is_invalid(&elem)) {
-        elem = option(ctx, aromatic_organic);
+RULE(atom, RULE_ATOM) {
+    uint8_t cls = char_class_at(ctx, 0);
+    if (cls & CC_ALIPHATIC) {
+        return aliphatic_organic(ctx);
     }
-    if (is_invalid(&elem)) {
-        elem = option(ctx, star);
+    if (cls & CC_AROMATIC) {
+        return aromatic_organic(ctx);
     }
-    if (is_invalid(&elem)) {
-        elem = option(ctx, bracket_atom);
+    if (cls & CC_STAR) {
+        return star(ctx);
     }
-    if (is_invalid(&elem)) {
-        error(ctx, "Expected an atom");
-        return INVALID_ELEMENT;
+    if (cls & CC_BRACKET) {
+        ASTElement elem = option(ctx, bracket_atom);
+        if (!is_invalid(&elem)) {
+            return elem;
+        }
     }
-    RETURN_ELEMENT(elem, ctx);
+    fail(ctx, SMILES_EXPECTED_ATOM, 0, '\0');
+    return INVALID_ELEMENT;
 }
 
-ASTElement ringbond(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(RINGBOND, 4, ctx->buffer_pos);
+RULE(ringbond, RULE_RINGBOND) {
+    ASTElement elem = new_ASTElement(ctx, RINGBOND, 4, ctx->buffer_pos);
     elem.children_len = 2;
-    elem.children[0] = option(ctx, bond);
+    elem.children[0] = char_class_at(ctx, 0) & CC_BOND ? bond(ctx) : INVALID_ELEMENT;
     if (peek(ctx) == '%') {
         elem.children[1] = mod(ctx);
         CHECK_CTX(ctx, elem);
@@ -381,108 +621,249 @@ ASTElement ringbond(parser_ctx *ctx) {
     RETURN_ELEMENT(elem, ctx);
 }
 
-ASTElement chain(parser_ctx *ctx);
-ASTElement branch(parser_ctx *ctx);
+// A ring bond is an optional bond followed by a digit or by %nn.
+bool starts_ringbond(const parser_ctx *ctx) {
+    size_t offset = char_class_at(ctx, 0) & CC_BOND ? 1 : 0;
+    return char_class_at(ctx, offset) & CC_DIGIT || lookahead(ctx, offset) == '%';
+}
 
-ASTElement branched_atom(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(BRANCHED_ATOM, 1, ctx->buffer_pos);
-    elem.children[0] = atom(ctx);
-    elem.children_len++;
-    CHECK_CTX(ctx, elem);
-    int capacity = 1;
-    bool check_ringbound = true;
-    while (!is_invalid(&elem.children[elem.children_len - 1])) {
-        if (elem.children_len == capacity) {
-            capacity *= 2;
-            elem.children = realloc(elem.children, sizeof(ASTElement) * capacity);
-        }
-        if (check_ringbound) {
-            elem.children[elem.children_len] = option(ctx, ringbond);
+// Chains nest through branches: chain -> branched atom -> branch -> chain.
+// Instead of recursing once per nesting level, chain() keeps one frame per
+// open branch on a heap allocated stack so that the depth of a molecule is
+// only bounded by the available memory.
+typedef struct chain_frame {
+    ASTElement chain;
+    size_t chain_capacity;
+    // branched atom of this chain currently receiving its branches
+    ASTElement atom;
+    size_t atom_capacity;
+    // branch of the parent atom holding this chain, unused for the outer chain
+    ASTElement branch;
+    size_t branch_slot;
+    size_t branch_start;
+} chain_frame;
+
+// Most molecules nest only a few branches deep, so the first frames live on
+// the C stack and only deeper nesting spills over to the heap.
+#define CHAIN_INLINE_FRAMES 8
+
+typedef struct chain_stack {
+    chain_frame *frames;
+    size_t len;
+    size_t capacity;
+    chain_frame inline_frames[CHAIN_INLINE_FRAMES];
+} chain_stack;
+
+typedef enum chain_state {
+    CHAIN_ATOM,
+    CHAIN_BRANCHES,
+    CHAIN_NEXT,
+    CHAIN_END,
+    CHAIN_FAILED
+} chain_state;
+
+void free_chain_stack(chain_stack *stack) {
+    if (stack->frames != stack->inline_frames) {
+        free(stack->frames);
+    }
+}
+
+// Pushes a frame for a new chain. NULL with the error recorded when the
+// stack cannot grow, the frames already pushed are left as they are.
+chain_frame *push_frame(parser_ctx *ctx, chain_stack *stack) {
+    if (stack->len == stack->capacity) {
+        chain_frame *frames;
+        if (stack->frames == stack->inline_frames) {
+            frames = malloc(sizeof(chain_frame) * stack->capacity * 2);
+            if (frames) {
+                memcpy(frames, stack->inline_frames, sizeof(stack->inline_frames));
+            }
         } else {
-            elem.children[elem.children_len] = option(ctx, branch);
+            frames = realloc(stack->frames, sizeof(chain_frame) * stack->capacity * 2);
         }
-        elem.children_len++;
-        if (check_ringbound && is_invalid(&elem.children[elem.children_len - 1])) {
-            check_ringbound = false;
-            elem.children_len--;
+        if (!frames) {
+            error(ctx, "Out of memory");
+            return NULL;
         }
+        stack->frames = frames;
+        stack->capacity *= 2;
     }
-    elem.children_len--;
-    RETURN_ELEMENT(elem, ctx);
+    chain_frame *frame = &stack->frames[stack->len++];
+#ifdef PARSER_STATS
+    if (stack->len - 1 > ctx->stats.max_branch_depth) {
+        ctx->stats.max_branch_depth = stack->len - 1;
+    }
+#endif
+    frame->chain = new_ASTElement(ctx, CHAIN, 1, ctx->buffer_pos);
+    frame->chain_capacity = 1;
+    return frame;
 }
 
-ASTElement branch(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(BRANCH, 2, ctx->buffer_pos);
-    EXPECT_CHAR('(', ctx, elem);
-    elem.children[0] = option(ctx, bond);
-    elem.children_len++;
-    if (is_invalid(&elem.children[0])) {
-        elem.children[0] = option(ctx, dot);
+// Parses the atom and ring bonds of a branched atom, its branches are
+// opened one by one by chain().
+bool branched_atom(parser_ctx *ctx, chain_frame *frame) {
+    STATS_ENTER(ctx, RULE_BRANCHED_ATOM);
+    frame->atom = new_ASTElement(ctx, BRANCHED_ATOM, 1, ctx->buffer_pos);
+    frame->atom_capacity = 1;
+    frame->atom.children[0] = atom(ctx);
+    frame->atom.children_len++;
+    if (ctx->errored) {
+        STATS_EXIT(ctx, RULE_BRANCHED_ATOM);
+        return false;
     }
-    if (is_invalid(&elem.children[0])) {
-        elem.children[0] = chain(ctx);
-    } else {
-        elem.children[1] = chain(ctx);
+    while (starts_ringbond(ctx)) {
+        ASTElement child = option(ctx, ringbond);
+        if (is_invalid(&child)) {
+            break;
+        }
+        push_child(ctx, &frame->atom, &frame->atom_capacity, child);
     }
-    CHECK_CTX(ctx, elem);
-    EXPECT_CHAR(')', ctx, elem);
-    RETURN_ELEMENT(elem, ctx);
+    STATS_EXIT(ctx, RULE_BRANCHED_ATOM);
+    return true;
 }
 
-ASTElement chain_(parser_ctx *ctx, ASTElement *chain, size_t cap) {
-    if (chain->children_len + 2 >= cap) {
-        cap *= 2;
-        if (cap <= 2) {
-            cap = 3;
-        }
-        chain->children = realloc(chain->children, sizeof(ASTElement) * cap);
-    }
+void end_branched_atom(parser_ctx *ctx, chain_frame *frame) {
+    frame->atom.to = ctx->buffer_pos - 1;
+    push_child(ctx, &frame->chain, &frame->chain_capacity, frame->atom);
+}
 
-    chain->children[chain->children_len] = option(ctx, bond);
-    if (is_invalid(&chain->children[chain->children_len])) {
-        chain->children[chain->children_len] = option(ctx, dot);
+// Opens the branch at the current '(' and pushes the frame of its chain.
+// A failing branch is dropped and the parent atom simply ends before it.
+// NULL when out of memory.
+chain_frame *open_branch(parser_ctx *ctx, chain_stack *stack) {
+    STATS_ADD(ctx, RULE_BRANCH, calls, 1);
+    ASTElement branch = new_ASTElement(ctx, BRANCH, 2, ctx->buffer_pos);
+    size_t start = save_pos(ctx);
+    next(ctx);
+    size_t slot = 0;
+    if (char_class_at(ctx, 0) & CC_BOND) {
+        branch.children[0] = bond(ctx);
+        slot = 1;
+    } else if (lookahead(ctx, 0) == '.') {
+        branch.children[0] = dot(ctx);
+        slot = 1;
     }
-    if (is_invalid(&chain->children[chain->children_len])) {
-        chain->children[chain->children_len] = option(ctx, branched_atom);
-        if (is_invalid(&chain->children[chain->children_len])) {
-            chain->to = ctx->buffer_pos - 1;
-			return *chain;
-        }
-        chain->children_len++;
-        return chain_(ctx, chain, cap);
+    chain_frame *frame = push_frame(ctx, stack);
+    if (!frame) {
+        return NULL;
     }
+    frame->branch = branch;
+    frame->branch_slot = slot;
+    frame->branch_start = start;
+    return frame;
+}
 
-    chain->children_len++;
-    chain->children[chain->children_len] = branched_atom(ctx);
-    chain->children_len++;
-    CHECK_CTX(ctx, *chain);
+chain_frame *drop_branch(parser_ctx *ctx, chain_stack *stack) {
+    chain_frame *frame = &stack->frames[--stack->len];
+    STATS_ADD(ctx, RULE_BRANCH, failures, 1);
+    BACKTRACK(ctx, frame->branch_start, RULE_BRANCH);
+    clear_error(ctx);
+    chain_frame *parent = frame - 1;
+    end_branched_atom(ctx, parent);
+    return parent;
+}
 
-    return chain_(ctx, chain, cap);
+chain_frame *close_branch(parser_ctx *ctx, chain_stack *stack, chain_state *state) {
+    chain_frame *frame = &stack->frames[stack->len - 1];
+    ASTElement branch = frame->branch;
+    branch.children[frame->branch_slot] = frame->chain;
+    branch.children_len = frame->branch_slot + 1;
+    if (peek(ctx) != ')') {
+        fail(ctx, SMILES_EXPECTED, EXPECTED_CHAR, ')');
+        *state = CHAIN_NEXT;
+        return drop_branch(ctx, stack);
+    }
+    next(ctx);
+    branch.to = ctx->buffer_pos - 1;
+    stack->len--;
+    chain_frame *parent = frame - 1;
+    push_child(ctx, &parent->atom, &parent->atom_capacity, branch);
+    *state = CHAIN_BRANCHES;
+    return parent;
 }
 
-ASTElement chain(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(CHAIN, 1, ctx->buffer_pos);
-    elem.children[0] = branched_atom(ctx);
-    elem.children_len++;
-    CHECK_CTX(ctx, elem);
-    return chain_(ctx, &elem, 1);
+chain_state chain_next(parser_ctx *ctx, chain_frame *frame) {
+    uint8_t cls = char_class_at(ctx, 0);
+    if (cls & CC_BOND || lookahead(ctx, 0) == '.') {
+        push_child(ctx, &frame->chain, &frame->chain_capacity,
+                   cls & CC_BOND ? bond(ctx) : dot(ctx));
+        return CHAIN_ATOM;
+    }
+    if (!(cls & CC_ATOM)) {
+        return CHAIN_END;
+    }
+    size_t pos = save_pos(ctx);
+    if (!branched_atom(ctx, frame)) {
+        BACKTRACK(ctx, pos, RULE_BRANCHED_ATOM);
+        clear_error(ctx);
+        return CHAIN_END;
+    }
+    return CHAIN_BRANCHES;
+}
+
+RULE(chain, RULE_CHAIN) {
+    chain_stack stack;
+    stack.frames = stack.inline_frames;
+    stack.len = 0;
+    stack.capacity = CHAIN_INLINE_FRAMES;
+    chain_frame *top = push_frame(ctx, &stack);
+    chain_state state = CHAIN_ATOM;
+    while (true) {
+        switch (state) {
+            case CHAIN_ATOM:
+                state = branched_atom(ctx, top) ? CHAIN_BRANCHES : CHAIN_FAILED;
+                break;
+            case CHAIN_BRANCHES:
+                if (lookahead(ctx, 0) == '(') {
+                    top = open_branch(ctx, &stack);
+                    if (!top) {
+                        free_chain_stack(&stack);
+                        return INVALID_ELEMENT;
+                    }
+                    state = CHAIN_ATOM;
+                } else {
+                    end_branched_atom(ctx, top);
+                    state = CHAIN_NEXT;
+                }
+                break;
+            case CHAIN_NEXT:
+                state = chain_next(ctx, top);
+                break;
+            case CHAIN_END:
+                top->chain.to = ctx->buffer_pos - 1;
+                if (stack.len > 1) {
+                    top = close_branch(ctx, &stack, &state);
+                    break;
+                }
+                ASTElement elem = top->chain;
+                free_chain_stack(&stack);
+                return elem;
+            case CHAIN_FAILED:
+                if (stack.len > 1) {
+                    top = drop_branch(ctx, &stack);
+                    state = CHAIN_NEXT;
+                    break;
+                }
+                free_chain_stack(&stack);
+                return INVALID_ELEMENT;
+        }
+    }
 }
 
 bool is_terminator(parser_ctx *ctx) {
-    return is_eof(ctx) || peek(ctx) == ' ' || peek(ctx) == '\r' || peek(ctx) == '\n' ||
-           peek(ctx) == '\t' || peek(ctx) == '\0';
+    return char_class_at(ctx, 0) & CC_TERMINATOR;
 }
 
-ASTElement terminator(parser_ctx *ctx) {
+RULE(terminator, RULE_TERMINATOR) {
     if (is_terminator(ctx)) {
-        return new_ASTElement(TERMINATOR, 0, ctx->buffer_pos);
+        return new_ASTElement(ctx, TERMINATOR, 0, ctx->buffer_pos);
     }
-    error(ctx, "Expected end of expression");
+    fail(ctx, SMILES_EXPECTED_END, 0, '\0');
     return INVALID_ELEMENT;
 }
 
-ASTElement smile(parser_ctx *ctx) {
-    ASTElement elem = new_ASTElement(SMILES, 2, ctx->buffer_pos);
+RULE(smile, RULE_SMILES) {
+    ASTElement elem = new_ASTElement(ctx, SMILES, 2, ctx->buffer_pos);
     elem.children[0] = chain(ctx);
     elem.children_len++;
     if (ctx->errored) {
@@ -492,8 +873,7 @@ ASTElement smile(parser_ctx *ctx) {
             restore_pos(ctx, pos);
             return INVALID_ELEMENT;
         }
-        free(ctx->error);
-        ctx->errored = false;
+        clear_error(ctx);
         elem.children_len--;
     }
     elem.children[elem.children_len] = terminator(ctx);
@@ -501,3 +881,350 @@ ASTElement smile(parser_ctx *ctx) {
     CHECK_CTX(ctx, elem);
     RETURN_ELEMENT(elem, ctx);
 }
+
+// Validation and records walk the same grammar as smile() without building
+// elements, copying values or formatting errors. The scan_ functions
+// advance past their production and return whether it matched.
+
+// State of a walk, atoms and bonds only being recorded when out is set.
+typedef struct scanner {
+    parser_ctx *ctx;
+    records *out;
+    size_t atoms_capacity;
+    size_t bonds_capacity;
+    // atom the next one bonds to, -1 at the start or after a dot, and the
+    // bond symbol read since with its position
+    int prev;
+    char symbol;
+    size_t symbol_from;
+    // atoms the open branches leave from, innermost last
+    int *branch_atoms;
+    size_t branch_atoms_len;
+    size_t branch_atoms_capacity;
+    // atoms and ring bond ends walked, recorded or not
+    size_t atoms_len;
+    size_t ring_bonds_len;
+} scanner;
+
+// Atomic number of the longest symbol of the table at the current
+// position, 0 when there is none.
+int scan_symbol(parser_ctx *ctx, const symbol_table *table, size_t max_len) {
+    size_t len = ctx->buffer_len - ctx->buffer_pos;
+    if (len > max_len) {
+        len = max_len;
+    }
+    int number = lookup_symbol(table, ctx->buffer + ctx->buffer_pos, len, &len);
+    if (number) {
+        ctx->buffer_pos += len;
+    }
+    return number;
+}
+
+// Value of at most max_len digits, -1 when it does not fit an int. The
+// digits are read all the same.
+int scan_digits(parser_ctx *ctx, size_t max_len) {
+    int value = 0;
+    for (size_t i = 0; i < max_len && char_class_at(ctx, 0) & CC_DIGIT; i++) {
+        int digit = ctx->buffer[ctx->buffer_pos++] - '0';
+        if (value < 0 || value > (INT_MAX - digit) / 10) {
+            value = -1;
+        } else {
+            value = value * 10 + digit;
+        }
+    }
+    return value;
+}
+
+bool scan_bracket_atom(parser_ctx *ctx, AtomRecord *atom) {
+    ctx->buffer_pos++;
+    atom->isotope = scan_digits(ctx, SIZE_MAX);
+    uint8_t cls = char_class_at(ctx, 0);
+    if (cls & CC_STAR) {
+        ctx->buffer_pos++;
+    } else if (cls & CC_AROMATIC_SYMBOL) {
+        atom->element = scan_symbol(ctx, &aromatic_symbols_table, 2);
+        atom->aromatic = 1;
+    } else {
+        atom->element = scan_symbol(ctx, &element_symbols_table, 2);
+    }
+    if (!(cls & CC_STAR) && !atom->element) {
+        return false;
+    }
+    if (lookahead(ctx, 0) == '@') {
+        ctx->buffer_pos++;
+        int code = CHIRAL_ANTICLOCKWISE;
+        if (lookahead(ctx, 0) == '@') {
+            ctx->buffer_pos++;
+            code = CHIRAL_CLOCKWISE;
+        } else {
+            ctx->buffer_pos += chiral_class_len(ctx, &code);
+        }
+        atom->chirality = code;
+    }
+    atom->hydrogens = 0;
+    if (lookahead(ctx, 0) == 'H') {
+        ctx->buffer_pos++;
+        atom->hydrogens = char_class_at(ctx, 0) & CC_DIGIT ? scan_digits(ctx, 1) : 1;
+    }
+    char sign = lookahead(ctx, 0);
+    if (sign == '-' || sign == '+') {
+        ctx->buffer_pos++;
+        int charge = char_class_at(ctx, 0) & CC_DIGIT ? scan_digits(ctx, 2) : 1;
+        atom->charge = sign == '-' ? -charge : charge;
+    }
+    if (lookahead(ctx, 0) == ':' && char_class_at(ctx, 1) & CC_DIGIT) {
+        ctx->buffer_pos++;
+        atom->atom_class = scan_digits(ctx, SIZE_MAX);
+    }
+    if (lookahead(ctx, 0) != ']') {
+        return false;
+    }
+    ctx->buffer_pos++;
+    return true;
+}
+
+// Appends a bond record, false when out of memory.
+bool record_bond(scanner *s, BondRecord bond) {
+    records *out = s->out;
+    out->bonds = arena_grow(&s->ctx->arena, out->bonds, out->bonds_len, &s->bonds_capacity,
+                            sizeof(BondRecord));
+    if (!out->bonds) {
+        error(s->ctx, "Out of memory");
+        return false;
+    }
+    out->bonds[out->bonds_len++] = bond;
+    return true;
+}
+
+// Appends an atom record and the bond leading to it.
+bool record_atom(scanner *s, AtomRecord atom) {
+    records *out = s->out;
+    out->atoms = arena_grow(&s->ctx->arena, out->atoms, out->atoms_len, &s->atoms_capacity,
+                            sizeof(AtomRecord));
+    if (!out->atoms) {
+        error(s->ctx, "Out of memory");
+        return false;
+    }
+    int index = out->atoms_len++;
+    out->atoms[index] = atom;
+    if (s->prev >= 0) {
+        int from = s->symbol ? s->symbol_from : atom.from;
+        BondRecord bond = {.begin = s->prev, .end = index, .from = from, .symbol = s->symbol,
+                           .ring = -1};
+        if (!record_bond(s, bond)) {
+            return false;
+        }
+    }
+    s->prev = index;
+    s->symbol = '\0';
+    return true;
+}
+
+// Atom and ring bonds, the position is left at the atom on failure.
+bool scan_branched_atom(scanner *s) {
+    parser_ctx *ctx = s->ctx;
+    uint8_t cls = char_class_at(ctx, 0);
+    size_t start = ctx->buffer_pos;
+    AtomRecord atom = {.hydrogens = -1, .from = start};
+    bool parsed = false;
+    if (cls & CC_ALIPHATIC) {
+        parsed = (atom.element = scan_symbol(ctx, &aliphatic_organic_table, 2));
+    } else if (cls & CC_AROMATIC) {
+        parsed = (atom.element = scan_symbol(ctx, &aromatic_symbols_table, 1));
+        atom.aromatic = 1;
+    } else if (cls & CC_STAR) {
+        ctx->buffer_pos++;
+        parsed = true;
+    } else if (cls & CC_BRACKET) {
+        parsed = scan_bracket_atom(ctx, &atom);
+    }
+    if (!parsed) {
+        ctx->buffer_pos = start;
+        return false;
+    }
+    atom.to = ctx->buffer_pos - 1;
+    s->atoms_len++;
+    if (s->out && !record_atom(s, atom)) {
+        return false;
+    }
+    while (starts_ringbond(ctx)) {
+        size_t from = ctx->buffer_pos;
+        size_t offset = char_class_at(ctx, 0) & CC_BOND ? 1 : 0;
+        int label;
+        if (lookahead(ctx, offset) != '%') {
+            label = lookahead(ctx, offset) - '0';
+            ctx->buffer_pos += offset + 1;
+        } else if (char_class_at(ctx, offset + 1) & char_class_at(ctx, offset + 2) & CC_DIGIT) {
+            label = (lookahead(ctx, offset + 1) - '0') * 10 + lookahead(ctx, offset + 2) - '0';
+            ctx->buffer_pos += offset + 3;
+        } else {
+            break;
+        }
+        s->ring_bonds_len++;
+        if (!s->out) {
+            continue;
+        }
+        BondRecord bond = {.begin = s->prev, .end = -1, .from = from,
+                           .symbol = offset ? ctx->buffer[from] : '\0', .ring = label};
+        if (!record_bond(s, bond)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Notes the bond or dot at the current position for the next atom.
+void record_bond_symbol(scanner *s) {
+    if (lookahead(s->ctx, 0) == '.') {
+        s->prev = -1;
+    } else {
+        s->symbol = lookahead(s->ctx, 0);
+        s->symbol_from = s->ctx->buffer_pos;
+    }
+}
+
+// Saves the atom the branch opening here leaves from, false when out of
+// memory.
+bool record_branch(scanner *s) {
+    s->branch_atoms = arena_grow(&s->ctx->arena, s->branch_atoms, s->branch_atoms_len,
+                                 &s->branch_atoms_capacity, sizeof(int));
+    if (!s->branch_atoms) {
+        error(s->ctx, "Out of memory");
+        return false;
+    }
+    s->branch_atoms[s->branch_atoms_len++] = s->prev;
+    return true;
+}
+
+// Goes back to the atom the branch closing here left from.
+void record_branch_end(scanner *s) {
+    s->prev = s->branch_atoms[--s->branch_atoms_len];
+    s->symbol = '\0';
+}
+
+// Walks a whole SMILES. Out of memory, ctx is left errored and the
+// validation is meaningless.
+Validation scan(scanner *s) {
+    parser_ctx *ctx = s->ctx;
+    s->prev = -1;
+    // a failure inside a branch drops it and every branch around it, which
+    // leaves the outermost one unparsed
+    size_t depth = 0, outer_branch = 0;
+    chain_state state = CHAIN_ATOM;
+    while (!ctx->errored) {
+        switch (state) {
+            case CHAIN_ATOM:
+                state = scan_branched_atom(s) ? CHAIN_BRANCHES : CHAIN_FAILED;
+                break;
+            case CHAIN_BRANCHES:
+                if (lookahead(ctx, 0) == '(') {
+                    if (depth++ == 0) {
+                        outer_branch = ctx->buffer_pos;
+                    }
+                    if (s->out && !record_branch(s)) {
+                        break;
+                    }
+                    ctx->buffer_pos++;
+                    if (char_class_at(ctx, 0) & CC_BOND || lookahead(ctx, 0) == '.') {
+                        if (s->out) {
+                            record_bond_symbol(s);
+                        }
+                        ctx->buffer_pos++;
+                    }
+                    state = CHAIN_ATOM;
+                } else {
+                    state = CHAIN_NEXT;
+                }
+                break;
+            case CHAIN_NEXT:
+                if (char_class_at(ctx, 0) & CC_BOND || lookahead(ctx, 0) == '.') {
+                    if (s->out) {
+                        record_bond_symbol(s);
+                    }
+                    ctx->buffer_pos++;
+                    state = CHAIN_ATOM;
+                } else {
+                    state = scan_branched_atom(s) ? CHAIN_BRANCHES : CHAIN_END;
+                }
+                break;
+            case CHAIN_END:
+                if (depth > 0 && lookahead(ctx, 0) == ')') {
+                    if (s->out) {
+                        record_branch_end(s);
+                    }
+                    ctx->buffer_pos++;
+                    depth--;
+                    state = CHAIN_BRANCHES;
+                    break;
+                }
+                if (depth > 0) {
+                    return (Validation){SMILES_EXPECTED_END, outer_branch};
+                }
+                if (!is_terminator(ctx)) {
+                    return (Validation){SMILES_EXPECTED_END, ctx->buffer_pos};
+                }
+                return (Validation){SMILES_VALID, 0};
+            case CHAIN_FAILED:
+                if (depth > 0) {
+                    return (Validation){SMILES_EXPECTED_END, outer_branch};
+                }
+                size_t pos = ctx->buffer_pos;
+                // an input starting with a terminator is empty
+                ctx->buffer_pos = 0;
+                if (is_terminator(ctx)) {
+                    return (Validation){SMILES_VALID, 0};
+                }
+                return (Validation){SMILES_EXPECTED_ATOM, pos};
+        }
+    }
+    return (Validation){SMILES_MESSAGE, ctx->error.position};
+}
+
+Validation validate(char *buffer, size_t len) {
+    parser_ctx ctx = init_ctx(buffer, len);
+    scanner s = {.ctx = &ctx};
+    return scan(&s);
+}
+
+// Fails ctx as smile() does when a walk did not reach the end, true when ctx
+// is errored.
+bool fail_scan(parser_ctx *ctx, Validation result) {
+    if (result.code == SMILES_EXPECTED_ATOM || result.code == SMILES_EXPECTED_END) {
+        ctx->buffer_pos = result.position;
+        fail(ctx, result.code, 0, '\0');
+    }
+    return ctx->errored;
+}
+
+records parse_records(parser_ctx *ctx) {
+    // every atom and ring bond end takes a character of its own, the other
+    // bonds each leading to an atom. Longer inputs are walked once first to
+    // count the records, which are then allocated once instead of leaving
+    // every smaller copy behind in the arena.
+    scanner count = {.ctx = ctx, .atoms_len = ctx->buffer_len};
+    size_t record_size = sizeof(AtomRecord) + sizeof(BondRecord);
+    if (ctx->buffer_len * record_size > ARENA_MIN_BLOCK_SIZE) {
+        size_t start = ctx->buffer_pos;
+        count.atoms_len = 0;
+        if (fail_scan(ctx, scan(&count))) {
+            return (records){0};
+        }
+        ctx->buffer_pos = start;
+    }
+    size_t bonds_capacity = count.atoms_len + count.ring_bonds_len + 1;
+    // atoms and bonds share one allocation, and so one block of the arena
+    size_t atoms_size = sizeof(AtomRecord) * (count.atoms_len + 1);
+    char *data = arena_alloc(&ctx->arena, atoms_size + sizeof(BondRecord) * bonds_capacity);
+    if (!data) {
+        error(ctx, "Out of memory");
+        return (records){0};
+    }
+    records out = {.atoms = (AtomRecord *)data, .bonds = (BondRecord *)(data + atoms_size)};
+    scanner s = {
+        .ctx = ctx,
+        .out = &out,
+        .atoms_capacity = count.atoms_len + 1,
+        .bonds_capacity = bonds_capacity,
+    };
+    return fail_scan(ctx, scan(&s)) ? (records){0} : out;
+}
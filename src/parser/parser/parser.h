@@ -2,14 +2,110 @@
 #define PARSER_H
 
 #include "ast/protocol.h"
+#include "parser/arena.h"
+
+// Codes of the errors of smile(). validate() only tells apart the first
+// three, matching the messages of a failed smile(): an atom expected where
+// none could be read, or text left after the SMILES.
+typedef enum smiles_error {
+    SMILES_VALID,
+    SMILES_EXPECTED_ATOM,
+    SMILES_EXPECTED_END,
+    // a production did not find what the expected set of the error holds
+    SMILES_EXPECTED,
+    // failures past the grammar, such as unpaired ring bonds, with a message
+    SMILES_MESSAGE,
+} smiles_error;
+
+// What a failing production expected, one bit per alternative.
+typedef enum expected_set {
+    EXPECTED_CHAR = 1 << 0,
+    EXPECTED_SYMBOL = 1 << 1,
+    EXPECTED_NUMBER = 1 << 2,
+    EXPECTED_DIGIT = 1 << 3,
+    EXPECTED_BOND = 1 << 4,
+    EXPECTED_SIGN = 1 << 5,
+} expected_set;
+
+// Failure of a parse, recorded without allocating anything since most of
+// them are rewound by the grammar. Only the one a parse ends with is turned
+// into text, by error_message().
+typedef struct parse_error {
+    smiles_error code;
+    uint8_t expected;
+    // character expected with EXPECTED_CHAR and character found instead
+    char expected_char;
+    char got;
+    size_t position;
+} parse_error;
+
+#ifdef PARSER_STATS
+// Grammar rules counted when built with PARSER_STATS, named in
+// parser_rule_names.
+typedef enum parser_rule {
+    RULE_ALIPHATIC_ORGANIC,
+    RULE_AROMATIC_ORGANIC,
+    RULE_ELEMENT_SYMBOL,
+    RULE_AROMATIC_SYMBOL,
+    RULE_CHAR,
+    RULE_NUMBER,
+    RULE_DIGIT,
+    RULE_OPTION,
+    RULE_BOND,
+    RULE_SYMBOL,
+    RULE_CHIRAL,
+    RULE_HCOUNT,
+    RULE_CHARGE,
+    RULE_CLASS,
+    RULE_BRACKET_ATOM,
+    RULE_ATOM,
+    RULE_RINGBOND,
+    RULE_BRANCHED_ATOM,
+    RULE_BRANCH,
+    RULE_CHAIN,
+    RULE_TERMINATOR,
+    RULE_SMILES,
+    RULE_COUNT
+} parser_rule;
+
+extern const char *parser_rule_names[RULE_COUNT];
+
+typedef struct rule_stats {
+    size_t calls;
+    size_t failures;
+    // times the input read by the rule was given back, and how many bytes
+    size_t backtracks;
+    size_t rescanned;
+    // arena allocations made by the rule itself, not by the rules it calls
+    size_t allocations;
+} rule_stats;
+
+// Work done by the parser, per rule.
+typedef struct parser_stats {
+    rule_stats rules[RULE_COUNT];
+    // deepest nesting of rule calls and of branches
+    size_t depth;
+    size_t max_depth;
+    size_t max_branch_depth;
+    // allocations already attributed to a rule
+    size_t counted_allocations;
+    // rule that returned last, the one an option rewinds
+    parser_rule last_rule;
+} parser_stats;
+#endif
 
 typedef struct parser_ctx {
     size_t buffer_len;
     size_t buffer_pos;
     char *buffer;
     bool errored;
-    char *error;
-    int no_error_message;
+    parse_error error;
+    // text of a SMILES_MESSAGE error
+    char *message;
+    arena arena;
+#ifdef PARSER_STATS
+    parser_stats stats;
+#endif
 } parser_ctx;
 
 typedef enum ASTElementType {
@@ -33,9 +129,52 @@ typedef enum ASTElementType {
     SMILES
 } ASTElementType;
 
+// Chirality of an atom in one byte: 0 for none, CHIRAL_ANTICLOCKWISE for @
+// and CHIRAL_CLOCKWISE for @@, then the numbers of each class one after the
+// other, @TH1 being CHIRAL_TH + 1 up to @OH30 being CHIRAL_OH + 30.
+typedef enum chirality {
+    CHIRAL_NONE = 0,
+    CHIRAL_ANTICLOCKWISE = 1,
+    CHIRAL_CLOCKWISE = 2,
+    CHIRAL_TH = 2,
+    CHIRAL_AL = 4,
+    CHIRAL_SP = 6,
+    CHIRAL_TB = 9,
+    CHIRAL_OH = 29,
+} chirality;
+
 typedef ASTElement (*ASTElementParser)(parser_ctx *ctx);
 
 parser_ctx init_ctx(char *buffer, size_t buffer_len);
+void free_ctx(parser_ctx *ctx);
+// Records a failure of the grammar at the current position.
+void fail(parser_ctx *ctx, smiles_error code, uint8_t expected, char expected_char);
+// Records a failure with a message, for the checks past the grammar.
+void error(parser_ctx *ctx, const char *message);
+// Forgets the failure recorded, for productions that rewind.
+void clear_error(parser_ctx *ctx);
+// Text of the failure recorded, NULL when there is none or when out of
+// memory. To be freed.
+char *error_message(const parser_ctx *ctx);
 ASTElement smile(parser_ctx *ctx);
 
+// Checks a SMILES against the grammar of smile() without allocating
+// anything. Returns a smiles_error code with the position smile() would
+// fail at, 0 when valid.
+Validation validate(char *buffer, size_t len);
+
+// Reads a SMILES into flat atom and bond records instead of a tree, with the
+// same grammar and errors as smile(). Atoms are in input order, the symbol
+// and number of a bracket atom already turned into its element, isotope,
+// chirality (see the chirality enum), hydrogens, charge and class, an
+// isotope or class too large for an int being -1. Atoms outside brackets
+// have hydrogens -1. Bonds are in input order too, each
+// written either between two atoms, begin then end, or as one end of a
+// ring bond, on atom begin with end -1 and ring its label, ring being -1
+// otherwise. symbol is '\0' for a bond without one and from is where the
+// bond is written: its symbol, its label or the atom it leads to. Ring
+// bonds are left unpaired, see build_graph(). Allocated in the arena of the
+// context.
+records parse_records(parser_ctx *ctx);
+
 #endif // PARSER_H
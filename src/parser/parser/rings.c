@@ -0,0 +1,489 @@
+#include "parser/rings.h"
+#include <stdint.h>
+
+// Depth first search frame of find_ring_bonds.
+typedef struct bridge_frame {
+    int atom;
+    int parent_bond;
+    int next;
+} bridge_frame;
+
+// Tarjan's bridge search, iterative so that long chains do not recurse.
+bool *find_ring_bonds(parser_ctx *ctx, const graph *g) {
+    size_t n = g->atoms_len;
+    bool *ring_bonds = arena_alloc(&ctx->arena, sizeof(bool) * (g->bonds_len + 1));
+    int *discovered = malloc(sizeof(int) * (n + 1));
+    int *low = malloc(sizeof(int) * (n + 1));
+    bridge_frame *stack = malloc(sizeof(bridge_frame) * (n + 1));
+    if (!ring_bonds || !discovered || !low || !stack) {
+        free(discovered);
+        free(low);
+        free(stack);
+        error(ctx, "Out of memory");
+        return NULL;
+    }
+    for (size_t i = 0; i < g->bonds_len; i++) {
+        ring_bonds[i] = true;
+    }
+    for (size_t i = 0; i < n; i++) {
+        discovered[i] = -1;
+    }
+    int time = 0;
+    for (size_t root = 0; root < n; root++) {
+        if (discovered[root] >= 0) {
+            continue;
+        }
+        size_t len = 0;
+        stack[len++] = (bridge_frame){.atom = root, .parent_bond = -1,
+                                      .next = g->adjacency_offsets[root]};
+        discovered[root] = low[root] = time++;
+        while (len > 0) {
+            bridge_frame *top = &stack[len - 1];
+            int atom = top->atom;
+            if (top->next < g->adjacency_offsets[atom + 1]) {
+                int k = top->next++;
+                int bond = g->adjacency_bonds[k];
+                int next = g->adjacency[k];
+                if (bond == top->parent_bond) {
+                    continue;
+                }
+                if (discovered[next] < 0) {
+                    discovered[next] = low[next] = time++;
+                    stack[len++] = (bridge_frame){.atom = next, .parent_bond = bond,
+                                                  .next = g->adjacency_offsets[next]};
+                } else if (discovered[next] < low[atom]) {
+                    low[atom] = discovered[next];
+                }
+                continue;
+            }
+            len--;
+            if (len > 0) {
+                int parent = stack[len - 1].atom;
+                if (low[atom] < low[parent]) {
+                    low[parent] = low[atom];
+                }
+                if (low[atom] > discovered[parent]) {
+                    ring_bonds[top->parent_bond] = false;
+                }
+            }
+        }
+    }
+    free(discovered);
+    free(low);
+    free(stack);
+    return ring_bonds;
+}
+
+// Candidate cycles of a ring system. Cycle i has the atoms atoms[offsets[i]]
+// to atoms[offsets[i + 1] - 1] in cyclic order, bonds[j] joining atoms[j] to
+// the atom after it, numbered within the system.
+typedef struct cycle_list {
+    int *atoms;
+    int *bonds;
+    int *offsets;
+    size_t len;
+    size_t items_capacity;
+    size_t offsets_capacity;
+} cycle_list;
+
+// State of the search of one ring system. Atoms and bonds of the system are
+// renumbered from 0 in breadth first order, atoms[i] and bonds[i] giving
+// back the graph indices. The basis keeps one row of bond bits per accepted
+// ring with its lowest bit as pivot, pivots[bit] is the row or -1.
+typedef struct sssr_search {
+    const graph *g;
+    const bool *ring_bonds;
+    int *local;
+    int *local_bonds;
+    int *atoms;
+    size_t atoms_len;
+    int *bonds;
+    size_t bonds_len;
+
+    int *dist;
+    int *parent;
+    int *parent_bond;
+    int *branch;
+    int *queue;
+    int *path;
+
+    size_t words;
+    uint64_t *rows;
+    uint64_t *bits;
+    int *pivots;
+    size_t rank;
+    cycle_list cycles;
+} sssr_search;
+
+// Makes room for element len as arena_grow() does, with realloc. Returns NULL
+// when out of memory, leaving array and capacity as they were.
+void *grow_scratch(void *array, size_t len, size_t *capacity, size_t size) {
+    if (len < *capacity) {
+        return array;
+    }
+    size_t grown_capacity = *capacity == 0 ? 64 : *capacity * 2;
+    void *grown = realloc(array, size * grown_capacity);
+    if (grown) {
+        *capacity = grown_capacity;
+    }
+    return grown;
+}
+
+// Collects the ring system holding atom root, numbering its atoms and bonds.
+void collect_ring_system(sssr_search *s, int root) {
+    const graph *g = s->g;
+    s->atoms_len = 0;
+    s->bonds_len = 0;
+    s->local[root] = 0;
+    s->atoms[s->atoms_len++] = root;
+    for (size_t head = 0; head < s->atoms_len; head++) {
+        int atom = s->atoms[head];
+        for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+            int bond = g->adjacency_bonds[k];
+            int next = g->adjacency[k];
+            if (!s->ring_bonds[bond]) {
+                continue;
+            }
+            if (s->local[next] < 0) {
+                s->local[next] = s->atoms_len;
+                s->atoms[s->atoms_len++] = next;
+            }
+            if (s->local_bonds[bond] < 0) {
+                s->local_bonds[bond] = s->bonds_len;
+                s->bonds[s->bonds_len++] = bond;
+            }
+        }
+    }
+}
+
+// Appends the cycle closed by the bond from x to y of the search tree,
+// through z when the cycle has an even length, to the candidates. Returns
+// false when out of memory.
+bool add_candidate(sssr_search *s, int x, int y, int z, int bond_xy, int bond_yz, int len) {
+    cycle_list *c = &s->cycles;
+    size_t start = c->len == 0 ? 0 : c->offsets[c->len];
+    while (start + len > c->items_capacity) {
+        size_t capacity = c->items_capacity;
+        int *grown_atoms = grow_scratch(c->atoms, capacity, &capacity, sizeof(int));
+        if (!grown_atoms) {
+            return false;
+        }
+        c->atoms = grown_atoms;
+        int *grown_bonds = realloc(c->bonds, sizeof(int) * capacity);
+        if (!grown_bonds) {
+            return false;
+        }
+        c->bonds = grown_bonds;
+        c->items_capacity = capacity;
+    }
+    int *grown_offsets = grow_scratch(c->offsets, c->len + 1, &c->offsets_capacity, sizeof(int));
+    if (!grown_offsets) {
+        return false;
+    }
+    c->offsets = grown_offsets;
+    if (c->len == 0) {
+        c->offsets[0] = 0;
+    }
+    int *atoms = &c->atoms[start];
+    int *bonds = &c->bonds[start];
+
+    // the root and the path down to x, then y and the way back up from y or z
+    int depth = s->dist[x];
+    for (int i = depth, atom = x; i >= 0; i--, atom = s->parent[atom]) {
+        atoms[i] = atom;
+        if (i > 0) {
+            bonds[i - 1] = s->parent_bond[atom];
+        }
+    }
+    int i = depth + 1;
+    bonds[depth] = bond_xy;
+    atoms[i++] = y;
+    int up = y;
+    if (z >= 0) {
+        bonds[i - 1] = bond_yz;
+        atoms[i++] = z;
+        up = z;
+    }
+    for (; s->dist[up] > 1; up = s->parent[up]) {
+        bonds[i - 1] = s->parent_bond[up];
+        atoms[i++] = s->parent[up];
+    }
+    bonds[i - 1] = s->parent_bond[up];
+    c->offsets[++c->len] = start + len;
+    return true;
+}
+
+// Breadth first search from the atom numbered root over the atoms numbered
+// after it, adding the cycles through root longer than min_len and up to
+// max_len. Restricting the search to later atoms finds every cycle once,
+// from its first atom, and still finds the relevant cycles (Vismara). Returns
+// false when out of memory, leaving the search to be abandoned.
+bool search_cycles(sssr_search *s, int root, int min_len, int max_len) {
+    const graph *g = s->g;
+    size_t tail = 0;
+    s->queue[tail++] = root;
+    s->dist[root] = 0;
+    s->parent[root] = -1;
+    s->branch[root] = root;
+    for (size_t head = 0; head < tail; head++) {
+        int atom = s->queue[head];
+        int global = s->atoms[atom];
+        int preds = 0;
+        for (int k = g->adjacency_offsets[global]; k < g->adjacency_offsets[global + 1]; k++) {
+            int bond = g->adjacency_bonds[k];
+            int next = s->local[g->adjacency[k]];
+            if (!s->ring_bonds[bond] || next < root) {
+                continue;
+            }
+            int local_bond = s->local_bonds[bond];
+            if (s->dist[next] < 0) {
+                if (2 * (s->dist[atom] + 1) - 1 <= max_len) {
+                    s->dist[next] = s->dist[atom] + 1;
+                    s->parent[next] = atom;
+                    s->parent_bond[next] = local_bond;
+                    s->branch[next] = atom == root ? next : s->branch[atom];
+                    s->queue[tail++] = next;
+                }
+                continue;
+            }
+            int len = 0;
+            if (s->dist[next] == s->dist[atom] && next < atom) {
+                len = 2 * s->dist[atom] + 1;
+                if (len > min_len && len <= max_len && s->branch[next] != s->branch[atom] &&
+                    !add_candidate(s, next, atom, -1, local_bond, -1, len)) {
+                    return false;
+                }
+            } else if (s->dist[next] == s->dist[atom] - 1 && s->dist[atom] > 1) {
+                // pairs of atoms one step closer to root close even cycles
+                len = 2 * s->dist[atom];
+                if (len > min_len && len <= max_len) {
+                    for (int p = 0; p < preds; p++) {
+                        int other = s->path[2 * p];
+                        if (s->branch[other] != s->branch[next] &&
+                            !add_candidate(s, other, atom, next, s->path[2 * p + 1], local_bond,
+                                           len)) {
+                            return false;
+                        }
+                    }
+                }
+                s->path[2 * preds] = next;
+                s->path[2 * preds + 1] = local_bond;
+                preds++;
+            }
+        }
+    }
+    for (size_t i = 0; i < tail; i++) {
+        s->dist[s->queue[i]] = -1;
+    }
+    return true;
+}
+
+// Gaussian elimination over GF(2) of the bond bits of a cycle against the
+// basis, 64 bonds at a time. Returns whether the cycle is independent of
+// the basis, in which case it is added to it.
+bool add_to_basis(sssr_search *s, const int *bonds, int len) {
+    uint64_t *bits = s->bits;
+    for (size_t w = 0; w < s->words; w++) {
+        bits[w] = 0;
+    }
+    for (int i = 0; i < len; i++) {
+        bits[bonds[i] / 64] |= (uint64_t)1 << (bonds[i] % 64);
+    }
+    for (size_t w = 0; w < s->words; w++) {
+        while (bits[w]) {
+            int bit = w * 64 + __builtin_ctzll(bits[w]);
+            int row = s->pivots[bit];
+            if (row < 0) {
+                uint64_t *dst = &s->rows[s->rank * s->words];
+                for (size_t k = 0; k < s->words; k++) {
+                    dst[k] = bits[k];
+                }
+                s->pivots[bit] = s->rank++;
+                return true;
+            }
+            const uint64_t *src = &s->rows[row * s->words];
+            for (size_t k = w; k < s->words; k++) {
+                bits[k] ^= src[k];
+            }
+        }
+    }
+    return false;
+}
+
+// Appends the candidate cycle at start to rings, the capacities being those of
+// its arrays. Returns false when out of memory.
+bool add_ring(parser_ctx *ctx, const sssr_search *s, ring_set *rings, size_t *atoms_capacity,
+              size_t *offsets_capacity, int start, int len) {
+    size_t atoms_len = rings->offsets[rings->len];
+    for (int i = 0; i < len; i++) {
+        rings->atoms =
+            arena_grow(&ctx->arena, rings->atoms, atoms_len, atoms_capacity, sizeof(int));
+        if (!rings->atoms) {
+            return false;
+        }
+        rings->atoms[atoms_len++] = s->atoms[s->cycles.atoms[start + i]];
+    }
+    rings->offsets =
+        arena_grow(&ctx->arena, rings->offsets, rings->len + 1, offsets_capacity, sizeof(int));
+    if (!rings->offsets) {
+        return false;
+    }
+    rings->offsets[++rings->len] = atoms_len;
+    return true;
+}
+
+// Adds the rings of the ring system just collected to rings. Returns false
+// when out of memory.
+bool add_system_rings(parser_ctx *ctx, sssr_search *s, ring_set *rings, size_t *atoms_capacity,
+                      size_t *offsets_capacity) {
+    // the cycle space has E - V + 1 dimensions, as many as the smallest set
+    // of smallest rings has rings
+    size_t nullity = s->bonds_len - s->atoms_len + 1;
+    s->words = (s->bonds_len + 63) / 64;
+    s->rows = malloc(sizeof(uint64_t) * nullity * s->words);
+    s->bits = malloc(sizeof(uint64_t) * s->words);
+    bool ok = s->rows && s->bits;
+    s->rank = 0;
+    for (size_t i = 0; i < s->bonds_len; i++) {
+        s->pivots[i] = -1;
+    }
+
+    // candidates are searched by growing lengths so that the small rings of
+    // large fused systems are found without enumerating the long cycles
+    for (int min_len = 2, max_len = 8; ok && s->rank < nullity;
+         min_len = max_len, max_len *= 2) {
+        s->cycles.len = 0;
+        for (size_t atom = 0; ok && atom < s->atoms_len; atom++) {
+            ok = search_cycles(s, atom, min_len, max_len);
+        }
+        // shortest first, in the order they were found
+        int *counts = calloc(max_len - min_len + 1, sizeof(int));
+        int *order = malloc(sizeof(int) * (s->cycles.len + 1));
+        ok = ok && counts && order;
+        if (ok) {
+            for (size_t c = 0; c < s->cycles.len; c++) {
+                counts[s->cycles.offsets[c + 1] - s->cycles.offsets[c] - min_len]++;
+            }
+            for (int len = 1; len <= max_len - min_len; len++) {
+                counts[len] += counts[len - 1];
+            }
+            for (size_t c = s->cycles.len; c-- > 0;) {
+                order[--counts[s->cycles.offsets[c + 1] - s->cycles.offsets[c] - min_len]] = c;
+            }
+        }
+        for (size_t c = 0; ok && c < s->cycles.len && s->rank < nullity; c++) {
+            int start = s->cycles.offsets[order[c]];
+            int len = s->cycles.offsets[order[c] + 1] - start;
+            if (add_to_basis(s, &s->cycles.bonds[start], len)) {
+                ok = add_ring(ctx, s, rings, atoms_capacity, offsets_capacity, start, len);
+            }
+        }
+        free(counts);
+        free(order);
+        if (max_len > 2 * (int)s->atoms_len) {
+            break;
+        }
+    }
+    free(s->rows);
+    free(s->bits);
+    return ok;
+}
+
+ring_set find_rings(parser_ctx *ctx, const graph *g, const bool *ring_bonds) {
+    if (ctx->errored) {
+        return (ring_set){0};
+    }
+    ring_set rings = {0};
+    size_t n = g->atoms_len;
+    size_t atoms_capacity = 0;
+    size_t offsets_capacity = 0;
+    rings.offsets = arena_grow(&ctx->arena, NULL, 0, &offsets_capacity, sizeof(int));
+
+    sssr_search s = {.g = g, .ring_bonds = ring_bonds};
+    s.local = malloc(sizeof(int) * (n + 1));
+    s.local_bonds = malloc(sizeof(int) * (g->bonds_len + 1));
+    s.atoms = malloc(sizeof(int) * (n + 1));
+    s.bonds = malloc(sizeof(int) * (g->bonds_len + 1));
+    s.dist = malloc(sizeof(int) * (n + 1));
+    s.parent = malloc(sizeof(int) * (n + 1));
+    s.parent_bond = malloc(sizeof(int) * (n + 1));
+    s.branch = malloc(sizeof(int) * (n + 1));
+    s.queue = malloc(sizeof(int) * (n + 1));
+    s.path = malloc(sizeof(int) * 2 * (n + 1));
+    s.pivots = malloc(sizeof(int) * (g->bonds_len + 1));
+    bool ok = rings.offsets && s.local && s.local_bonds && s.atoms && s.bonds && s.dist &&
+              s.parent && s.parent_bond && s.branch && s.queue && s.path && s.pivots;
+    if (ok) {
+        rings.offsets[0] = 0;
+        for (size_t i = 0; i < n; i++) {
+            s.local[i] = -1;
+            s.dist[i] = -1;
+        }
+        for (size_t i = 0; i < g->bonds_len; i++) {
+            s.local_bonds[i] = -1;
+        }
+    }
+
+    for (size_t root = 0; ok && root < n; root++) {
+        bool in_ring = false;
+        for (int k = g->adjacency_offsets[root]; k < g->adjacency_offsets[root + 1]; k++) {
+            in_ring |= ring_bonds[g->adjacency_bonds[k]];
+        }
+        if (!in_ring || s.local[root] >= 0) {
+            continue;
+        }
+        collect_ring_system(&s, root);
+        ok = add_system_rings(ctx, &s, &rings, &atoms_capacity, &offsets_capacity);
+    }
+    free(s.local);
+    free(s.local_bonds);
+    free(s.atoms);
+    free(s.bonds);
+    free(s.dist);
+    free(s.parent);
+    free(s.parent_bond);
+    free(s.branch);
+    free(s.queue);
+    free(s.path);
+    free(s.pivots);
+    free(s.cycles.atoms);
+    free(s.cycles.bonds);
+    free(s.cycles.offsets);
+    if (!ok) {
+        error(ctx, "Out of memory");
+        return (ring_set){0};
+    }
+    return rings;
+}
+
+atom_rings index_atom_rings(parser_ctx *ctx, size_t atoms_len, const ring_set *rings) {
+    atom_rings index = {0};
+    if (ctx->errored) {
+        return index;
+    }
+    index.offsets = arena_alloc(&ctx->arena, sizeof(int) * (atoms_len + 2));
+    if (!index.offsets) {
+        error(ctx, "Out of memory");
+        return (atom_rings){0};
+    }
+    for (size_t i = 0; i < atoms_len + 2; i++) {
+        index.offsets[i] = 0;
+    }
+    for (int i = 0; i < rings->offsets[rings->len]; i++) {
+        index.offsets[rings->atoms[i] + 2]++;
+    }
+    for (size_t i = 2; i < atoms_len + 2; i++) {
+        index.offsets[i] += index.offsets[i - 1];
+    }
+    index.rings = arena_alloc(&ctx->arena, sizeof(int) * (index.offsets[atoms_len + 1] + 1));
+    if (!index.rings) {
+        error(ctx, "Out of memory");
+        return (atom_rings){0};
+    }
+    for (size_t r = 0; r < rings->len; r++) {
+        for (int i = rings->offsets[r]; i < rings->offsets[r + 1]; i++) {
+            index.rings[index.offsets[rings->atoms[i] + 1]++] = r;
+        }
+    }
+    return index;
+}
@@ -0,0 +1,36 @@
+#ifndef RINGS_H
+#define RINGS_H
+
+#include "parser/graph.h"
+
+// Rings of a graph. Ring i lists its atoms in cyclic order from
+// atoms[offsets[i]] to atoms[offsets[i + 1] - 1].
+typedef struct ring_set {
+    int *atoms;
+    int *offsets;
+    size_t len;
+} ring_set;
+
+// Out of memory, these leave ctx errored and return NULL or an empty result.
+// find_rings() and index_atom_rings() return one as well once ctx has errored,
+// so that a caller checks ctx->errored after the last of them.
+
+// Marks the bonds lying on a cycle, every other bond is a bridge.
+bool *find_ring_bonds(parser_ctx *ctx, const graph *g);
+
+// Smallest set of smallest rings, as a minimum cycle basis of every ring
+// system: candidate cycles are taken shortest first and kept when their bonds
+// are independent of the rings already kept. Rings are grouped by ring system
+// and sorted by size within each.
+ring_set find_rings(parser_ctx *ctx, const graph *g, const bool *ring_bonds);
+
+// Rings holding each atom, atom i is in rings[offsets[i]] to
+// rings[offsets[i + 1] - 1].
+typedef struct atom_rings {
+    int *rings;
+    int *offsets;
+} atom_rings;
+
+atom_rings index_atom_rings(parser_ctx *ctx, size_t atoms_len, const ring_set *rings);
+
+#endif // RINGS_H
@@ -0,0 +1,36 @@
+#include "parser/text.h"
+
+char *write_string(char *out, const char *s) {
+    while (*s) {
+        *out++ = *s++;
+    }
+    *out = '\0';
+    return out;
+}
+
+char *write_long(char *out, long value) {
+    // the magnitude is taken unsigned so that LONG_MIN does not overflow
+    unsigned long magnitude = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    char digits[24];
+    int len = 0;
+    do {
+        digits[len++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        *out++ = '-';
+    }
+    while (len > 0) {
+        *out++ = digits[--len];
+    }
+    *out = '\0';
+    return out;
+}
+
+char *write_hex64(char *out, uint64_t value) {
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        *out++ = "0123456789abcdef"[(value >> shift) & 0xf];
+    }
+    *out = '\0';
+    return out;
+}
@@ -0,0 +1,15 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdint.h>
+
+// The few numbers and strings the parser prints, written without the printf
+// family so the module carries no formatter. Each writes its text and a NUL
+// at out and returns the position of that NUL, to be written over next.
+char *write_string(char *out, const char *s);
+// Decimal, with a leading '-' when negative.
+char *write_long(char *out, long value);
+// Sixteen lowercase hexadecimal digits.
+char *write_hex64(char *out, uint64_t value);
+
+#endif // TEXT_H
@@ -0,0 +1,20 @@
+#include "parser/tree.h"
+
+int push_children(tree_stack *stack, const ASTElement *elem) {
+    if (stack->len + elem->children_len > stack->capacity) {
+        size_t capacity = stack->capacity == 0 ? 64 : stack->capacity * 2;
+        while (capacity < stack->len + elem->children_len) {
+            capacity *= 2;
+        }
+        const ASTElement **items = realloc(stack->items, sizeof(*items) * capacity);
+        if (!items) {
+            return 1;
+        }
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+    for (size_t i = elem->children_len; i-- > 0;) {
+        stack->items[stack->len++] = &elem->children[i];
+    }
+    return 0;
+}
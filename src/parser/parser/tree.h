@@ -0,0 +1,18 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include "ast/protocol.h"
+
+// ASTElement trees can be arbitrarily deep, they are walked in pre-order with
+// this explicit stack rather than by recursing once per level.
+typedef struct tree_stack {
+    const ASTElement **items;
+    size_t len;
+    size_t capacity;
+} tree_stack;
+
+// Pushes the children of elem, the first one on top. Returns 1 when the stack
+// cannot grow, leaving it as it was.
+int push_children(tree_stack *stack, const ASTElement *elem);
+
+#endif // TREE_H
@@ -0,0 +1,41 @@
+#include "parser/valence.h"
+#include "parser/elements.h"
+
+int explicit_valence(const graph *g, int atom) {
+    int valence = g->atoms[atom].hydrogens > 0 ? g->atoms[atom].hydrogens : 0;
+    for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+        const Bond *bond = &g->bonds[g->adjacency_bonds[k]];
+        valence += bond->aromatic ? 1 : bond->order;
+    }
+    return valence;
+}
+
+bool needs_double_bond(const graph *g, int atom) {
+    const Atom *a = &g->atoms[atom];
+    if (!a->aromatic) {
+        return false;
+    }
+    int bonds = explicit_valence(g, atom);
+    return default_valence(a->element, a->charge, bonds) > bonds;
+}
+
+int default_hydrogens(const graph *g, int atom) {
+    const Atom *a = &g->atoms[atom];
+    int bonds = 0;
+    for (int k = g->adjacency_offsets[atom]; k < g->adjacency_offsets[atom + 1]; k++) {
+        const Bond *bond = &g->bonds[g->adjacency_bonds[k]];
+        bonds += bond->aromatic ? 1 : bond->order;
+    }
+    if (a->aromatic && default_valence(a->element, 0, bonds) > bonds) {
+        bonds++;
+    }
+    int valence = default_valence(a->element, 0, bonds);
+    return valence > bonds ? valence - bonds : 0;
+}
+
+void add_implicit_hydrogens(graph *g) {
+    for (size_t i = 0; i < g->atoms_len; i++) {
+        Atom *a = &g->atoms[i];
+        a->implicit_hydrogens = a->hydrogens < 0 ? default_hydrogens(g, i) : 0;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef VALENCE_H
+#define VALENCE_H
+
+#include "parser/graph.h"
+
+// Sum of the bond orders of an atom and of its explicit hydrogens, aromatic
+// bonds counting as single.
+int explicit_valence(const graph *g, int atom);
+
+// Whether an aromatic atom still has a valence free for a double bond once
+// its bonds and hydrogens are counted. Atoms of the organic subset fill the
+// rest with implicit hydrogens, so one free valence is enough.
+bool needs_double_bond(const graph *g, int atom);
+
+// Hydrogens the atom would get if written without brackets, from its bonds
+// and lowest default valence. Aromatic atoms needing a double bond count
+// it.
+int default_hydrogens(const graph *g, int atom);
+
+// Sets implicit_hydrogens on the atoms of the organic subset to their
+// default_hydrogens(). Bracket atoms get none.
+void add_implicit_hydrogens(graph *g);
+
+#endif // VALENCE_H
@@ -8,16 +8,18 @@
   ))
 }
 
-/// Decodes a big-endian integer from the given bytes.
-#let decode-int(bytes) = {
-  let result = 0
-  for byte in array(bytes.slice(0,4)) {
-    result = result * 256 + byte
-  }
+/// Decodes a big-endian integer from the given bytes at the given offset.
+#let decode-int(bytes, offset) = {
+  let result = (
+    bytes.at(offset) * 0x1000000
+      + bytes.at(offset + 1) * 0x10000
+      + bytes.at(offset + 2) * 0x100
+      + bytes.at(offset + 3)
+  )
   if (result > 2147483647) { // the number is negative
-    result = 2147483647 - result + 2147483647
+    result = result - 4294967296
   }
-  (result, 4)
+  (result, offset + 4)
 }
 
 /// Encodes a string into bytes.
@@ -25,21 +27,13 @@
 	bytes(value) + bytes((0x00,))
 }
 
-/// Decodes a string from the given bytes.
-#let decode-string(bytes) = {
-	let length = 0
-	for byte in array(bytes) {
-		length = length + 1
-		if byte == 0x00 {
-			break
-		}
-	}
-	if length == 0 {
-		("", 1)
-	} else { 
-		(str(bytes.slice(0, length - 1)), length)
+/// Decodes a NUL terminated string from the given bytes at the given offset.
+#let decode-string(bytes, offset) = {
+	let end = offset
+	while bytes.at(end) != 0x00 {
+		end += 1
 	}
-	//(array(bytes.slice(0, length - 1)), length)
+	(str(bytes.slice(offset, end)), end + 1)
 }
 
 /// Encodes a boolean into bytes
@@ -51,13 +45,9 @@
   }
 }
 
-/// Decodes a boolean from the given bytes
-#let decode-bool(bytes) = {
-  if bytes.at(0) == 0x00 {
-	(false, 1)
-  } else {
-	(true, 1)
-  }
+/// Decodes a boolean from the given bytes at the given offset
+#let decode-bool(bytes, offset) = {
+  (bytes.at(offset) != 0x00, offset + 1)
 }
 
 /// Encodes a character into bytes
@@ -65,9 +55,23 @@
   bytes(value)
 }
 
-/// Decodes a character from the given bytes
-#let decode-char(bytes) = {
-  (bytes.at(0), 1)
+/// Decodes a character from the given bytes at the given offset
+#let decode-char(bytes, offset) = {
+  (bytes.at(offset), offset + 1)
+}
+
+/// Encodes a signed byte into bytes
+#let encode-int8(value) = {
+  bytes((calc.rem(value + 256, 256),))
+}
+
+/// Decodes a signed byte from the given bytes at the given offset
+#let decode-int8(bytes, offset) = {
+  let result = bytes.at(offset)
+  if (result > 127) {
+    result = result - 256
+  }
+  (result, offset + 1)
 }
 
 #let fractional-to-binary(fractional_part, max_dec, zero) = {
@@ -151,15 +155,18 @@
 	encode-float(value.pt())
 }
 
-/// Decodes a float from the given bytes
-#let decode-float(bytes) = {
-	let (decoded, size) = decode-int(bytes)
-	(int-to-float(decoded), size)
+/// Decodes a float from the given bytes at the given offset
+#let decode-float(bytes, offset) = {
+	let (decoded, offset) = decode-int(bytes, offset)
+	if decoded < 0 { // int-to-float expects the unsigned bit pattern
+		decoded += 4294967296
+	}
+	(int-to-float(decoded), offset)
 }
 
-#let decode-point(bytes) = {
-	let (value, size) = decode-float(bytes)
-	(value * 1pt, size)
+#let decode-point(bytes, offset) = {
+	let (value, offset) = decode-float(bytes, offset)
+	(value * 1pt, offset)
 }
 
 /// Encodes a list of elements into bytes
@@ -169,30 +176,23 @@
 	length + encoded
 }
 
-/// Decodes a list of elements from the given bytes
-#let decode-list(bytes, decoder) = {
-	let (length, length_size) = decode-int(bytes)
+/// Decodes a list of elements from the given bytes at the given offset
+#let decode-list(bytes, offset, decoder) = {
+	let (length, offset) = decode-int(bytes, offset)
 	let result = ()
-	let offset = length_size
 	for i in range(0, length) {
-		let (element, size) = decoder(bytes.slice(offset, bytes.len()))
+		let (element, next-offset) = decoder(bytes, offset)
 		result.push(element)
-		offset += size
+		offset = next-offset
 	}
 	(result, offset)
 }
-#let decode-ASTElement(bytes) = {
-  let offset = 0
-  let (f_type, size) = decode-int(bytes.slice(offset, bytes.len()))
-  offset += size
-  let (f_from, size) = decode-int(bytes.slice(offset, bytes.len()))
-  offset += size
-  let (f_to, size) = decode-int(bytes.slice(offset, bytes.len()))
-  offset += size
-  let (f_value, size) = decode-string(bytes.slice(offset, bytes.len()))
-  offset += size
-  let (f_children, size) = decode-list(bytes.slice(offset, bytes.len()), decode-ASTElement)
-  offset += size
+#let decode-ASTElement(bytes, offset) = {
+  let (f_type, offset) = decode-int(bytes, offset)
+  let (f_from, offset) = decode-int(bytes, offset)
+  let (f_to, offset) = decode-int(bytes, offset)
+  let (f_value, offset) = decode-string(bytes, offset)
+  let (f_children, offset) = decode-list(bytes, offset, decode-ASTElement)
   ((
     type: f_type,
     from: f_from,
@@ -201,14 +201,197 @@
     children: f_children,
   ), offset)
 }
-#let decode-result(bytes) = {
-  let offset = 0
-  let (f_result, size) = decode-ASTElement(bytes.slice(offset, bytes.len()))
-  offset += size
+#let decode-AtomRecord(bytes, offset) = {
+  let (f_element, offset) = decode-char(bytes, offset)
+  let (f_aromatic, offset) = decode-char(bytes, offset)
+  let (f_chirality, offset) = decode-char(bytes, offset)
+  let (f_hydrogens, offset) = decode-int8(bytes, offset)
+  let (f_charge, offset) = decode-int8(bytes, offset)
+  let (f_isotope, offset) = decode-int(bytes, offset)
+  let (f_atom_class, offset) = decode-int(bytes, offset)
+  let (f_from, offset) = decode-int(bytes, offset)
+  let (f_to, offset) = decode-int(bytes, offset)
   ((
-    result: f_result,
+    element: f_element,
+    aromatic: f_aromatic,
+    chirality: f_chirality,
+    hydrogens: f_hydrogens,
+    charge: f_charge,
+    isotope: f_isotope,
+    atom_class: f_atom_class,
+    from: f_from,
+    to: f_to,
+  ), offset)
+}
+#let decode-BondRecord(bytes, offset) = {
+  let (f_begin, offset) = decode-int(bytes, offset)
+  let (f_end, offset) = decode-int(bytes, offset)
+  let (f_from, offset) = decode-int(bytes, offset)
+  let (f_symbol, offset) = decode-char(bytes, offset)
+  let (f_ring, offset) = decode-int8(bytes, offset)
+  ((
+    begin: f_begin,
+    end: f_end,
+    from: f_from,
+    symbol: f_symbol,
+    ring: f_ring,
+  ), offset)
+}
+#let decode-Atom(bytes, offset) = {
+  let (f_element, offset) = decode-char(bytes, offset)
+  let (f_aromatic, offset) = decode-char(bytes, offset)
+  let (f_implicit_hydrogens, offset) = decode-char(bytes, offset)
+  let (f_chirality, offset) = decode-char(bytes, offset)
+  let (f_isotope, offset) = decode-int(bytes, offset)
+  let (f_charge, offset) = decode-int(bytes, offset)
+  let (f_hydrogens, offset) = decode-int(bytes, offset)
+  let (f_atom_class, offset) = decode-int(bytes, offset)
+  let (f_from, offset) = decode-int(bytes, offset)
+  let (f_to, offset) = decode-int(bytes, offset)
+  let (f_x, offset) = decode-float(bytes, offset)
+  let (f_y, offset) = decode-float(bytes, offset)
+  ((
+    element: f_element,
+    aromatic: f_aromatic,
+    implicit_hydrogens: f_implicit_hydrogens,
+    chirality: f_chirality,
+    isotope: f_isotope,
+    charge: f_charge,
+    hydrogens: f_hydrogens,
+    atom_class: f_atom_class,
+    from: f_from,
+    to: f_to,
+    x: f_x,
+    y: f_y,
+  ), offset)
+}
+#let decode-Bond(bytes, offset) = {
+  let (f_begin, offset) = decode-int(bytes, offset)
+  let (f_end, offset) = decode-int(bytes, offset)
+  let (f_order, offset) = decode-char(bytes, offset)
+  let (f_aromatic, offset) = decode-char(bytes, offset)
+  let (f_symbol, offset) = decode-char(bytes, offset)
+  ((
+    begin: f_begin,
+    end: f_end,
+    order: f_order,
+    aromatic: f_aromatic,
+    symbol: f_symbol,
+  ), offset)
+}
+#let decode-Validation(bytes, offset) = {
+  let (f_code, offset) = decode-int(bytes, offset)
+  let (f_position, offset) = decode-int(bytes, offset)
+  ((
+    code: f_code,
+    position: f_position,
+  ), offset)
+}
+#let decode-RuleStats(bytes, offset) = {
+  let (f_rule, offset) = decode-string(bytes, offset)
+  let (f_calls, offset) = decode-int(bytes, offset)
+  let (f_failures, offset) = decode-int(bytes, offset)
+  let (f_backtracks, offset) = decode-int(bytes, offset)
+  let (f_rescanned, offset) = decode-int(bytes, offset)
+  let (f_allocations, offset) = decode-int(bytes, offset)
+  ((
+    rule: f_rule,
+    calls: f_calls,
+    failures: f_failures,
+    backtracks: f_backtracks,
+    rescanned: f_rescanned,
+    allocations: f_allocations,
   ), offset)
 }
 #let encode-parse(value) = {
   encode-string(value.at("smiles"))
 }
+#let encode-parse_batch(value) = {
+  encode-list(value.at("smiles"), encode-string)
+}
+#let decode-result(bytes, offset) = {
+  let (f_result, offset) = decode-ASTElement(bytes, offset)
+  ((
+    result: f_result,
+  ), offset)
+}
+#let decode-records(bytes, offset) = {
+  let (f_atoms, offset) = decode-list(bytes, offset, decode-AtomRecord)
+  let (f_bonds, offset) = decode-list(bytes, offset, decode-BondRecord)
+  ((
+    atoms: f_atoms,
+    bonds: f_bonds,
+  ), offset)
+}
+#let decode-graph(bytes, offset) = {
+  let (f_atoms, offset) = decode-list(bytes, offset, decode-Atom)
+  let (f_bonds, offset) = decode-list(bytes, offset, decode-Bond)
+  let (f_adjacency_offsets, offset) = decode-list(bytes, offset, decode-int)
+  let (f_adjacency, offset) = decode-list(bytes, offset, decode-int)
+  let (f_adjacency_bonds, offset) = decode-list(bytes, offset, decode-int)
+  ((
+    atoms: f_atoms,
+    bonds: f_bonds,
+    adjacency_offsets: f_adjacency_offsets,
+    adjacency: f_adjacency,
+    adjacency_bonds: f_adjacency_bonds,
+  ), offset)
+}
+#let decode-ring_membership(bytes, offset) = {
+  let (f_rings, offset) = decode-list(bytes, offset, decode-int)
+  let (f_ring_offsets, offset) = decode-list(bytes, offset, decode-int)
+  let (f_atom_rings, offset) = decode-list(bytes, offset, decode-int)
+  let (f_atom_ring_offsets, offset) = decode-list(bytes, offset, decode-int)
+  ((
+    rings: f_rings,
+    ring_offsets: f_ring_offsets,
+    atom_rings: f_atom_rings,
+    atom_ring_offsets: f_atom_ring_offsets,
+  ), offset)
+}
+#let decode-molecular_formula(bytes, offset) = {
+  let (f_formula, offset) = decode-string(bytes, offset)
+  let (f_exact_mass, offset) = decode-float(bytes, offset)
+  let (f_average_mass, offset) = decode-float(bytes, offset)
+  ((
+    formula: f_formula,
+    exact_mass: f_exact_mass,
+    average_mass: f_average_mass,
+  ), offset)
+}
+#let decode-canonical(bytes, offset) = {
+  let (f_smiles, offset) = decode-string(bytes, offset)
+  let (f_hash, offset) = decode-string(bytes, offset)
+  ((
+    smiles: f_smiles,
+    hash: f_hash,
+  ), offset)
+}
+#let decode-validation(bytes, offset) = {
+  let (f_result, offset) = decode-Validation(bytes, offset)
+  ((
+    result: f_result,
+  ), offset)
+}
+#let decode-validation_batch(bytes, offset) = {
+  let (f_results, offset) = decode-list(bytes, offset, decode-Validation)
+  ((
+    results: f_results,
+  ), offset)
+}
+#let decode-parse_stats(bytes, offset) = {
+  let (f_result, offset) = decode-Validation(bytes, offset)
+  let (f_rules, offset) = decode-list(bytes, offset, decode-RuleStats)
+  let (f_max_depth, offset) = decode-int(bytes, offset)
+  let (f_max_branch_depth, offset) = decode-int(bytes, offset)
+  let (f_allocations, offset) = decode-int(bytes, offset)
+  let (f_arena_bytes, offset) = decode-int(bytes, offset)
+  ((
+    result: f_result,
+    rules: f_rules,
+    max_depth: f_max_depth,
+    max_branch_depth: f_max_branch_depth,
+    allocations: f_allocations,
+    arena_bytes: f_arena_bytes,
+  ), offset)
+}
@@ -0,0 +1,859 @@
+// Generates the protocol between the plugin and Typst from its description:
+//   ./protocol_gen [-T templates] file.prot -c c_dir -t typst_dir
+// writes c_dir/protocol.h and c_dir/protocol.c, which encode what the plugin
+// sends and decode what it receives, and typst_dir/protocol.typ for the other
+// side. Each output is its template with @DEFINITIONS@ replaced by the code
+// of every struct and protocol, in the order of the description.
+//
+// The description is made of structs and protocols, the C ones sent by Typst
+// and the Typst ones sent back:
+//   struct Name { int a; string b; Name children[]; }
+//   protocol C name { string smiles; }
+//   protocol Typst name { Name result; int values[]; }
+// Fields are int, int8, char, bool, float, string or a struct, a list when
+// followed by []. char is a byte from 0 to 255 and int8 one from -128 to 127.
+// Lists are sent as a 4-byte count then their elements.
+//
+// Every structure is encoded in one pass into a buffer sized once. A struct
+// holding a list of itself, a tree, is walked with an explicit stack instead
+// of recursing once per level, so its list has to be its last field.
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAME_LEN 64
+#define MAX_FIELDS 32
+#define MAX_DECLS 64
+
+typedef enum field_kind {
+    FIELD_INT,
+    FIELD_INT8,
+    FIELD_CHAR,
+    FIELD_BOOL,
+    FIELD_FLOAT,
+    FIELD_STRING,
+    FIELD_STRUCT,
+} field_kind;
+
+typedef struct field {
+    field_kind kind;
+    // struct of a FIELD_STRUCT
+    char type[NAME_LEN];
+    char name[NAME_LEN];
+    bool list;
+} field;
+
+typedef enum decl_kind {
+    DECL_STRUCT,
+    // sent by Typst, decoded by the plugin
+    DECL_C,
+    // sent by the plugin, decoded by Typst
+    DECL_TYPST,
+} decl_kind;
+
+typedef struct decl {
+    decl_kind kind;
+    char name[NAME_LEN];
+    field fields[MAX_FIELDS];
+    size_t fields_len;
+    // index of the list of the struct itself, -1 when it is not a tree
+    int self_list;
+} decl;
+
+typedef struct description {
+    decl decls[MAX_DECLS];
+    size_t decls_len;
+} description;
+
+typedef struct lexer {
+    const char *path;
+    const char *text;
+    size_t pos;
+    int line;
+} lexer;
+
+void die(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "protocol_gen: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(1);
+}
+
+char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        die("cannot read %s", path);
+    }
+    size_t len = 0, capacity = 4096;
+    char *text = malloc(capacity);
+    size_t n;
+    while (text && (n = fread(text + len, 1, capacity - len - 1, f)) > 0) {
+        len += n;
+        if (len + 1 == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    fclose(f);
+    if (!text) {
+        die("out of memory reading %s", path);
+    }
+    text[len] = '\0';
+    return text;
+}
+
+void skip_space(lexer *lex) {
+    while (true) {
+        char c = lex->text[lex->pos];
+        if (c == '\n') {
+            lex->line++;
+        }
+        if (isspace((unsigned char)c)) {
+            lex->pos++;
+        } else if (c == '/' && lex->text[lex->pos + 1] == '/') {
+            while (lex->text[lex->pos] && lex->text[lex->pos] != '\n') {
+                lex->pos++;
+            }
+        } else {
+            return;
+        }
+    }
+}
+
+// Next word or punctuation character, an empty token at the end.
+void next_token(lexer *lex, char *token) {
+    skip_space(lex);
+    size_t len = 0;
+    const char *text = lex->text + lex->pos;
+    if (isalnum((unsigned char)text[0]) || text[0] == '_') {
+        while (isalnum((unsigned char)text[len]) || text[len] == '_') {
+            if (len == NAME_LEN - 1) {
+                die("%s:%d: name too long", lex->path, lex->line);
+            }
+            token[len] = text[len];
+            len++;
+        }
+    } else if (text[0]) {
+        token[len++] = text[0];
+    }
+    token[len] = '\0';
+    lex->pos += len;
+}
+
+void expect(lexer *lex, const char *expected) {
+    char token[NAME_LEN];
+    next_token(lex, token);
+    if (strcmp(token, expected) != 0) {
+        die("%s:%d: expected '%s', got '%s'", lex->path, lex->line, expected, token);
+    }
+}
+
+const decl *find_decl(const description *d, const char *name, decl_kind kind) {
+    for (size_t i = 0; i < d->decls_len; i++) {
+        if (d->decls[i].kind == kind && strcmp(d->decls[i].name, name) == 0) {
+            return &d->decls[i];
+        }
+    }
+    return NULL;
+}
+
+void parse_field(lexer *lex, const description *d, decl *out, const char *type) {
+    static const struct {
+        const char *name;
+        field_kind kind;
+    } scalars[] = {{"int", FIELD_INT},     {"int8", FIELD_INT8},    {"char", FIELD_CHAR},
+                   {"bool", FIELD_BOOL},   {"float", FIELD_FLOAT}, {"string", FIELD_STRING}};
+    if (out->fields_len == MAX_FIELDS) {
+        die("%s:%d: too many fields in %s", lex->path, lex->line, out->name);
+    }
+    field *f = &out->fields[out->fields_len++];
+    *f = (field){.kind = FIELD_STRUCT};
+    for (size_t i = 0; i < sizeof(scalars) / sizeof(scalars[0]); i++) {
+        if (strcmp(type, scalars[i].name) == 0) {
+            f->kind = scalars[i].kind;
+        }
+    }
+    if (f->kind == FIELD_STRUCT) {
+        bool self = out->kind == DECL_STRUCT && strcmp(type, out->name) == 0;
+        if (!self && !find_decl(d, type, DECL_STRUCT)) {
+            die("%s:%d: unknown type %s", lex->path, lex->line, type);
+        }
+        if (out->kind == DECL_C) {
+            die("%s:%d: structs cannot be sent by Typst", lex->path, lex->line);
+        }
+        strcpy(f->type, type);
+    }
+    next_token(lex, f->name);
+    if (!isalpha((unsigned char)f->name[0]) && f->name[0] != '_') {
+        die("%s:%d: expected a field name, got '%s'", lex->path, lex->line, f->name);
+    }
+    char token[NAME_LEN];
+    next_token(lex, token);
+    if (strcmp(token, "[") == 0) {
+        expect(lex, "]");
+        f->list = true;
+        next_token(lex, token);
+    }
+    if (strcmp(token, ";") != 0) {
+        die("%s:%d: expected ';', got '%s'", lex->path, lex->line, token);
+    }
+    if (f->kind == FIELD_STRUCT && strcmp(f->type, out->name) == 0) {
+        if (!f->list) {
+            die("%s:%d: %s can only hold itself in a list", lex->path, lex->line, out->name);
+        }
+        if (out->self_list >= 0) {
+            die("%s:%d: %s holds more than one list of itself", lex->path, lex->line,
+                out->name);
+        }
+        out->self_list = out->fields_len - 1;
+    }
+}
+
+void parse_description(lexer *lex, description *d) {
+    char token[NAME_LEN];
+    while (next_token(lex, token), token[0]) {
+        if (d->decls_len == MAX_DECLS) {
+            die("%s:%d: too many declarations", lex->path, lex->line);
+        }
+        decl *out = &d->decls[d->decls_len];
+        *out = (decl){.self_list = -1};
+        if (strcmp(token, "struct") == 0) {
+            out->kind = DECL_STRUCT;
+        } else if (strcmp(token, "protocol") == 0) {
+            next_token(lex, token);
+            if (strcmp(token, "C") == 0) {
+                out->kind = DECL_C;
+            } else if (strcmp(token, "Typst") == 0) {
+                out->kind = DECL_TYPST;
+            } else {
+                die("%s:%d: expected C or Typst, got '%s'", lex->path, lex->line, token);
+            }
+        } else {
+            die("%s:%d: expected struct or protocol, got '%s'", lex->path, lex->line, token);
+        }
+        next_token(lex, out->name);
+        expect(lex, "{");
+        while (next_token(lex, token), strcmp(token, "}") != 0) {
+            if (!token[0]) {
+                die("%s: %s is never closed", lex->path, out->name);
+            }
+            parse_field(lex, d, out, token);
+        }
+        if (out->self_list >= 0 && (size_t)out->self_list != out->fields_len - 1) {
+            die("%s: the list of %s in %s has to be its last field", lex->path, out->name,
+                out->name);
+        }
+        d->decls_len++;
+    }
+}
+
+// C
+
+// Type of a field in C, followed by the name of the field.
+const char *c_type(const field *f) {
+    switch (f->kind) {
+        case FIELD_INT:
+            return "int ";
+        case FIELD_INT8:
+            return "int8_t ";
+        case FIELD_CHAR:
+            return "char ";
+        case FIELD_BOOL:
+            return "bool ";
+        case FIELD_FLOAT:
+            return "float ";
+        case FIELD_STRING:
+            return "char *";
+        case FIELD_STRUCT:
+            break;
+    }
+    return NULL;
+}
+
+void write_typedef(FILE *out, const decl *d) {
+    fprintf(out, "typedef struct %s_t {\n", d->name);
+    for (size_t i = 0; i < d->fields_len; i++) {
+        const field *f = &d->fields[i];
+        const char *pointer = f->list ? "*" : "";
+        if (f->kind == FIELD_STRUCT) {
+            fprintf(out, "    struct %s_t %s%s;\n", f->type, pointer, f->name);
+        } else {
+            fprintf(out, "    %s%s%s;\n", c_type(f), pointer, f->name);
+        }
+        if (f->list) {
+            fprintf(out, "    size_t %s_len;\n", f->name);
+        }
+    }
+    fprintf(out, "} %s;\n", d->name);
+}
+
+void write_header(FILE *out, const description *desc) {
+    for (size_t i = 0; i < desc->decls_len; i++) {
+        const decl *d = &desc->decls[i];
+        if (i > 0) {
+            fprintf(out, "\n");
+        }
+        write_typedef(out, d);
+        fprintf(out, "void free_%s(%s *s);\n", d->name, d->name);
+        if (d->kind == DECL_TYPST) {
+            fprintf(out, "int encode_%s(const %s *s);\n", d->name, d->name);
+        } else if (d->kind == DECL_C) {
+            fprintf(out, "int decode_%s(size_t buffer_len, %s *out);\n", d->name, d->name);
+        }
+    }
+}
+
+// Size on the wire of a field of s, without the elements of the list of a
+// tree.
+void field_size(char *out, size_t len, const decl *d, const field *f) {
+    const char *n = f->name;
+    bool byte = f->kind == FIELD_INT8 || f->kind == FIELD_CHAR || f->kind == FIELD_BOOL;
+    if (f->list && (int)(f - d->fields) == d->self_list) {
+        snprintf(out, len, "TYPST_INT_SIZE");
+    } else if (f->list && byte) {
+        snprintf(out, len, "TYPST_INT_SIZE + s->%s_len", n);
+    } else if (f->list && f->kind == FIELD_STRING) {
+        snprintf(out, len, "TYPST_INT_SIZE + string_list_size(s->%s, s->%s_len)", n, n);
+    } else if (f->list && f->kind == FIELD_STRUCT) {
+        snprintf(out, len, "TYPST_INT_SIZE + list_size(s->%s, s->%s_len, %s_size, sizeof(*s->%s))",
+                 n, n, f->type, n);
+    } else if (f->list) {
+        snprintf(out, len, "TYPST_INT_SIZE + TYPST_INT_SIZE * s->%s_len", n);
+    } else if (byte) {
+        snprintf(out, len, "1");
+    } else if (f->kind == FIELD_STRING) {
+        snprintf(out, len, "string_size(s->%s)", n);
+    } else if (f->kind == FIELD_STRUCT) {
+        snprintf(out, len, "%s_size(&s->%s)", f->type, n);
+    } else {
+        snprintf(out, len, "TYPST_INT_SIZE");
+    }
+}
+
+// Returns the sum of the field sizes, wrapped at 100 columns.
+void write_size_expression(FILE *out, const decl *d) {
+    bool uses_s = false;
+    for (size_t i = 0; i < d->fields_len; i++) {
+        uses_s |= d->fields[i].list || d->fields[i].kind == FIELD_STRING ||
+                  d->fields[i].kind == FIELD_STRUCT;
+    }
+    if (!uses_s) {
+        fprintf(out, "    (void)s;\n");
+    }
+    // every field gives one or two terms, split on their " + "
+    char terms[MAX_FIELDS * 2][256];
+    size_t terms_len = 0;
+    for (size_t i = 0; i < d->fields_len; i++) {
+        char term[256];
+        field_size(term, sizeof(term), d, &d->fields[i]);
+        char *plus = strstr(term, " + ");
+        if (plus) {
+            *plus = '\0';
+            strcpy(terms[terms_len++], term);
+            strcpy(terms[terms_len++], plus + 3);
+        } else {
+            strcpy(terms[terms_len++], term);
+        }
+    }
+    size_t column = fprintf(out, "    return ");
+    for (size_t i = 0; i < terms_len; i++) {
+        // what follows the term on its line, " +" or ";"
+        size_t len = strlen(terms[i]) + (i + 1 == terms_len ? 1 : 2);
+        if (i > 0 && column + 1 + len > 100) {
+            column = fprintf(out, "\n           %s", terms[i]) - 1;
+        } else {
+            column += fprintf(out, "%s%s", i > 0 ? " " : "", terms[i]);
+        }
+        if (i + 1 < terms_len) {
+            column += fprintf(out, " +");
+        }
+    }
+    if (d->fields_len == 0) {
+        fprintf(out, "0");
+    }
+    fprintf(out, ";\n");
+}
+
+const char *pack_macro(field_kind kind) {
+    switch (kind) {
+        case FIELD_INT8:
+        case FIELD_CHAR:
+        case FIELD_BOOL:
+            return "CHAR_PACK";
+        case FIELD_FLOAT:
+            return "FLOAT_PACK";
+        case FIELD_STRING:
+            return "STR_PACK";
+        default:
+            return "INT_PACK";
+    }
+}
+
+// Packs the fields of s, running on_error when the encoder of a struct
+// fails. buffer_len is the name of the pointer to the buffer length.
+void write_packs(FILE *out, const decl *d, const char *buffer_len, const char *on_error) {
+    for (size_t i = 0; i < d->fields_len; i++) {
+        const field *f = &d->fields[i];
+        if (!f->list) {
+            if (f->kind == FIELD_STRUCT) {
+                fprintf(out,
+                        "    if ((err = encode_%s(&s->%s, __input_buffer, %s, "
+                        "&__buffer_offset))) {\n%s    }\n",
+                        f->type, f->name, buffer_len, on_error);
+            } else {
+                fprintf(out, "    %s(s->%s)\n", pack_macro(f->kind), f->name);
+            }
+            continue;
+        }
+        fprintf(out, "    INT_PACK(s->%s_len)\n", f->name);
+        if ((int)i == d->self_list) {
+            continue;
+        }
+        fprintf(out, "    for (size_t i = 0; i < s->%s_len; i++) {\n", f->name);
+        if (f->kind == FIELD_STRUCT) {
+            fprintf(out,
+                    "        if ((err = encode_%s(&s->%s[i], __input_buffer, %s, "
+                    "&__buffer_offset))) {\n",
+                    f->type, f->name, buffer_len);
+            // indented one level more
+            for (const char *line = on_error; *line;) {
+                const char *end = strchr(line, '\n');
+                fprintf(out, "    %.*s\n", (int)(end - line), line);
+                line = end + 1;
+            }
+            fprintf(out, "        }\n");
+        } else {
+            fprintf(out, "        %s(s->%s[i])\n", pack_macro(f->kind), f->name);
+        }
+        fprintf(out, "    }\n");
+    }
+}
+
+// Frees the fields of s, but for the list of a tree, each line starting with
+// indent.
+void write_free(FILE *out, const decl *d, const char *indent) {
+    for (size_t i = 0; i < d->fields_len; i++) {
+        const field *f = &d->fields[i];
+        if ((int)i == d->self_list) {
+            continue;
+        }
+        if (f->list && (f->kind == FIELD_STRING || f->kind == FIELD_STRUCT)) {
+            fprintf(out, "%sfor (size_t i = 0; i < s->%s_len; i++) {\n", indent, f->name);
+            if (f->kind == FIELD_STRING) {
+                fprintf(out, "%s    free(s->%s[i]);\n", indent, f->name);
+            } else {
+                fprintf(out, "%s    free_%s(&s->%s[i]);\n", indent, f->type, f->name);
+            }
+            fprintf(out, "%s}\n", indent);
+        }
+        if (f->list || f->kind == FIELD_STRING) {
+            fprintf(out, "%sfree(s->%s);\n", indent, f->name);
+        } else if (f->kind == FIELD_STRUCT) {
+            fprintf(out, "%sfree_%s(&s->%s);\n", indent, f->type, f->name);
+        }
+    }
+}
+
+void write_struct(FILE *out, const decl *d) {
+    const char *n = d->name;
+    fprintf(out, "void free_%s(%s *s) {\n", n, n);
+    write_free(out, d, "    ");
+    fprintf(out, "}\n\n");
+    fprintf(out, "size_t %s_size(const void *p) {\n    const %s *s = p;\n", n, n);
+    write_size_expression(out, d);
+    fprintf(out, "}\n\n");
+    fprintf(out,
+            "int encode_%s(const %s *s, uint8_t *__input_buffer, size_t *buffer_len, "
+            "size_t *buffer_offset) {\n",
+            n, n);
+    fprintf(out, "    size_t __buffer_offset = *buffer_offset;\n");
+    fprintf(out, "    if (__buffer_offset + %s_size(s) > *buffer_len) {\n", n);
+    fprintf(out, "        return 2;\n    }\n    int err;\n    (void)err;\n");
+    write_packs(out, d, "buffer_len", "        return err;\n");
+    fprintf(out, "    *buffer_offset = __buffer_offset;\n    return 0;\n}\n\n");
+}
+
+// A struct holding a list of itself is sized, encoded and freed one element
+// at a time, its list being walked in pre-order with an explicit stack.
+void write_tree(FILE *out, const decl *d) {
+    const char *n = d->name;
+    const char *children = d->fields[d->self_list].name;
+    fprintf(out,
+            "// %s trees can be arbitrarily deep, they are walked in pre-order with\n"
+            "// this explicit stack rather than by recursing once per level.\n"
+            "typedef struct %s_stack {\n"
+            "    const %s **items;\n"
+            "    size_t len;\n"
+            "    size_t capacity;\n"
+            "} %s_stack;\n\n",
+            n, n, n, n);
+    fprintf(out,
+            "static int push_%s_%s(%s_stack *stack, const %s *s) {\n"
+            "    if (stack->len + s->%s_len > stack->capacity) {\n"
+            "        size_t capacity = stack->capacity == 0 ? 64 : stack->capacity * 2;\n"
+            "        while (capacity < stack->len + s->%s_len) {\n"
+            "            capacity *= 2;\n"
+            "        }\n"
+            "        const %s **items = realloc(stack->items, sizeof(*items) * capacity);\n"
+            "        if (!items) {\n"
+            "            return 1;\n"
+            "        }\n"
+            "        stack->items = items;\n"
+            "        stack->capacity = capacity;\n"
+            "    }\n"
+            "    // pushed in reverse so that the first one is popped first\n"
+            "    for (size_t i = s->%s_len; i-- > 0;) {\n"
+            "        stack->items[stack->len++] = &s->%s[i];\n"
+            "    }\n"
+            "    return 0;\n"
+            "}\n\n",
+            n, children, n, n, children, children, n, children, children);
+
+    // the elements of a list are copied to the stack so that the list can be
+    // freed as soon as it is reached
+    fprintf(out,
+            "void free_%s(%s *root) {\n"
+            "    %s *stack = NULL;\n"
+            "    size_t len = 0, capacity = 0;\n"
+            "    %s element = *root;\n"
+            "    %s *s = &element;\n"
+            "    while (true) {\n",
+            n, n, n, n, n);
+    write_free(out, d, "        ");
+    fprintf(out,
+            "        if (len + s->%s_len > capacity) {\n"
+            "            capacity = (len + s->%s_len) * 2;\n"
+            "            %s *grown = realloc(stack, sizeof(*stack) * capacity);\n"
+            "            if (!grown) {\n"
+            "                // what is left cannot be reached any more\n"
+            "                break;\n"
+            "            }\n"
+            "            stack = grown;\n"
+            "        }\n"
+            "        if (s->%s_len > 0) {\n"
+            "            memcpy(stack + len, s->%s, sizeof(*stack) * s->%s_len);\n"
+            "            len += s->%s_len;\n"
+            "        }\n"
+            "        free(s->%s);\n"
+            "        if (len == 0) {\n"
+            "            break;\n"
+            "        }\n"
+            "        element = stack[--len];\n"
+            "    }\n"
+            "    free(stack);\n"
+            "}\n\n",
+            children, children, n, children, children, children, children, children);
+
+    fprintf(out, "static size_t %s_header_size(const %s *s) {\n", n, n);
+    write_size_expression(out, d);
+    fprintf(out, "}\n\n");
+    fprintf(out,
+            "size_t %s_size(const void *p) {\n"
+            "    const %s *s = p;\n"
+            "    size_t result = 0;\n"
+            "    %s_stack stack = {0};\n"
+            "    while (s) {\n"
+            "        result += %s_header_size(s);\n"
+            "        if (push_%s_%s(&stack, s)) {\n"
+            "            result = 0;\n"
+            "            break;\n"
+            "        }\n"
+            "        s = stack.len > 0 ? stack.items[--stack.len] : NULL;\n"
+            "    }\n"
+            "    free(stack.items);\n"
+            "    return result;\n"
+            "}\n\n",
+            n, n, n, n, n, children);
+
+    // every element but its list, whose length only is written
+    fprintf(out,
+            "static int encode_%s_header(const %s *s, uint8_t *__input_buffer, "
+            "size_t *buffer_len, size_t *buffer_offset) {\n"
+            "    size_t __buffer_offset = *buffer_offset;\n"
+            "    if (__buffer_offset + %s_header_size(s) > *buffer_len) {\n"
+            "        return 2;\n"
+            "    }\n"
+            "    int err;\n"
+            "    (void)err;\n",
+            n, n, n);
+    write_packs(out, d, "buffer_len", "        return err;\n");
+    fprintf(out, "    *buffer_offset = __buffer_offset;\n    return 0;\n}\n\n");
+    fprintf(out,
+            "int encode_%s(const %s *s, uint8_t *__input_buffer, size_t *buffer_len, "
+            "size_t *buffer_offset) {\n"
+            "    %s_stack stack = {0};\n"
+            "    int err = 0;\n"
+            "    while (s) {\n"
+            "        if ((err = encode_%s_header(s, __input_buffer, buffer_len, "
+            "buffer_offset))) {\n"
+            "            break;\n"
+            "        }\n"
+            "        if (push_%s_%s(&stack, s)) {\n"
+            "            err = 1;\n"
+            "            break;\n"
+            "        }\n"
+            "        s = stack.len > 0 ? stack.items[--stack.len] : NULL;\n"
+            "    }\n"
+            "    free(stack.items);\n"
+            "    return err;\n"
+            "}\n\n",
+            n, n, n, n, n, children);
+}
+
+void write_encoder(FILE *out, const decl *d) {
+    const char *n = d->name;
+    fprintf(out, "void free_%s(%s *s) {\n", n, n);
+    write_free(out, d, "    ");
+    fprintf(out, "}\n\n");
+    fprintf(out, "size_t %s_size(const void *p) {\n    const %s *s = p;\n", n, n);
+    write_size_expression(out, d);
+    fprintf(out, "}\n\n");
+    fprintf(out,
+            "int encode_%s(const %s *s) {\n"
+            "    size_t buffer_len = %s_size(s);\n"
+            "    INIT_BUFFER_PACK(buffer_len)\n"
+            "    int err;\n"
+            "    (void)err;\n",
+            n, n, n);
+    write_packs(out, d, "&buffer_len", "        FREE_BUFFER()\n        return err;\n");
+    fprintf(out, "    wasm_minimal_protocol_send_result_to_host(__input_buffer, buffer_len);\n"
+                 "    FREE_BUFFER()\n"
+                 "    return 0;\n"
+                 "}\n\n");
+}
+
+const char *next_macro(field_kind kind) {
+    switch (kind) {
+        case FIELD_INT8:
+        case FIELD_CHAR:
+        case FIELD_BOOL:
+            return "NEXT_CHAR";
+        case FIELD_FLOAT:
+            return "NEXT_FLOAT";
+        case FIELD_STRING:
+            return "NEXT_STR";
+        default:
+            return "NEXT_INT";
+    }
+}
+
+void write_decoder(FILE *out, const decl *d) {
+    const char *n = d->name;
+    fprintf(out, "void free_%s(%s *s) {\n", n, n);
+    write_free(out, d, "    ");
+    fprintf(out, "}\n\n");
+    fprintf(out, "int decode_%s(size_t buffer_len, %s *out) {\n", n, n);
+    fprintf(out, "    INIT_BUFFER_UNPACK(buffer_len)\n");
+    for (size_t i = 0; i < d->fields_len; i++) {
+        const field *f = &d->fields[i];
+        const char *macro = next_macro(f->kind);
+        if (!f->list) {
+            fprintf(out, "    %s(out->%s)\n", macro, f->name);
+            continue;
+        }
+        fprintf(out,
+                "    NEXT_INT(out->%s_len)\n"
+                "    out->%s = calloc(out->%s_len, sizeof(*out->%s));\n"
+                "    if (out->%s_len && !out->%s) {\n"
+                "        FREE_BUFFER()\n"
+                "        return 1;\n"
+                "    }\n"
+                "    for (size_t i = 0; i < out->%s_len; i++) {\n"
+                "        %s(out->%s[i])\n"
+                "    }\n",
+                f->name, f->name, f->name, f->name, f->name, f->name, f->name, macro, f->name);
+    }
+    fprintf(out, "    FREE_BUFFER()\n    return 0;\n}\n\n");
+}
+
+void write_source(FILE *out, const description *desc) {
+    for (size_t i = 0; i < desc->decls_len; i++) {
+        const decl *d = &desc->decls[i];
+        switch (d->kind) {
+            case DECL_STRUCT:
+                if (d->self_list >= 0) {
+                    write_tree(out, d);
+                } else {
+                    write_struct(out, d);
+                }
+                break;
+            case DECL_TYPST:
+                write_encoder(out, d);
+                break;
+            case DECL_C:
+                write_decoder(out, d);
+                break;
+        }
+    }
+}
+
+// Typst
+
+const char *typst_type(const field *f) {
+    switch (f->kind) {
+        case FIELD_INT:
+            return "int";
+        case FIELD_INT8:
+            return "int8";
+        case FIELD_CHAR:
+            return "char";
+        case FIELD_BOOL:
+            return "bool";
+        case FIELD_FLOAT:
+            return "float";
+        case FIELD_STRING:
+            return "string";
+        case FIELD_STRUCT:
+            return f->type;
+    }
+    return NULL;
+}
+
+void write_typst(FILE *out, const description *desc) {
+    for (size_t i = 0; i < desc->decls_len; i++) {
+        const decl *d = &desc->decls[i];
+        if (d->kind == DECL_C) {
+            fprintf(out, "#let encode-%s(value) = {\n  ", d->name);
+            for (size_t j = 0; j < d->fields_len; j++) {
+                const field *f = &d->fields[j];
+                if (j > 0) {
+                    fprintf(out, " + ");
+                }
+                if (f->list) {
+                    fprintf(out, "encode-list(value.at(\"%s\"), encode-%s)", f->name,
+                            typst_type(f));
+                } else {
+                    fprintf(out, "encode-%s(value.at(\"%s\"))", typst_type(f), f->name);
+                }
+            }
+            fprintf(out, "\n}\n");
+            continue;
+        }
+        fprintf(out, "#let decode-%s(bytes, offset) = {\n", d->name);
+        for (size_t j = 0; j < d->fields_len; j++) {
+            const field *f = &d->fields[j];
+            if (f->list) {
+                fprintf(out, "  let (f_%s, offset) = decode-list(bytes, offset, decode-%s)\n",
+                        f->name, typst_type(f));
+            } else {
+                fprintf(out, "  let (f_%s, offset) = decode-%s(bytes, offset)\n", f->name,
+                        typst_type(f));
+            }
+        }
+        fprintf(out, "  ((\n");
+        for (size_t j = 0; j < d->fields_len; j++) {
+            fprintf(out, "    %s: f_%s,\n", d->fields[j].name, d->fields[j].name);
+        }
+        fprintf(out, "  ), offset)\n}\n");
+    }
+}
+
+// Writes a line of code, broken after the last ", " that keeps it within 100
+// columns and continued under the parenthesis left open there.
+void write_line(FILE *out, const char *line, size_t len) {
+    // columns of the open parentheses
+    size_t open[32], depth = 0;
+    // where the current output line starts in line, and at which column
+    size_t start = 0, start_column = 0;
+    // last place to break the current output line, after its ", "
+    size_t split = 0, split_depth = 0;
+    for (size_t i = 0; i < len; i++) {
+        size_t column = start_column + i - start;
+        if (column >= 100 && split > start) {
+            fprintf(out, "%.*s\n", (int)(split - start - 1), line + start);
+            start_column = open[split_depth - 1] + 1;
+            fprintf(out, "%*s", (int)start_column, "");
+            start = i = split;
+            depth = split_depth;
+            column = start_column;
+        }
+        if (line[i] == '(' && depth < 32) {
+            open[depth++] = column;
+        } else if (line[i] == ')' && depth > 0) {
+            depth--;
+        } else if (line[i] == ',' && i + 1 < len && line[i + 1] == ' ' && depth > 0) {
+            split = i + 2;
+            split_depth = depth;
+        }
+    }
+    fprintf(out, "%.*s\n", (int)(len - start), line + start);
+}
+
+// Writes path from its template, the definitions written by write in place
+// of the @DEFINITIONS@ line.
+void generate(const char *path, const char *template_path,
+              void (*write)(FILE *, const description *), const description *desc) {
+    char *template = read_file(template_path);
+    char *marker = strstr(template, "@DEFINITIONS@\n");
+    if (!marker) {
+        die("%s has no @DEFINITIONS@ line", template_path);
+    }
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        die("cannot write %s", path);
+    }
+    fwrite(template, 1, marker - template, out);
+    char *definitions = NULL;
+    size_t definitions_len = 0;
+    FILE *buffer = open_memstream(&definitions, &definitions_len);
+    write(buffer, desc);
+    fclose(buffer);
+    for (const char *line = definitions; *line;) {
+        const char *end = strchr(line, '\n');
+        write_line(out, line, end - line);
+        line = end + 1;
+    }
+    free(definitions);
+    fputs(marker + strlen("@DEFINITIONS@\n"), out);
+    if (fclose(out) != 0) {
+        die("cannot write %s", path);
+    }
+    free(template);
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL, *c_dir = NULL, *typst_dir = NULL, *templates = "protogen";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            c_dir = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            typst_dir = argv[++i];
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            templates = argv[++i];
+        } else if (!input && argv[i][0] != '-') {
+            input = argv[i];
+        } else {
+            die("usage: protocol_gen [-T templates] file.prot [-c c_dir] [-t typst_dir]");
+        }
+    }
+    if (!input) {
+        die("usage: protocol_gen [-T templates] file.prot [-c c_dir] [-t typst_dir]");
+    }
+
+    static description desc;
+    lexer lex = {.path = input, .text = read_file(input), .line = 1};
+    parse_description(&lex, &desc);
+
+    char path[4096], template_path[4096];
+    if (c_dir) {
+        snprintf(path, sizeof(path), "%s/protocol.h", c_dir);
+        snprintf(template_path, sizeof(template_path), "%s/protocol.h.in", templates);
+        generate(path, template_path, write_header, &desc);
+        snprintf(path, sizeof(path), "%s/protocol.c", c_dir);
+        snprintf(template_path, sizeof(template_path), "%s/protocol.c.in", templates);
+        generate(path, template_path, write_source, &desc);
+    }
+    if (typst_dir) {
+        snprintf(path, sizeof(path), "%s/protocol.typ", typst_dir);
+        snprintf(template_path, sizeof(template_path), "%s/protocol.typ.in", templates);
+        generate(path, template_path, write_typst, &desc);
+    }
+    free((char *)lex.text);
+    return 0;
+}
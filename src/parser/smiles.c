@@ -1,51 +1,588 @@
 #include "ast/protocol.h"
+#include "parser/aromatic.h"
+#include "parser/canon.h"
+#include "parser/cbor.h"
+#include "parser/compact.h"
+#include "parser/depict.h"
+#include "parser/formula.h"
+#include "parser/graph.h"
+#include "parser/kekule.h"
 #include "parser/parser.h"
-#include <stdio.h>
+#include "parser/rings.h"
+#include "parser/text.h"
 
-#define DEBUG(fmt, ...)                                                                            \
-    char buf[1000];                                                                                \
-    sprintf(buf, fmt, __VA_ARGS__);                                                                \
-    wasm_minimal_protocol_send_result_to_host((uint8_t *)buf, strlen(buf));                        \
+void send_error(char *error) {
+    wasm_minimal_protocol_send_result_to_host((uint8_t *)error, strlen(error));
+}
+
+// Formats the error of a failed parse with a caret under the failing position.
+// Without the memory for the message only "Failed to parse" is given, NULL
+// when even that cannot be allocated.
+char *format_error(const parser_ctx *ctx, const char *smiles) {
+    char *message = error_message(ctx);
+    size_t position = ctx->error.position;
+    char *error = message ? malloc(strlen(message) + strlen(smiles) + position + 22) : NULL;
+    if (!error) {
+        free(message);
+        error = malloc(sizeof("Failed to parse"));
+        if (error) {
+            strcpy(error, "Failed to parse");
+        }
+        return error;
+    }
+    strcpy(error, "Failed to parse: ");
+    strcat(error, message);
+    strcat(error, "\n");
+    strcat(error, smiles);
+    strcat(error, "\n");
+    free(message);
+    size_t len = strlen(error);
+    for (size_t i = 0; i < position; i++) {
+        error[len++] = ' ';
+    }
+    error[len++] = '^';
+    error[len] = '\0';
+    return error;
+}
+
+// Copies the arguments of an export into a buffer with one more NUL after
+// them, so that the strings they hold can be read where they lie, a last one
+// missing its terminator included. NULL when out of memory.
+char *read_args(size_t buffer_len) {
+    char *args = malloc(buffer_len + 1);
+    if (!args) {
+        return NULL;
+    }
+    wasm_minimal_protocol_write_args_to_buffer((uint8_t *)args);
+    args[buffer_len] = '\0';
+    return args;
+}
+
+// Strings of parse_batch arguments read in place: a 4-byte big-endian count
+// then the NUL terminated strings.
+typedef struct batch_reader {
+    char *args;
+    size_t args_len;
+    size_t offset;
+    size_t len;
+} batch_reader;
+
+// Reads the arguments of a batch export. On failure the error is sent to
+// the host.
+int read_batch(size_t buffer_len, batch_reader *r) {
+    *r = (batch_reader){.args = read_args(buffer_len), .args_len = buffer_len};
+    if (r->args && buffer_len >= TYPST_INT_SIZE) {
+        for (size_t i = 0; i < TYPST_INT_SIZE; i++) {
+            r->len = r->len << 8 | (uint8_t)r->args[i];
+        }
+        r->offset = TYPST_INT_SIZE;
+        if (r->len <= buffer_len) {
+            return 0;
+        }
+    }
+    free(r->args);
+    send_error("Failed to decode parse_batch");
+    return 1;
+}
+
+// Next string of the batch and its length, NULL when the arguments end
+// before it.
+char *next_batch_smiles(batch_reader *r, size_t *len) {
+    if (r->offset >= r->args_len) {
+        return NULL;
+    }
+    char *smiles = r->args + r->offset;
+    *len = strlen(smiles);
+    r->offset += *len + 1;
+    return smiles;
+}
+
+// Sends the error of a failed parse and frees everything.
+int send_parse_error(char *args, parser_ctx *ctx) {
+    char *error = format_error(ctx, ctx->buffer);
+    send_error(error ? error : "Failed to parse");
+    free(error);
+    free_ctx(ctx);
+    free(args);
     return 1;
+}
+
+// Length of the string of parse arguments, those without their terminator.
+size_t args_smiles_len(const char *args, size_t buffer_len) {
+    return args[buffer_len - 1] == '\0' ? buffer_len - 1 : buffer_len;
+}
+
+// Reads the parse arguments the host wrote into a context on them. On
+// failure the error is sent to the host.
+int read_input(size_t buffer_len, char **args, parser_ctx *ctx) {
+    *args = read_args(buffer_len);
+    if (!*args || buffer_len == 0) {
+        free(*args);
+        send_error("Failed to decode parse");
+        return 1;
+    }
+    *ctx = init_ctx(*args, args_smiles_len(*args, buffer_len));
+    return 0;
+}
+
+// Parses the SMILES of parse arguments where the host wrote it. On failure
+// the error is sent to the host and everything is already freed.
+int parse_input(size_t buffer_len, char **args, parser_ctx *ctx, ASTElement *elem) {
+    if (read_input(buffer_len, args, ctx)) {
+        return 1;
+    }
+    *elem = smile(ctx);
+    if (!ctx->errored) {
+        return 0;
+    }
+    return send_parse_error(*args, ctx);
+}
+
+// Same as parse_input for the records of parse_records, which the graph
+// exports build on without a syntax tree.
+int parse_records_input(size_t buffer_len, char **args, parser_ctx *ctx, records *r) {
+    if (read_input(buffer_len, args, ctx)) {
+        return 1;
+    }
+    *r = parse_records(ctx);
+    if (!ctx->errored) {
+        return 0;
+    }
+    return send_parse_error(*args, ctx);
+}
 
 EMSCRIPTEN_KEEPALIVE
 int parse_smiles(size_t buffer_len) {
-    parse p;
-    if (decode_parse(buffer_len, &p)) {
-        char *error = "Failed to decode parse";
-        wasm_minimal_protocol_send_result_to_host((uint8_t *)error, strlen(error));
-        return 1;
-    }
-    parser_ctx ctx = init_ctx(p.smiles, strlen(p.smiles));
-    ASTElement elem = smile(&ctx);
-    free_parse(&p);
-    if (ctx.errored) {
-        if (ctx.error) {
-            char *error = malloc(strlen(ctx.error) + strlen(p.smiles) * 2 + 20);
-            sprintf(error, "Failed to parse: %s\n%s\n", ctx.error, p.smiles);
-            size_t len = strlen(error);
-            for (int i = 0; i < ctx.buffer_pos; i++) {
-                error[len++] = ' ';
-            }
-            error[len++] = '^';
-            error[len] = '\0';
-
-            wasm_minimal_protocol_send_result_to_host((uint8_t *)error, len);
-            free(ctx.error);
+    char *args;
+    parser_ctx ctx;
+    ASTElement elem;
+    if (parse_input(buffer_len, &args, &ctx, &elem)) {
+        return 1;
+    }
+
+    result r = {.result = elem};
+    int err = encode_result(&r);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int parse_smiles_cbor(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    ASTElement elem;
+    if (parse_input(buffer_len, &args, &ctx, &elem)) {
+        return 1;
+    }
+
+    cbor_buffer out = init_cbor(CBOR_MIN_CAPACITY);
+    cbor_ASTElement(&out, &elem);
+    free_ctx(&ctx);
+    free(args);
+    if (out.failed) {
+        free_cbor(&out);
+        send_error("Failed to encode result");
+        return 1;
+    }
+    wasm_minimal_protocol_send_result_to_host(out.data, out.len);
+    free_cbor(&out);
+    return 0;
+}
+
+// Same tree as parse_smiles in the compact encoding of compact_ASTElement,
+// several times smaller.
+EMSCRIPTEN_KEEPALIVE
+int parse_smiles_compact(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    ASTElement elem;
+    if (parse_input(buffer_len, &args, &ctx, &elem)) {
+        return 1;
+    }
+
+    size_t len;
+    uint8_t *out = compact_ASTElement(&elem, &len);
+    free_ctx(&ctx);
+    free(args);
+    if (!out) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    wasm_minimal_protocol_send_result_to_host(out, len);
+    free(out);
+    return 0;
+}
+
+// Returns the atoms and bonds as flat records with typed values instead of
+// the syntax tree, see parse_records.
+EMSCRIPTEN_KEEPALIVE
+int parse_smiles_records(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    records r;
+    if (parse_records_input(buffer_len, &args, &ctx, &r)) {
+        return 1;
+    }
+
+    int err = encode_records(&r);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Returns the molecular graph instead of the syntax tree, see build_graph.
+// Ring bonds that cannot be paired, and isotopes or classes too large for
+// an int, are reported like parse errors.
+EMSCRIPTEN_KEEPALIVE
+int graph_smiles(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    records r;
+    if (parse_records_input(buffer_len, &args, &ctx, &r)) {
+        return 1;
+    }
+    graph g = build_graph(&ctx, &r);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+
+    int err = encode_graph(&g);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Same as graph_smiles with the aromatic bonds given alternating orders, see
+// kekulize_graph.
+EMSCRIPTEN_KEEPALIVE
+int kekulize_smiles(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    records r;
+    if (parse_records_input(buffer_len, &args, &ctx, &r)) {
+        return 1;
+    }
+    graph g = build_graph(&ctx, &r);
+    if (!ctx.errored) {
+        kekulize_graph(&ctx, &g);
+    }
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+
+    int err = encode_graph(&g);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Same as kekulize_smiles with 2D coordinates on every atom, see depict_graph.
+EMSCRIPTEN_KEEPALIVE
+int depict_smiles(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    records r;
+    if (parse_records_input(buffer_len, &args, &ctx, &r)) {
+        return 1;
+    }
+    graph g = build_graph(&ctx, &r);
+    if (!ctx.errored) {
+        kekulize_graph(&ctx, &g);
+    }
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+    depict_graph(&ctx, &g);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+
+    int err = encode_graph(&g);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Parses every SMILES of the list in a single call. The result is a CBOR
+// array with one map per input, holding either the tree under "result" or
+// the message and byte offset of the failure under "error" and "position",
+// so that one invalid entry does not abort the others.
+EMSCRIPTEN_KEEPALIVE
+int parse_smiles_batch(size_t buffer_len) {
+    batch_reader r;
+    if (read_batch(buffer_len, &r)) {
+        return 1;
+    }
+
+    cbor_buffer out = init_cbor(CBOR_MIN_CAPACITY);
+    cbor_array(&out, r.len);
+    for (size_t i = 0; i < r.len; i++) {
+        size_t len;
+        char *smiles = next_batch_smiles(&r, &len);
+        if (!smiles) {
+            free(r.args);
+            free_cbor(&out);
+            send_error("Failed to decode parse_batch");
+            return 1;
+        }
+        parser_ctx ctx = init_ctx(smiles, len);
+        ASTElement elem = smile(&ctx);
+        if (ctx.errored) {
+            char *error = format_error(&ctx, smiles);
+            cbor_map(&out, 2);
+            cbor_text(&out, "error", 5);
+            cbor_cstr(&out, error ? error : "Failed to parse");
+            cbor_text(&out, "position", 8);
+            cbor_uint(&out, ctx.error.position);
             free(error);
         } else {
-            char *error = "Failed to parse";
-            wasm_minimal_protocol_send_result_to_host((uint8_t *)error, strlen(error));
+            cbor_map(&out, 1);
+            cbor_text(&out, "result", 6);
+            cbor_ASTElement(&out, &elem);
         }
+        free_ctx(&ctx);
+    }
+    free(r.args);
+    if (out.failed) {
+        free_cbor(&out);
+        send_error("Failed to encode result");
         return 1;
     }
+    wasm_minimal_protocol_send_result_to_host(out.data, out.len);
+    free_cbor(&out);
+    return 0;
+}
 
-    result r = {.result = elem};
-    if (encode_result(&r)) {
-        char *error = "Failed to encode result";
-        wasm_minimal_protocol_send_result_to_host((uint8_t *)error, strlen(error));
+// Checks a SMILES against the grammar without parsing it, see validate().
+EMSCRIPTEN_KEEPALIVE
+int validate_smiles(size_t buffer_len) {
+    char *args = read_args(buffer_len);
+    if (!args || buffer_len == 0) {
+        free(args);
+        send_error("Failed to decode parse");
+        return 1;
+    }
+    validation out = {.result = validate(args, args_smiles_len(args, buffer_len))};
+    free(args);
+    if (encode_validation(&out)) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Batch version of validate_smiles.
+EMSCRIPTEN_KEEPALIVE
+int validate_smiles_batch(size_t buffer_len) {
+    batch_reader r;
+    if (read_batch(buffer_len, &r)) {
+        return 1;
+    }
+
+    validation_batch out = {.results = malloc(sizeof(Validation) * (r.len + 1)),
+                            .results_len = r.len};
+    if (!out.results) {
+        free(r.args);
+        send_error("Out of memory");
+        return 1;
+    }
+    for (size_t i = 0; i < r.len; i++) {
+        size_t len;
+        char *smiles = next_batch_smiles(&r, &len);
+        if (!smiles) {
+            free(r.args);
+            free_validation_batch(&out);
+            send_error("Failed to decode parse_batch");
+            return 1;
+        }
+        out.results[i] = validate(smiles, len);
+    }
+    free(r.args);
+    int err = encode_validation_batch(&out);
+    free_validation_batch(&out);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Returns the smallest set of smallest rings of the graph, see find_rings,
+// with the rings holding each atom.
+EMSCRIPTEN_KEEPALIVE
+int rings_smiles(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    records r;
+    if (parse_records_input(buffer_len, &args, &ctx, &r)) {
+        return 1;
+    }
+    graph g = build_graph(&ctx, &r);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+    ring_set rings = find_rings(&ctx, &g, find_ring_bonds(&ctx, &g));
+    atom_rings index = index_atom_rings(&ctx, g.atoms_len, &rings);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+
+    ring_membership out = {
+        .rings = rings.atoms,
+        .rings_len = rings.offsets[rings.len],
+        .ring_offsets = rings.offsets,
+        .ring_offsets_len = rings.len + 1,
+        .atom_rings = index.rings,
+        .atom_rings_len = index.offsets[g.atoms_len],
+        .atom_ring_offsets = index.offsets,
+        .atom_ring_offsets_len = g.atoms_len + 1,
+    };
+    int err = encode_ring_membership(&out);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Hill formula and masses of a SMILES, see compute_formula.
+EMSCRIPTEN_KEEPALIVE
+int formula_smiles(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    records r;
+    if (parse_records_input(buffer_len, &args, &ctx, &r)) {
+        return 1;
+    }
+    graph g = build_graph(&ctx, &r);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+
+    molecular_formula out = compute_formula(&ctx, &g);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+    int err = encode_molecular_formula(&out);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+// Canonical SMILES of a SMILES and a 64-bit hash of it as 16 hex digits,
+// equal for any two spellings of the same molecule, Kekulé or aromatic, see
+// perceive_aromaticity and write_canonical.
+EMSCRIPTEN_KEEPALIVE
+int canonical_smiles(size_t buffer_len) {
+    char *args;
+    parser_ctx ctx;
+    records r;
+    if (parse_records_input(buffer_len, &args, &ctx, &r)) {
+        return 1;
+    }
+    graph g = build_graph(&ctx, &r);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+    perceive_aromaticity(&ctx, &g);
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+    char *smiles = write_canonical(&ctx, &g, rank_atoms(&ctx, &g));
+    if (ctx.errored) {
+        return send_parse_error(args, &ctx);
+    }
+    if (!smiles) {
+        free_ctx(&ctx);
+        free(args);
+        send_error("Too many ring bonds open at once to write a canonical SMILES");
+        return 1;
+    }
+    char hash[17];
+    write_hex64(hash, hash_string(smiles));
+    canonical out = {.smiles = smiles, .hash = hash};
+    int err = encode_canonical(&out);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef PARSER_STATS
+// Work of the parser on a SMILES per grammar rule, sent whether it parses
+// or not. Only built with PARSER_STATS, see parser_stats.
+EMSCRIPTEN_KEEPALIVE
+int parse_smiles_stats(size_t buffer_len) {
+    char *args = read_args(buffer_len);
+    if (!args || buffer_len == 0) {
+        free(args);
+        send_error("Failed to decode parse");
+        return 1;
+    }
+    parser_ctx ctx = init_ctx(args, args_smiles_len(args, buffer_len));
+    smile(&ctx);
+
+    RuleStats rules[RULE_COUNT];
+    for (size_t i = 0; i < RULE_COUNT; i++) {
+        const rule_stats *s = &ctx.stats.rules[i];
+        rules[i] = (RuleStats){.rule = (char *)parser_rule_names[i],
+                               .calls = s->calls,
+                               .failures = s->failures,
+                               .backtracks = s->backtracks,
+                               .rescanned = s->rescanned,
+                               .allocations = s->allocations};
+    }
+    size_t arena_bytes = 0;
+    for (arena_block *block = ctx.arena.head; block; block = block->next) {
+        arena_bytes += block->used;
+    }
+    parse_stats out = {
+        .result = {ctx.errored ? ctx.error.code : SMILES_VALID,
+                   ctx.errored ? ctx.error.position : 0},
+        .rules = rules,
+        .rules_len = RULE_COUNT,
+        .max_depth = ctx.stats.max_depth,
+        .max_branch_depth = ctx.stats.max_branch_depth,
+        .allocations = ctx.arena.allocations,
+        .arena_bytes = arena_bytes,
+    };
+    int err = encode_parse_stats(&out);
+    free_ctx(&ctx);
+    free(args);
+    if (err) {
+        send_error("Failed to encode result");
         return 1;
     }
-    free_result(&r);
     return 0;
 }
+#endif
@@ -90,6 +90,20 @@ void print_ast(const ASTElement *e, char *indent) {
     printf("%s}", indent);
 }
 
+#ifdef PARSER_STATS
+void print_stats(const parser_ctx *ctx) {
+    printf("%-18s %8s %8s %10s %9s %11s\n", "rule", "calls", "failures", "backtracks",
+           "rescanned", "allocations");
+    for (size_t i = 0; i < RULE_COUNT; i++) {
+        const rule_stats *s = &ctx->stats.rules[i];
+        printf("%-18s %8zu %8zu %10zu %9zu %11zu\n", parser_rule_names[i], s->calls, s->failures,
+               s->backtracks, s->rescanned, s->allocations);
+    }
+    printf("max depth %zu, max branch depth %zu, %zu allocations\n", ctx->stats.max_depth,
+           ctx->stats.max_branch_depth, ctx->arena.allocations);
+}
+#endif
+
 int main(int argc, char **argv) {
 	char *test_string = "[Rh-](Cl)(Cl)(Cl)(Cl)$[Rh-](Cl)(Cl)(Cl)Cl";
 	if (argc == 2) {
@@ -98,18 +112,25 @@ int main(int argc, char **argv) {
     parser_ctx ctx = init_ctx(test_string, strlen(test_string));
     ASTElement ast = smile(&ctx);
     if (ctx.errored) {
-        printf("Error: %s\n", ctx.error);
+        char *message = error_message(&ctx);
+        printf("Error: %s\n", message ? message : "out of memory");
+        free(message);
         printf("%s\n", test_string);
-        for (size_t i = 0; i < ctx.buffer_pos; i++) {
+        for (size_t i = 0; i < ctx.error.position; i++) {
             printf(" ");
         }
         printf("^\n");
-        free(ctx.error);
-        free_ASTElement(&ast);
+#ifdef PARSER_STATS
+        print_stats(&ctx);
+#endif
+        free_ctx(&ctx);
         return 1;
     }
     print_ast(&ast, "");
     printf("\n");
-    free_ASTElement(&ast);
+#ifdef PARSER_STATS
+    print_stats(&ctx);
+#endif
+    free_ctx(&ctx);
     return 0;
 }
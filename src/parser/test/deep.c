@@ -0,0 +1,95 @@
+// Parses and encodes molecules of a million atoms, one long chain and one
+// nesting a million branches. Run on a small stack, e.g. ulimit -s 256, any
+// recursion over the length or the depth of a molecule overflows it.
+#include "parser/parser.h"
+#include <stdio.h>
+
+#define ATOMS 1000000
+
+static const char *args = NULL;
+static size_t args_len = 0;
+static size_t sent_bytes = 0;
+
+void wasm_minimal_protocol_write_args_to_buffer(uint8_t *ptr) {
+    memcpy(ptr, args, args_len);
+}
+
+void wasm_minimal_protocol_send_result_to_host(const uint8_t *ptr, size_t len) {
+    sent_bytes = len;
+}
+
+int parse_smiles(size_t buffer_len);
+int parse_smiles_cbor(size_t buffer_len);
+int parse_smiles_compact(size_t buffer_len);
+int parse_smiles_records(size_t buffer_len);
+int validate_smiles(size_t buffer_len);
+int graph_smiles(size_t buffer_len);
+int formula_smiles(size_t buffer_len);
+int rings_smiles(size_t buffer_len);
+int kekulize_smiles(size_t buffer_len);
+int canonical_smiles(size_t buffer_len);
+int depict_smiles(size_t buffer_len);
+
+static const struct {
+    const char *name;
+    int (*run)(size_t buffer_len);
+} exports[] = {
+    {"parse_smiles", parse_smiles},
+    {"parse_smiles_cbor", parse_smiles_cbor},
+    {"parse_smiles_compact", parse_smiles_compact},
+    {"parse_smiles_records", parse_smiles_records},
+    {"validate_smiles", validate_smiles},
+    {"graph_smiles", graph_smiles},
+    {"formula_smiles", formula_smiles},
+    {"rings_smiles", rings_smiles},
+    {"kekulize_smiles", kekulize_smiles},
+    {"canonical_smiles", canonical_smiles},
+    {"depict_smiles", depict_smiles},
+};
+
+// "CCC...C", every atom in one chain.
+char *long_chain(void) {
+    char *smiles = malloc(ATOMS + 1);
+    memset(smiles, 'C', ATOMS);
+    smiles[ATOMS] = '\0';
+    return smiles;
+}
+
+// "C(C(C(...)))", every atom a branch of the previous one.
+char *deep_branches(void) {
+    char *smiles = malloc(3 * ATOMS);
+    size_t len = 0;
+    for (size_t i = 0; i < ATOMS; i++) {
+        if (i > 0) {
+            smiles[len++] = '(';
+        }
+        smiles[len++] = 'C';
+    }
+    for (size_t i = 1; i < ATOMS; i++) {
+        smiles[len++] = ')';
+    }
+    smiles[len] = '\0';
+    return smiles;
+}
+
+int main(void) {
+    struct {
+        const char *name;
+        char *smiles;
+    } molecules[] = {{"chain", long_chain()}, {"branches", deep_branches()}};
+    int failures = 0;
+    for (size_t m = 0; m < sizeof(molecules) / sizeof(molecules[0]); m++) {
+        // sent with their terminator, as Typst does
+        args = molecules[m].smiles;
+        args_len = strlen(args) + 1;
+        for (size_t e = 0; e < sizeof(exports) / sizeof(exports[0]); e++) {
+            sent_bytes = 0;
+            int result = exports[e].run(args_len);
+            printf("%-8s %-20s %s, %zu bytes\n", molecules[m].name, exports[e].name,
+                   result == 0 ? "ok" : "failed", sent_bytes);
+            failures += result != 0;
+        }
+        free(molecules[m].smiles);
+    }
+    return failures != 0;
+}
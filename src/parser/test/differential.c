@@ -0,0 +1,116 @@
+// Differential test of the parser against the one it replaced, the option()
+// backtracking parser of commit e1fa8a0. Every line of the corpus is parsed
+// and reduced to one line of text, which must equal the line the old parser
+// gave, recorded in the expected file:
+//   ok <elements> <hash>       the tree, hashed in pre-order over the type,
+//                              span, value and child count of each element
+//   error <position> <message> a failed parse
+// Lines where the old parser was wrong hold the fixed output, followed by
+// "  # <reasons>; old parser: <its output>". The reasons are
+//   chirality     [C@@H] and the @TH, @AL, @SP, @TB and @OH classes parse
+//   end of input  a last C or B is no longer read as Cl or Br
+//   branch chain  a branch opened by a bond or a dot keeps its chain
+// Usage: ./differential_test test/corpus.smi test/corpus.expected
+#include "parser/parser.h"
+#include "parser/tree.h"
+#include "test/wasm.h"
+
+#define LINE_CAPACITY 4096
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_int(uint64_t hash, int value) {
+    uint8_t bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+// Writes the summary of the tree or of the error of one parse to out.
+void summarize(const char *smiles, char *out, size_t out_len) {
+    parser_ctx ctx = init_ctx((char *)smiles, strlen(smiles));
+    ASTElement ast = smile(&ctx);
+    if (ctx.errored) {
+        char *message = error_message(&ctx);
+        snprintf(out, out_len, "error %zu %s", ctx.error.position,
+                 message ? message : "out of memory");
+        free(message);
+        free_ctx(&ctx);
+        return;
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    size_t elements = 0;
+    tree_stack stack = {0};
+    stack.items = malloc(sizeof(*stack.items));
+    stack.items[0] = &ast;
+    stack.len = stack.capacity = 1;
+    while (stack.len > 0) {
+        const ASTElement *e = stack.items[--stack.len];
+        elements++;
+        hash = hash_int(hash, e->type);
+        hash = hash_int(hash, e->from);
+        hash = hash_int(hash, e->to);
+        // a missing value hashes apart from an empty one
+        hash = hash_int(hash, e->value ? (int)strlen(e->value) : -1);
+        if (e->value) {
+            hash = hash_bytes(hash, e->value, strlen(e->value));
+        }
+        hash = hash_int(hash, e->children_len);
+        if (push_children(&stack, e)) {
+            snprintf(out, out_len, "out of memory");
+            free(stack.items);
+            free_ctx(&ctx);
+            return;
+        }
+    }
+    free(stack.items);
+    snprintf(out, out_len, "ok %zu %016llx", elements, (unsigned long long)hash);
+    free_ctx(&ctx);
+}
+
+// Reads one line without its newline, false at the end of the file.
+bool read_line(FILE *file, char *line) {
+    if (!fgets(line, LINE_CAPACITY, file)) {
+        return false;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s corpus expected\n", argv[0]);
+        return 2;
+    }
+    FILE *corpus = fopen(argv[1], "r"), *expected = fopen(argv[2], "r");
+    if (!corpus || !expected) {
+        fprintf(stderr, "cannot open %s\n", corpus ? argv[2] : argv[1]);
+        return 2;
+    }
+    static char smiles[LINE_CAPACITY], want[LINE_CAPACITY], got[LINE_CAPACITY];
+    size_t lines = 0, failures = 0;
+    while (read_line(corpus, smiles)) {
+        lines++;
+        if (!read_line(expected, want)) {
+            fprintf(stderr, "%s ends before line %zu of %s\n", argv[2], lines, argv[1]);
+            return 2;
+        }
+        char *note = strstr(want, "  #");
+        if (note) {
+            *note = '\0';
+        }
+        summarize(smiles, got, sizeof(got));
+        if (strcmp(want, got) != 0) {
+            failures++;
+            printf("line %zu: %s\n  expected %s\n  got      %s\n", lines, smiles, want, got);
+        }
+    }
+    fclose(corpus);
+    fclose(expected);
+    printf("%zu of %zu molecules differ from the old parser\n", failures, lines);
+    return failures > 0;
+}
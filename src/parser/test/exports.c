@@ -0,0 +1,85 @@
+// Calls an export of the native build on every line of a corpus and prints,
+// per line, its return value and the bytes it sent in hex, as ./wasm_host -r
+// does for the built module. make host_test compares the two.
+// Usage: ./exports_test function < corpus
+#include "parser/parser.h"
+#include <stdio.h>
+
+static const char *args = NULL;
+static size_t args_len = 0;
+static uint8_t *sent = NULL;
+static size_t sent_len = 0;
+
+void wasm_minimal_protocol_write_args_to_buffer(uint8_t *ptr) {
+    memcpy(ptr, args, args_len);
+}
+
+void wasm_minimal_protocol_send_result_to_host(const uint8_t *ptr, size_t len) {
+    free(sent);
+    sent = malloc(len + 1);
+    memcpy(sent, ptr, len);
+    sent_len = len;
+}
+
+int parse_smiles(size_t buffer_len);
+int parse_smiles_cbor(size_t buffer_len);
+int parse_smiles_compact(size_t buffer_len);
+int parse_smiles_records(size_t buffer_len);
+int validate_smiles(size_t buffer_len);
+int graph_smiles(size_t buffer_len);
+int formula_smiles(size_t buffer_len);
+int rings_smiles(size_t buffer_len);
+int kekulize_smiles(size_t buffer_len);
+int canonical_smiles(size_t buffer_len);
+int depict_smiles(size_t buffer_len);
+
+static const struct {
+    const char *name;
+    int (*run)(size_t buffer_len);
+} exports[] = {
+    {"parse_smiles", parse_smiles},
+    {"parse_smiles_cbor", parse_smiles_cbor},
+    {"parse_smiles_compact", parse_smiles_compact},
+    {"parse_smiles_records", parse_smiles_records},
+    {"validate_smiles", validate_smiles},
+    {"graph_smiles", graph_smiles},
+    {"formula_smiles", formula_smiles},
+    {"rings_smiles", rings_smiles},
+    {"kekulize_smiles", kekulize_smiles},
+    {"canonical_smiles", canonical_smiles},
+    {"depict_smiles", depict_smiles},
+};
+
+int main(int argc, char **argv) {
+    int (*run)(size_t) = NULL;
+    for (size_t i = 0; argc == 2 && i < sizeof(exports) / sizeof(exports[0]); i++) {
+        if (strcmp(argv[1], exports[i].name) == 0) {
+            run = exports[i].run;
+        }
+    }
+    if (!run) {
+        fprintf(stderr, "usage: %s function < corpus\n", argv[0]);
+        return 1;
+    }
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t len;
+    while ((len = getline(&line, &line_capacity, stdin)) > 0) {
+        if (line[len - 1] == '\n') {
+            len--;
+        }
+        // with its terminating NUL, as Typst sends a str
+        line[len] = '\0';
+        args = line;
+        args_len = len + 1;
+        sent_len = 0;
+        printf("%d ", run(args_len));
+        for (size_t i = 0; i < sent_len; i++) {
+            printf("%02x", sent[i]);
+        }
+        printf("\n");
+    }
+    free(line);
+    free(sent);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Values read into the records of parse_records() and the graph built from
+// them, around the limits of the numbers a bracket atom holds. An isotope or
+// class past INT_MAX must not wrap around to a smaller number, [4294967309C]
+// having once read as [13C].
+// Usage: ./records_test
+#include "parser/graph.h"
+#include "test/wasm.h"
+
+typedef struct record_case {
+    const char *smiles;
+    int isotope;
+    int atom_class;
+    int hydrogens;
+    int charge;
+    const char *error; // of build_graph(), NULL when the graph builds
+} record_case;
+
+static const record_case cases[] = {
+    {"[13C]", 13, 0, 0, 0, NULL},
+    {"[2147483647C]", 2147483647, 0, 0, 0, NULL},
+    {"[2147483648C]", -1, 0, 0, 0, "Isotope too large"},
+    {"[4294967309C]", -1, 0, 0, 0, "Isotope too large"},
+    {"[99999999999999999999C]", -1, 0, 0, 0, "Isotope too large"},
+    {"[C:1]", 0, 1, 0, 0, NULL},
+    {"[C:2147483647]", 0, 2147483647, 0, 0, NULL},
+    {"[C:2147483648]", 0, -1, 0, 0, "Atom class too large"},
+    {"[C:4294967297]", 0, -1, 0, 0, "Atom class too large"},
+    {"[0013CH3-:007]", 13, 7, 3, -1, NULL},
+    {"[NH4+]", 0, 0, 4, 1, NULL},
+    {"[Fe-15]", 0, 0, 0, -15, NULL},
+    {"C", 0, 0, -1, 0, NULL},
+};
+
+// Checks one case, printing what differs, true when nothing does.
+bool check(const record_case *c) {
+    parser_ctx ctx = init_ctx((char *)c->smiles, strlen(c->smiles));
+    records r = parse_records(&ctx);
+    bool ok = !ctx.errored && r.atoms_len == 1;
+    if (ok) {
+        const AtomRecord *a = &r.atoms[0];
+        ok = a->isotope == c->isotope && a->atom_class == c->atom_class &&
+             a->hydrogens == c->hydrogens && a->charge == c->charge;
+        if (!ok) {
+            printf("%s: isotope %d class %d hydrogens %d charge %d\n", c->smiles, a->isotope,
+                   a->atom_class, a->hydrogens, a->charge);
+        }
+    } else {
+        printf("%s: no record\n", c->smiles);
+    }
+    if (ok) {
+        build_graph(&ctx, &r);
+        const char *got = ctx.errored ? ctx.message : NULL;
+        if (got && !c->error) {
+            printf("%s: unexpected error %s\n", c->smiles, got);
+            ok = false;
+        } else if (!got && c->error) {
+            printf("%s: expected error %s\n", c->smiles, c->error);
+            ok = false;
+        } else if (got && (strcmp(got, c->error) != 0 || ctx.error.position != 0)) {
+            printf("%s: error %s at %zu, expected %s at 0\n", c->smiles, got,
+                   ctx.error.position, c->error);
+            ok = false;
+        }
+    }
+    free_ctx(&ctx);
+    return ok;
+}
+
+int main(void) {
+    size_t count = sizeof(cases) / sizeof(cases[0]), failures = 0;
+    for (size_t i = 0; i < count; i++) {
+        failures += !check(&cases[i]);
+    }
+    printf("%zu of %zu records differ\n", failures, count);
+    return failures > 0;
+}
@@ -18,6 +18,5 @@ void wasm_minimal_protocol_send_result_to_host(const uint8_t *ptr, size_t len) {
             printf("\n");
         }
     }
-    free(ptr);
 }
 #endif // WASM_H